@@ -41,6 +41,7 @@ rem Used external libraries, except kernel32.lib:
 rem 'user32.lib'  			 		- for windows API general functions.
 rem 'gdi32.lib'						- for windows API graphics functions, such as GetDC() or ReleaseDC().
 rem 'winmm.lib'						- for mmsystem.h interface, timeBeginPeriod()/timeEndPeriod().
+rem 'synchronization.lib'				- for WaitOnAddress()/WakeByAddressAll().
 pushd build
-cl -Fe%OutputName%.exe -Fm%OutputName%.map %CommonCompilerFlags% ..\game.cpp /link %CommonLinkerFlags% user32.lib gdi32.lib winmm.lib -pdb:%OutputName%.pdb
+cl -Fe%OutputName%.exe -Fm%OutputName%.map %CommonCompilerFlags% ..\game.cpp /link %CommonLinkerFlags% user32.lib gdi32.lib winmm.lib synchronization.lib -pdb:%OutputName%.pdb
 popd
@@ -27,11 +27,21 @@ set -e
 # Create 'build' directory if not created yet
 mkdir -p build
 
-# Compile 'game'.
+# Compile 'game entities', the game module the executable loads and reloads whenever it is rebuilt.
+# -shared                       - build a shared object.
+# -fno-gnu-unique               - do not emit unique symbols, they would keep the old module from ever being unloaded.
 # Used external libraries:
 # 'pthread'                     - POSIX thread library.
 # 'm'                           - standard mathematics.
+g++ game.cpp -o ./build/${OutputName}_ents.so $CommonOptions -shared -fno-gnu-unique -pthread -lm
+
+# Compile 'game', the platform layer executable.
+# -rdynamic                     - export the platform API to the game module.
+# Used external libraries:
+# 'pthread'                     - POSIX thread library.
+# 'm'                           - standard mathematics.
+# 'dl'                          - dynamic loader, for the game module.
 # 'X11'                         - X11 interface.
 # 'Xext'                        - X extensions interface.
 # 'Xrandr'                      - X RandR interface.
-g++ game.cpp -o ./build/$OutputName $CommonOptions -pthread -lm -lX11 -lXext -lXrandr
+g++ game_platform_linux.cpp -o ./build/$OutputName $CommonOptions -rdynamic -pthread -lm -ldl -lX11 -lXext -lXrandr
@@ -8,23 +8,94 @@
 #if WIN32
 #include "game_platform_win32.cpp"
 #elif LINUX
-#include "game_platform_linux.cpp"
+// NOTE(ivan): On Linux the platform layer is an executable of its own,
+// everything here is built into the game module it loads (%OutputName%_ents.so).
+#include "game.h"
 #else
 #error Unsupported target platform!
 #endif
 #include "game_misc.cpp"
 #include "game_memory.cpp"
+#include "game_vfs.cpp"
+#include "game_compress.cpp"
 #include "game_image.cpp"
 #include "game_draw.cpp"
 #include "game_asset.cpp"
 
 void
 GameUpdate(game_update_type UpdateType, game_state *State, game_tl_state *TLState) {
+	// NOTE(ivan): Module statics do not survive a reload the way the hunk does, re-derive them from the hunk every update.
+	if (UpdateType != GameUpdateType_Prepare)
+		UseVfs(&((game_storage *)State->Hunk.Base)->Vfs);
+
 	switch (UpdateType) {
 		///////////////////////////////////////////////////////////////////
 		// Game initialization.
 		///////////////////////////////////////////////////////////////////
 	case GameUpdateType_Prepare: {
+		Assert(State->Hunk.Base);
+		Assert(State->Hunk.Size >= sizeof(game_storage));
+
+#if SLOWCODE
+		DEBUGCheckInflate();
+#endif
+
+		game_storage *Storage = (game_storage *)State->Hunk.Base;
+		InitializeHeap(&Storage->Heap,
+					   State->Hunk.Base + sizeof(game_storage),
+					   State->Hunk.Size - sizeof(game_storage));
+
+		// NOTE(ivan): Game data.
+		if (InitializeVfs(&Storage->Vfs, &Storage->Heap, MAX_VFS_FILES)) {
+			if (!MountVfsDirectory(&Storage->Vfs, BASEDIR "/" MASTERGAMEDIR))
+				DEBUGPlatformOutf("Game directory " BASEDIR "/" MASTERGAMEDIR " is missing!");
+
+			const char *ParamGame = PlatformCheckParamValue("-game");
+			if (ParamGame && !AreStringsEqual(ParamGame, MASTERGAMEDIR)) {
+				char GameDir[256];
+				snprintf(GameDir, CountOf(GameDir), BASEDIR "/%s", ParamGame);
+				if (!MountVfsDirectory(&Storage->Vfs, GameDir))
+					DEBUGPlatformOutf("Game directory %s is missing!", GameDir);
+			}
+		}
+
+		// NOTE(ivan): Game assets.
+		Storage->TestImageID = AddImageAsset(&Storage->Assets, "test.bmp", &Storage->Heap);
+		if (Storage->TestImageID == INVALID_ASSET_ID)
+			DEBUGPlatformOutf("Could not load test.bmp!");
+
+#if INTERNAL
+		// NOTE(ivan): "-makepack <dir>" packs the directory into <dir>.qpak.
+		const char *ParamMakePack = PlatformCheckParamValue("-makepack");
+		if (ParamMakePack) {
+			char PackName[256];
+			snprintf(PackName, CountOf(PackName), "%s." VFS_PACK_EXTENSION, ParamMakePack);
+			if (!WriteVfsPack(PackName, ParamMakePack, &Storage->Heap))
+				DEBUGPlatformOutf("Failed packing %s", ParamMakePack);
+		}
+
+		// NOTE(ivan): "-packimage <file>" converts a BMP, PNG or QOI image into <file>.qpk, next to the file it was read from.
+		const char *ParamPackImage = PlatformCheckParamValue("-packimage");
+		if (ParamPackImage) {
+			temporary_memory ImageMemory = BeginTemporaryMemory(&Storage->Heap);
+			image Image = LoadImageByExtension(ParamPackImage, &Storage->Heap);
+			if (Image.Pixels) {
+				char RealFileName[512];
+				if (!ResolveVfsPath(ParamPackImage, RealFileName, CountOf(RealFileName)))
+					snprintf(RealFileName, CountOf(RealFileName), "%s", ParamPackImage);
+
+				char PackedName[512];
+				snprintf(PackedName, CountOf(PackedName), "%s.qpk", RealFileName);
+				if (WriteImagePacked(PackedName, &Image, &Storage->Heap))
+					DEBUGPlatformOutf("Image packed: %s", PackedName);
+				else
+					DEBUGPlatformOutf("Failed writing %s", PackedName);
+			} else {
+				DEBUGPlatformOutf("Failed loading %s", ParamPackImage);
+			}
+			EndTemporaryMemory(ImageMemory);
+		}
+#endif
 	} break;
 
 		///////////////////////////////////////////////////////////////////
@@ -33,10 +104,85 @@ GameUpdate(game_update_type UpdateType, game_state *State, game_tl_state *TLStat
 	case GameUpdateType_Release: {
 	} break;
 
+		///////////////////////////////////////////////////////////////////
+		// Game simulation tick.
+		///////////////////////////////////////////////////////////////////
+	case GameUpdateType_Tick: {
+		// NOTE(ivan): Simulation advances by State->SecondsPerTick here, rendering interpolates by State->TickAlpha.
+	} break;
+
 		///////////////////////////////////////////////////////////////////
 		// Game frame.
 		///////////////////////////////////////////////////////////////////
 	case GameUpdateType_Frame: {
+		game_storage *Storage = (game_storage *)State->Hunk.Base;
+
+		// NOTE(ivan): Frame boundary, the only place asset slots may change.
+		ReloadChangedAssets(&Storage->Assets, &Storage->Heap);
+
+#if INTERNAL
+		// NOTE(ivan): Dump the last presented frame.
+		// While pipelined the frame belongs to the render thread, and the QOI writer would race it on Storage->Heap.
+		if (IsNewlyPressed(&State->KeyboardButtons[KeyCode_F12]) && !State->VideoBuffer.Pixels) {
+			DEBUGPlatformOutf("Screenshot skipped: frames are rendered on a thread of their own (-pipeline)!");
+		} else if (IsNewlyPressed(&State->KeyboardButtons[KeyCode_F12])) {
+			char ScreenshotName[64];
+			snprintf(ScreenshotName, CountOf(ScreenshotName), "screenshot%04d.qoi", Storage->ScreenshotCount++);
+
+			image Frame;
+			Frame.Pixels = State->VideoBuffer.Pixels;
+			Frame.Width = State->VideoBuffer.Width;
+			Frame.Height = State->VideoBuffer.Height;
+			Frame.BytesPerPixel = State->VideoBuffer.BytesPerPixel;
+			Frame.Pitch = State->VideoBuffer.Pitch;
+			if (WriteImageQoi(ScreenshotName, &Frame, &Storage->Heap, true))
+				DEBUGPlatformOutf("Screenshot saved: %s", ScreenshotName);
+		}
+#endif
+
+		// NOTE(ivan): Draw the frame. The screenshot above has to come first, it reads the previous one.
+		render_commands *Commands = State->RenderCommands;
+		Assert(Commands);
+
+		PushClear(Commands, V4(32.0f, 32.0f, 48.0f, 255.0f));
+		if (Storage->TestImageID != INVALID_ASSET_ID) {
+			image *TestImage = GetImageAsset(&Storage->Assets, Storage->TestImageID);
+			v2 Pos = V2((f32)((Commands->Width - TestImage->Width) / 2), (f32)((Commands->Height - TestImage->Height) / 2));
+			PushImage(Commands, TestImage, Pos);
+		}
 	} break;
 	}
 }
+
+void
+GameRender(render_commands *Commands, game_video_buffer *Buffer) {
+	Assert(Commands);
+	Assert(Buffer);
+
+	if (!Buffer->Pixels)
+		return;
+
+	for (uptr At = 0; At < Commands->Used;) {
+		render_command_header *Header = (render_command_header *)(Commands->Base + At);
+		switch (Header->Type) {
+		case RenderCommand_Clear: {
+			render_command_clear *Command = (render_command_clear *)Header;
+			ClearVideoBuffer(Buffer, Command->Color);
+		} break;
+
+		case RenderCommand_Rectangle: {
+			render_command_rectangle *Command = (render_command_rectangle *)Header;
+			DrawRectangle(Buffer, Command->Pos, Command->Dim, Command->Color);
+		} break;
+
+		case RenderCommand_Image: {
+			render_command_image *Command = (render_command_image *)Header;
+			DrawImage(Buffer, &Command->Image, Command->Pos);
+		} break;
+
+		InvalidDefaultCase;
+		}
+
+		At += Header->Size;
+	}
+}
@@ -13,11 +13,19 @@
 #include "game_error.h"
 #include "game_math.h"
 #include "game_memory.h"
+#include "game_vfs.h"
 #include "game_asset.h"
+#include "game_render.h"
+#include "game_stats.h"
 
 // NOTE(ivan): Game title, should be one simple UpperCamelCase word.
 #define GAMENAME "Quantic"
 
+// NOTE(ivan): Game data root and the directory mounted first, "-game <name>" mounts base/<name> on top of it.
+#define BASEDIR "base"
+#define MASTERGAMEDIR "master"
+#define MAX_VFS_FILES 16384
+
 // NOTE(ivan): Game video buffer.
 struct game_video_buffer {
 	u32 *Pixels; // NOTE(ivan): Always 32-bit wide, format: 0xAARRGGBB.
@@ -47,6 +55,54 @@ IsNewlyPressed(game_input_button *Button) {
 	return !Button->WasDown && Button->IsDown && Button->IsNew;
 }
 
+// NOTE(ivan): Game input events, every keyboard and mouse transition of the frame in the order they came in.
+// The button states keep only where a button ended up, so a key pressed and released within one frame
+// shows up here alone. The ring holds the frame's last INPUT_EVENT_RING_SIZE events, older ones get overwritten.
+#define INPUT_EVENT_RING_SIZE 256 // NOTE(ivan): Must be a power of two.
+
+enum game_input_event_type {
+	GameInputEvent_Key,         // NOTE(ivan): Code is key_code, Value is 1 when pressed, 0 when released.
+	GameInputEvent_MouseButton, // NOTE(ivan): Code is the index into game_state::MouseButtons, Value as above.
+	GameInputEvent_MouseWheel   // NOTE(ivan): Value is the number of scrolls.
+};
+
+struct game_input_event {
+	u32 Time; // NOTE(ivan): Milliseconds as the window system stamped the event, wraps around, only differences make sense.
+	u16 Type;
+	u16 Code;
+	s32 Value;
+};
+
+struct game_input_events {
+	u32 Count; // NOTE(ivan): Pushed this frame, may be more than the ring holds.
+	game_input_event Ring[INPUT_EVENT_RING_SIZE];
+};
+
+inline void
+PushInputEvent(game_input_events *Events, game_input_event_type Type, u32 Code, s32 Value, u32 Time) {
+	Assert(Events);
+
+	game_input_event *Event = &Events->Ring[Events->Count++ & (INPUT_EVENT_RING_SIZE - 1)];
+	Event->Time = Time;
+	Event->Type = (u16)Type;
+	Event->Code = (u16)Code;
+	Event->Value = Value;
+}
+
+// NOTE(ivan): Index of the oldest event still in the ring, events go from there up to Count.
+inline u32
+GetFirstInputEvent(game_input_events *Events) {
+	Assert(Events);
+	return (Events->Count > INPUT_EVENT_RING_SIZE) ? (Events->Count - INPUT_EVENT_RING_SIZE) : 0;
+}
+
+inline game_input_event *
+GetInputEvent(game_input_events *Events, u32 Index) {
+	Assert(Events);
+	Assert((Index < Events->Count) && ((Events->Count - Index) <= INPUT_EVENT_RING_SIZE));
+	return &Events->Ring[Index & (INPUT_EVENT_RING_SIZE - 1)];
+}
+
 // NOTE(ivan): Game Xbox controller.
 struct game_input_xbox_controller {
 	b32 IsConnected;
@@ -77,10 +133,35 @@ struct game_input_xbox_controller {
 	v2 RightStickPos; 
 };
 
+// NOTE(ivan): Profiler ring, written only by the thread owning it, the oldest events get overwritten.
+#define PROFILE_RING_SIZE 4096 // NOTE(ivan): Must be a power of two.
+
+struct profile_event {
+	const char *Name;
+	u64 BeginCycles;
+	u64 EndCycles;
+};
+
+struct profile_ring {
+	volatile u32 WriteIndex; // NOTE(ivan): Total events ever written.
+	profile_event Events[PROFILE_RING_SIZE];
+};
+
+// NOTE(ivan): Memory the platform layer hands to every thread: the profiler ring followed by the scratch heap.
+#define THREAD_PROFILE_SIZE AlignPow2((uptr)sizeof(profile_ring), (uptr)4096)
+#define THREAD_SCRATCH_SIZE ((uptr)Megabytes(4))
+#define THREAD_MEMORY_SIZE (THREAD_PROFILE_SIZE + THREAD_SCRATCH_SIZE)
+
 // NOTE(ivan): Game state.
 struct game_state {
+	// NOTE(ivan): Hunk, the whole game memory. Allocated once by the platform layer.
+	piece Hunk;
+
 	// NOTE(ivan): Video buffer to write graphics in.
+	// NOTE(ivan): Pixels is 0 while frames are rendered on a thread of their own ("-pipeline"), draw through RenderCommands then.
 	game_video_buffer VideoBuffer;
+	// NOTE(ivan): Render command list of the frame, set by the platform layer before every Frame update, see game_render.h.
+	render_commands *RenderCommands;
 	// NOTE(ivan): Audio buffer to write sounds in.
 	game_audio_buffer AudioBuffer;
 
@@ -90,25 +171,133 @@ struct game_state {
 	point MousePos;
 	s32 MouseWheel; // NOTE(ivan): Number of scrolls per frame. Negative value indicates the wheel was rotated backward, toward the user.
 	game_input_xbox_controller XboxControllers[4];
+	game_input_events InputEvents;
+
+	// NOTE(ivan): Profiler rings of all threads, set up by the platform layer before any of them runs.
+	u32 ThreadCount;
+	profile_ring *ProfileRings[MAX_WORKER_THREADS + 1];
 
 	// NOTE(ivan): Clocks.
-	f64 CyclesPerFrame;
+	f64 CyclesPerFrame; // NOTE(ivan): TSC cycles of the whole last frame, see CyclesToSeconds().
 	f64 SecondsPerFrame;
 	f64 FramesPerSecond;
+	frame_stats FrameStats; // NOTE(ivan): Up to the previous frame.
+
+	// NOTE(ivan): Fixed-step simulation, "-tickrate <hz>", see game_step.h.
+	f64 SecondsPerTick; // NOTE(ivan): 0 when every frame is a single variable-length Frame update.
+	u64 TickCount; // NOTE(ivan): Ticks simulated so far.
+	f32 TickAlpha; // NOTE(ivan): For the Frame update, how far past the last tick it renders, in ticks, [0, 1).
+};
+
+// NOTE(ivan): Game storage, lives at the very beginning of the hunk.
+struct game_storage {
+	memory_heap Heap; // NOTE(ivan): The rest of the hunk.
+	vfs Vfs;
+	game_assets Assets;
+	u32 TestImageID;
+
+	s32 ScreenshotCount;
 };
 
 // NOTE(ivan): Game thread local storage.
+// Every thread of the job system (the primary thread is the first) gets its own scratch heap, profiler ring
+// and random number state, so they are reachable without locks. The memory behind them is owned by the platform layer.
 struct game_tl_state {
 	error_code LastError;
+
+	u32 ThreadIndex;
+	memory_heap ScratchHeap; // NOTE(ivan): Temporaries only, use temporary memory and give everything back.
+	profile_ring *ProfileRing; // NOTE(ivan): May be 0 if the platform layer could not allocate thread memory.
+	u32 RandomState;
+};
+
+// NOTE(ivan): Owned by the platform layer, the game module reaches the very same instance.
+extern thread_local game_tl_state GameTLState;
+
+inline void
+InitializeThreadState(game_tl_state *State, u32 ThreadIndex, void *Memory) {
+	Assert(State);
+
+	State->LastError = ErrorCode_NoError;
+	State->ThreadIndex = ThreadIndex;
+	State->ProfileRing = 0;
+	State->ScratchHeap = {};
+	State->RandomState = (ThreadIndex + 1) * 2654435761u; // NOTE(ivan): Never zero, xorshift would get stuck.
+
+	if (Memory) {
+		State->ProfileRing = (profile_ring *)Memory;
+		State->ProfileRing->WriteIndex = 0;
+		InitializeHeap(&State->ScratchHeap, (u8 *)Memory + THREAD_PROFILE_SIZE, THREAD_SCRATCH_SIZE);
+	}
+}
+
+// NOTE(ivan): Per-thread xorshift generator, not for anything that needs to be repeatable across runs.
+inline u32
+GetThreadRandomU32(game_tl_state *State) {
+	Assert(State);
+
+	u32 Random = State->RandomState;
+	Random ^= (Random << 13);
+	Random ^= (Random >> 17);
+	Random ^= (Random << 5);
+	State->RandomState = Random;
+
+	return Random;
+}
+
+inline void
+PushProfileEvent(game_tl_state *State, const char *Name, u64 BeginCycles, u64 EndCycles) {
+	Assert(State);
+
+	profile_ring *Ring = State->ProfileRing;
+	if (Ring) {
+		u32 WriteIndex = Ring->WriteIndex;
+		profile_event *Event = &Ring->Events[WriteIndex & (PROFILE_RING_SIZE - 1)];
+		Event->Name = Name;
+		Event->BeginCycles = BeginCycles;
+		Event->EndCycles = EndCycles;
+		CompilerBarrier();
+		Ring->WriteIndex = WriteIndex + 1; // NOTE(ivan): Publish.
+	}
+}
+
+// NOTE(ivan): Records the enclosing scope into the calling thread's profiler ring.
+struct profile_block {
+	game_tl_state *State;
+	const char *Name;
+	u64 BeginCycles;
+
+	profile_block(game_tl_state *InState, const char *InName) {
+		State = InState;
+		Name = InName;
+		BeginCycles = __rdtsc();
+	}
+	~profile_block() {
+		PushProfileEvent(State, Name, BeginCycles, __rdtsc());
+	}
 };
+#define PROFILE_BLOCK__(Name, Line) profile_block ProfileBlock##Line(&GameTLState, Name)
+#define PROFILE_BLOCK_(Name, Line) PROFILE_BLOCK__(Name, Line)
+#define PROFILE_BLOCK(Name) PROFILE_BLOCK_(Name, __LINE__)
 
 // NOTE(ivan): Game update type.
 enum game_update_type {
 	GameUpdateType_Prepare,
 	GameUpdateType_Release,
-	GameUpdateType_Frame
+	GameUpdateType_Frame, // NOTE(ivan): Once per frame. With a fixed step, the render pass that follows the ticks.
+	GameUpdateType_Tick // NOTE(ivan): Fixed-step only, advances the simulation by SecondsPerTick.
 };
 
-void GameUpdate(game_update_type UpdateType, game_state *State, game_tl_state *TLState);
+// NOTE(ivan): The game entry point. Exported with C linkage, so the platform layer can look it up by name
+// when the game lives in a module of its own.
+#define GAME_UPDATE(Name) void Name(game_update_type UpdateType, game_state *State, game_tl_state *TLState)
+typedef GAME_UPDATE(game_update_func);
+extern "C" GAME_UPDATE(GameUpdate);
+
+// NOTE(ivan): Rasterizes a render command list into a video buffer. Touches nothing but the two,
+// so the platform layer may call it on any thread, concurrently with GameUpdate().
+#define GAME_RENDER(Name) void Name(render_commands *Commands, game_video_buffer *Buffer)
+typedef GAME_RENDER(game_render_func);
+extern "C" GAME_RENDER(GameRender);
 
 #endif // #ifndef GAME_H
@@ -6,3 +6,351 @@
    $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
    ===================================================================== */
 #include "game_asset.h"
+
+static void
+DecodePackedImageChunk(void *Data) {
+	packed_image_chunk_work *Work = (packed_image_chunk_work *)Data;
+	Assert(Work);
+
+	PROFILE_BLOCK("DecodePackedImageChunk");
+	Work->IsDecoded = DecompressLZ(Work->Src, Work->SrcSize, Work->Dst, Work->DstSize);
+}
+
+image
+LoadImagePacked(const char *FileName, memory_heap *Heap) {
+	Assert(FileName);
+	Assert(Heap);
+
+	image Result = {};
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	DEBUGPlatformOutf("Loading packed image: %s", FileName);
+
+	piece FilePiece = ReadVfsFile(FileName);
+	if (FilePiece.Base) {
+		packed_image_header *Header = 0;
+		packed_image_chunk *Chunks = 0;
+		if (FilePiece.Size >= sizeof(packed_image_header)) {
+			Header = (packed_image_header *)FilePiece.Base;
+			if (Header->ChunkCount <= ((FilePiece.Size - sizeof(packed_image_header)) / sizeof(packed_image_chunk)))
+				Chunks = (packed_image_chunk *)(Header + 1);
+		}
+
+		if (Chunks && (Header->Signature == PACKED_IMAGE_SIGNATURE) && (Header->Version == PACKED_IMAGE_VERSION)) {
+			// NOTE(ivan): Bounded dimensions keep the pitch from overflowing, the chunk count is checked in 64 bits
+			// so a huge RowsPerChunk cannot wrap around to zero chunks.
+			b32 IsValid = ((Header->Width > 0) && (Header->Height > 0) &&
+						   (Header->Width <= PACKED_IMAGE_MAX_DIMENSION) && (Header->Height <= PACKED_IMAGE_MAX_DIMENSION) &&
+						   (Header->RowsPerChunk > 0) &&
+						   (Header->ChunkCount == (((u64)Header->Height + Header->RowsPerChunk - 1) / Header->RowsPerChunk)));
+			for (u32 Index = 0; IsValid && (Index < Header->ChunkCount); Index++) {
+				if ((Chunks[Index].Offset > FilePiece.Size) ||
+					(Chunks[Index].CompressedSize > (FilePiece.Size - Chunks[Index].Offset)))
+					IsValid = false;
+			}
+
+			if (IsValid) {
+				s32 Pitch = Header->Width * 4;
+
+				// NOTE(ivan): Pixels stay in the heap on success, the work array lives in this thread's scratch heap.
+				temporary_memory ImageMemory = BeginTemporaryMemory(Heap);
+				u32 *Pixels = (u32 *)PushSize(Heap, (uptr)Pitch * Header->Height);
+
+				temporary_memory WorkMemory = BeginTemporaryMemory(&GameTLState.ScratchHeap);
+				packed_image_chunk_work *Works = PushArray(&GameTLState.ScratchHeap, packed_image_chunk_work, Header->ChunkCount);
+				job *Jobs = PushArray(&GameTLState.ScratchHeap, job, Header->ChunkCount);
+				if (Pixels && Works && Jobs) {
+					for (u32 Index = 0; Index < Header->ChunkCount; Index++) {
+						u32 FirstRow = Index * Header->RowsPerChunk;
+						u32 RowCount = Min(Header->RowsPerChunk, (u32)Header->Height - FirstRow);
+
+						packed_image_chunk_work *Work = Works + Index;
+						Work->Src = FilePiece.Base + Chunks[Index].Offset;
+						Work->SrcSize = Chunks[Index].CompressedSize;
+						Work->Dst = (u8 *)Pixels + ((uptr)FirstRow * Pitch);
+						Work->DstSize = (uptr)RowCount * Pitch;
+						Work->IsDecoded = false;
+
+						Jobs[Index].Callback = DecodePackedImageChunk;
+						Jobs[Index].Data = Work;
+					}
+
+					// NOTE(ivan): Chunks do not overlap in the destination, any thread can take any of them.
+					// Jobs rather than work queue entries, so images can be loaded from inside a job too.
+					job_counter Counter = {};
+					PlatformRunJobs(Jobs, Header->ChunkCount, &Counter);
+					PlatformWaitForCounter(&Counter);
+
+					b32 IsDecoded = true;
+					for (u32 Index = 0; Index < Header->ChunkCount; Index++)
+						IsDecoded = IsDecoded && Works[Index].IsDecoded;
+
+					if (IsDecoded) {
+						Result.Pixels = Pixels;
+						Result.Width = Header->Width;
+						Result.Height = Header->Height;
+						Result.BytesPerPixel = 4;
+						Result.Pitch = Pitch;
+					} else {
+						GameTLState.LastError = ErrorCode_PackLoader_CorruptedChunk;
+					}
+				}
+				EndTemporaryMemory(WorkMemory);
+
+				if (Result.Pixels)
+					CommitTemporaryMemory(ImageMemory);
+				else
+					EndTemporaryMemory(ImageMemory);
+			} else {
+				GameTLState.LastError = ErrorCode_PackLoader_CorruptedHeader;
+			}
+		} else {
+			GameTLState.LastError = ErrorCode_WrongSignature;
+		}
+
+		FreeVfsFile(&FilePiece);
+	} else {
+		// NOTE(ivan): Not found.
+		// NOTE(ivan): LastError is already set to GameError_NotFound.
+	}
+
+	return Result;
+}
+
+b32
+WriteImagePacked(const char *FileName, image *Image, memory_heap *TempHeap) {
+	Assert(FileName);
+	Assert(Image);
+	Assert(Image->Pixels);
+	Assert(Image->BytesPerPixel == 4);
+	Assert(TempHeap);
+
+	b32 Result = false;
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	// NOTE(ivan): LoadImagePacked() refuses anything larger.
+	if ((Image->Width <= 0) || (Image->Height <= 0) ||
+		(Image->Width > PACKED_IMAGE_MAX_DIMENSION) || (Image->Height > PACKED_IMAGE_MAX_DIMENSION))
+		return false;
+
+	s32 RowSize = Image->Width * 4;
+	u32 RowsPerChunk = Min(Max((u32)(PACKED_IMAGE_CHUNK_SIZE / RowSize), 1U), (u32)Image->Height);
+	u32 ChunkCount = ((u32)Image->Height + RowsPerChunk - 1) / RowsPerChunk;
+	uptr ChunkBound = GetLZCompressBound((uptr)RowsPerChunk * RowSize);
+	uptr HeadersSize = sizeof(packed_image_header) + (sizeof(packed_image_chunk) * ChunkCount);
+
+	temporary_memory TempMemory = BeginTemporaryMemory(TempHeap);
+	u8 *Output = (u8 *)PushSize(TempHeap, HeadersSize + (ChunkBound * ChunkCount));
+	u8 *RowsScratch = (u8 *)PushSize(TempHeap, (uptr)RowsPerChunk * RowSize);
+	if (Output && RowsScratch) {
+		packed_image_header *Header = (packed_image_header *)Output;
+		packed_image_chunk *Chunks = (packed_image_chunk *)(Header + 1);
+		Header->Signature = PACKED_IMAGE_SIGNATURE;
+		Header->Version = PACKED_IMAGE_VERSION;
+		Header->Width = Image->Width;
+		Header->Height = Image->Height;
+		Header->RowsPerChunk = RowsPerChunk;
+		Header->ChunkCount = ChunkCount;
+
+		u8 *At = Output + HeadersSize;
+		for (u32 Index = 0; Index < ChunkCount; Index++) {
+			u32 FirstRow = Index * RowsPerChunk;
+			u32 RowCount = Min(RowsPerChunk, (u32)Image->Height - FirstRow);
+
+			// NOTE(ivan): Chunks are stored tightly packed, gather the rows if the image has a wider pitch.
+			u8 *Rows = (u8 *)Image->Pixels + ((uptr)FirstRow * Image->Pitch);
+			if (Image->Pitch != RowSize) {
+				for (u32 Row = 0; Row < RowCount; Row++)
+					memcpy(RowsScratch + ((uptr)Row * RowSize), Rows + ((uptr)Row * Image->Pitch), RowSize);
+				Rows = RowsScratch;
+			}
+
+			uptr CompressedSize = CompressLZ(Rows, (uptr)RowCount * RowSize, At, ChunkBound);
+			Chunks[Index].Offset = SafeTruncateU64(At - Output);
+			Chunks[Index].CompressedSize = SafeTruncateU64(CompressedSize);
+			At += CompressedSize;
+		}
+
+		Result = PlatformWriteEntireFile(FileName, Output, At - Output);
+	}
+	EndTemporaryMemory(TempMemory);
+
+	return Result;
+}
+
+image
+LoadImageByExtension(const char *FileName, memory_heap *Heap) {
+	Assert(FileName);
+	Assert(Heap);
+
+	image Result = {};
+
+	char Extension[16] = {};
+	ExtractFileExtension(Extension, CountOf(Extension) - 1, FileName);
+	if (strcmp(Extension, "bmp") == 0)
+		Result = LoadImageBmp(FileName, Heap);
+	else if (strcmp(Extension, "png") == 0)
+		Result = LoadImagePng(FileName, Heap);
+	else if (strcmp(Extension, "qoi") == 0)
+		Result = LoadImageQoi(FileName, Heap);
+	else if (strcmp(Extension, "qpk") == 0)
+		Result = LoadImagePacked(FileName, Heap);
+	else
+		GameTLState.LastError = ErrorCode_WrongSignature;
+
+	return Result;
+}
+
+u32
+AddImageAsset(game_assets *Assets, const char *FileName, memory_heap *Heap) {
+	Assert(Assets);
+	Assert(FileName);
+	Assert(Heap);
+
+	if (Assets->SlotCount == CountOf(Assets->Slots))
+		return INVALID_ASSET_ID;
+
+	image Image = LoadImageByExtension(FileName, Heap);
+	if (!Image.Pixels)
+		return INVALID_ASSET_ID;
+
+	u32 Result = Assets->SlotCount++;
+	asset_slot *Slot = &Assets->Slots[Result];
+	strncpy(Slot->FileName, FileName, CountOf(Slot->FileName) - 1);
+	Slot->Image = Image;
+	Slot->PixelsSize = (uptr)Image.Pitch * Image.Height;
+	Slot->IsChanged = false;
+#if INTERNAL
+	// NOTE(ivan): Only loose files can be watched, pack contents stay as mounted.
+	char RealFileName[512];
+	if (ResolveVfsPath(FileName, RealFileName, CountOf(RealFileName)))
+		Slot->FileWatch = PlatformWatchFile(RealFileName);
+	else if (!GlobalVfs)
+		Slot->FileWatch = PlatformWatchFile(FileName);
+	else
+		Slot->FileWatch = FILE_WATCH_INVALID;
+#else
+	Slot->FileWatch = FILE_WATCH_INVALID;
+#endif
+
+	return Result;
+}
+
+image *
+GetImageAsset(game_assets *Assets, u32 AssetID) {
+	Assert(Assets);
+	Assert(AssetID < Assets->SlotCount);
+
+	return &Assets->Slots[AssetID].Image;
+}
+
+// NOTE(ivan): Work queue callback, every reload of a batch is one entry.
+static void
+DecodeAssetReload(void *Data) {
+	asset_reload *Reload = (asset_reload *)Data;
+	Assert(Reload);
+
+	PROFILE_BLOCK("DecodeAssetReload");
+	Reload->Image = LoadImageByExtension(Reload->FileName, &Reload->Heap);
+
+	// NOTE(ivan): The game thread takes the image as soon as it sees the reload done.
+	CompilerBarrier();
+	Reload->IsDone = true;
+}
+
+void
+ReloadChangedAssets(game_assets *Assets, memory_heap *Heap) {
+	Assert(Assets);
+	Assert(Heap);
+
+	// NOTE(ivan): Swap in the batch started on an earlier frame, once all of it is decoded.
+	if (Assets->ReloadCount) {
+		for (u32 Index = 0; Index < Assets->ReloadCount; Index++) {
+			if (!Assets->Reloads[Index].IsDone)
+				return;
+		}
+
+		for (u32 Index = 0; Index < Assets->ReloadCount; Index++) {
+			asset_reload *Reload = &Assets->Reloads[Index];
+			asset_slot *Slot = &Assets->Slots[Reload->AssetID];
+
+			// NOTE(ivan): The staging heap goes to the next batch, the slot gets a copy of its own.
+			// The copy goes over the old pixels when it fits, only a larger image takes new room from the heap
+			// (the old pixels are not reclaimed then), so saving the same file over and over does not use the heap up.
+			image *Image = &Reload->Image;
+			uptr Size = (uptr)Image->Pitch * Image->Height;
+			u32 *Pixels = 0;
+			if (Image->Pixels) {
+				if (Size <= Slot->PixelsSize) {
+					Pixels = Slot->Image.Pixels;
+				} else {
+					Pixels = (u32 *)PushSize(Heap, Size);
+					if (Pixels)
+						Slot->PixelsSize = Size;
+				}
+			}
+			if (Pixels) {
+				CopyBytes(Pixels, Image->Pixels, Size);
+				Slot->Image = *Image;
+				Slot->Image.Pixels = Pixels;
+				DEBUGPlatformOutf("Asset reloaded: %s", Slot->FileName);
+			} else {
+				DEBUGPlatformOutf("Asset reload failed, keeping the previous image: %s", Slot->FileName);
+			}
+		}
+
+		Assets->ReloadCount = 0;
+	}
+
+	// NOTE(ivan): A fired watch is remembered in the slot until a batch takes the file,
+	// so files past a full batch, or waiting for staging memory, are not lost.
+	b32 IsAnyChanged = false;
+	for (u32 Index = 0; Index < Assets->SlotCount; Index++) {
+		asset_slot *Slot = &Assets->Slots[Index];
+		if ((Slot->FileWatch != FILE_WATCH_INVALID) && PlatformIsFileChanged(Slot->FileWatch))
+			Slot->IsChanged = true;
+		IsAnyChanged |= Slot->IsChanged;
+	}
+	if (!IsAnyChanged)
+		return;
+
+	if (!Assets->ReloadMemory) {
+		// NOTE(ivan): No more than a quarter of what is left, files too large for that fail to reload.
+		Assets->ReloadHeapSize = Min((uptr)ASSET_RELOAD_HEAP_SIZE, (Heap->Size - Heap->Used) / (4 * MAX_ASSET_RELOADS));
+		if (Assets->ReloadHeapSize >= Megabytes(1))
+			Assets->ReloadMemory = (u8 *)PushSize(Heap, MAX_ASSET_RELOADS * Assets->ReloadHeapSize);
+		if (!Assets->ReloadMemory) {
+			if (!Assets->IsReloadMemoryShort)
+				DEBUGPlatformOutf("Not enough memory to reload assets!");
+			Assets->IsReloadMemoryShort = true;
+			return;
+		}
+	}
+
+	// NOTE(ivan): Start the next batch.
+	u32 ReloadCount = 0;
+	for (u32 Index = 0; (Index < Assets->SlotCount) && (ReloadCount < MAX_ASSET_RELOADS); Index++) {
+		asset_slot *Slot = &Assets->Slots[Index];
+		if (!Slot->IsChanged)
+			continue;
+		Slot->IsChanged = false;
+
+		asset_reload *Reload = &Assets->Reloads[ReloadCount];
+		Reload->AssetID = Index;
+		Reload->FileName = Slot->FileName;
+		InitializeHeap(&Reload->Heap, Assets->ReloadMemory + (ReloadCount * Assets->ReloadHeapSize), Assets->ReloadHeapSize);
+		Reload->Image = {};
+		Reload->IsDone = false;
+		ReloadCount++;
+	}
+
+	Assets->ReloadCount = ReloadCount;
+	for (u32 Index = 0; Index < ReloadCount; Index++)
+		PlatformAddWorkQueueEntry(DecodeAssetReload, &Assets->Reloads[Index]);
+
+	// NOTE(ivan): Without workers nobody would pick the batch up, decode it right here instead.
+	if (ReloadCount && !PlatformGetWorkerCount())
+		PlatformCompleteAllWork();
+}
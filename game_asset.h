@@ -10,5 +10,83 @@
 
 #include "game_memory.h"
 #include "game_image.h"
+#include "game_compress.h"
+
+// NOTE(ivan): Packed image file layout:
+// [packed_image_header] [packed_image_chunk * ChunkCount] [LZ-compressed chunks data]
+// Every chunk holds a run of whole rows compressed independently of the others,
+// so any number of threads can decode one image straight into its final memory.
+#define PACKED_IMAGE_SIGNATURE FourCC("QPKI")
+#define PACKED_IMAGE_VERSION 1
+#define PACKED_IMAGE_CHUNK_SIZE Kilobytes(256) // NOTE(ivan): Approximate raw size of a chunk.
+#define PACKED_IMAGE_MAX_DIMENSION 32768
+
+#pragma pack(push, 1)
+struct packed_image_header {
+	u32 Signature;
+	u32 Version;
+	s32 Width;
+	s32 Height;
+	u32 RowsPerChunk;
+	u32 ChunkCount;
+};
+
+struct packed_image_chunk {
+	u32 Offset; // NOTE(ivan): From the beginning of the file.
+	u32 CompressedSize;
+};
+#pragma pack(pop)
+
+// NOTE(ivan): One unit of chunk decoding work.
+struct packed_image_chunk_work {
+	u8 *Src;
+	uptr SrcSize;
+	u8 *Dst;
+	uptr DstSize;
+	b32 IsDecoded;
+};
+
+image LoadImagePacked(const char *FileName, memory_heap *Heap);
+b32 WriteImagePacked(const char *FileName, image *Image, memory_heap *TempHeap);
+
+// NOTE(ivan): Image asset slot. In internal builds the source file is watched, changed files are re-decoded
+// in the background by work queue entries, each into a staging heap of its own, and the slots get the new images
+// at the first frame boundary after the whole batch is decoded. A broken or half-written file keeps the previous image.
+#define MAX_ASSET_SLOTS 256
+#define INVALID_ASSET_ID ((u32)-1)
+#define MAX_ASSET_RELOADS 4 // NOTE(ivan): Per batch, files changed past that wait for the next one.
+#define ASSET_RELOAD_HEAP_SIZE Megabytes(128) // NOTE(ivan): Decoded pixels and decoder temporaries of one file, at most.
+
+struct asset_slot {
+	char FileName[256];
+	s32 FileWatch;
+	b32 IsChanged; // NOTE(ivan): The watch fired, the file waits for a batch to take it.
+	image Image;
+	uptr PixelsSize; // NOTE(ivan): Room behind Image.Pixels, reloads that fit are copied in place.
+};
+
+struct asset_reload {
+	u32 AssetID;
+	const char *FileName; // NOTE(ivan): Of the slot, it does not change while the reload is in flight.
+	memory_heap Heap; // NOTE(ivan): Staging, reused by the next batch.
+	image Image; // NOTE(ivan): Pixels are 0 if the file could not be decoded.
+	volatile b32 IsDone;
+};
+
+struct game_assets {
+	u32 SlotCount;
+	asset_slot Slots[MAX_ASSET_SLOTS];
+
+	u8 *ReloadMemory; // NOTE(ivan): Staging heaps, taken from the heap by the first reload.
+	uptr ReloadHeapSize;
+	b32 IsReloadMemoryShort; // NOTE(ivan): Staging heaps could not be taken, said once.
+	u32 ReloadCount; // NOTE(ivan): Of the batch being decoded, 0 if there is none.
+	asset_reload Reloads[MAX_ASSET_RELOADS];
+};
+
+image LoadImageByExtension(const char *FileName, memory_heap *Heap);
+u32 AddImageAsset(game_assets *Assets, const char *FileName, memory_heap *Heap);
+image * GetImageAsset(game_assets *Assets, u32 AssetID);
+void ReloadChangedAssets(game_assets *Assets, memory_heap *Heap);
 
 #endif // #ifndef GAME_ASSET_H
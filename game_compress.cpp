@@ -0,0 +1,642 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#include "game_compress.h"
+
+inline u32
+LoadU32(const u8 *At) {
+	u32 Result;
+	memcpy(&Result, At, sizeof(Result));
+	return Result;
+}
+
+inline u64
+LoadU64(const u8 *At) {
+	u64 Result;
+	memcpy(&Result, At, sizeof(Result));
+	return Result;
+}
+
+inline void
+StoreU64(u8 *At, u64 Value) {
+	memcpy(At, &Value, sizeof(Value));
+}
+
+inline u32
+CountTrailingZeroBytesU64(u64 Value) {
+	Assert(Value);
+
+#if MSVC
+	unsigned long Index;
+	_BitScanForward64(&Index, Value);
+	return (u32)(Index >> 3);
+#else
+	return (u32)(__builtin_ctzll(Value) >> 3);
+#endif
+}
+
+inline u32
+HashLZSequence(u32 Sequence) {
+	return (Sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// NOTE(ivan): Copies in 16-byte strides, may write up to 15 bytes past Dst + Size.
+inline void
+WildCopy16(u8 *Dst, const u8 *Src, uptr Size) {
+	u8 *DstEnd = Dst + Size;
+	do {
+		_mm_storeu_si128((__m128i *)Dst, _mm_loadu_si128((const __m128i *)Src));
+		Dst += 16;
+		Src += 16;
+	} while (Dst < DstEnd);
+}
+
+static u8 *
+EmitLZLengthExtension(u8 *Op, uptr Length) {
+	while (Length >= 255) {
+		*Op++ = 255;
+		Length -= 255;
+	}
+	*Op++ = (u8)Length;
+
+	return Op;
+}
+
+static u8 *
+EmitLZLiterals(u8 *Op, u8 *Token, const u8 *Literals, uptr LiteralCount) {
+	if (LiteralCount >= 15) {
+		*Token = (15 << 4);
+		Op = EmitLZLengthExtension(Op, LiteralCount - 15);
+	} else {
+		*Token = (u8)(LiteralCount << 4);
+	}
+
+	memcpy(Op, Literals, LiteralCount);
+	return Op + LiteralCount;
+}
+
+uptr
+CompressLZ(const void *SrcInit, uptr SrcSize, void *DstInit, uptr DstCapacity) {
+	Assert(SrcInit || !SrcSize);
+	Assert(DstInit);
+	Assert(DstCapacity >= GetLZCompressBound(SrcSize));
+	UnusedParam(DstCapacity);
+
+	const u8 *Src = (const u8 *)SrcInit;
+	const u8 *SrcEnd = Src + SrcSize;
+	const u8 *Ip = Src;
+	const u8 *Anchor = Src;
+	u8 *Dst = (u8 *)DstInit;
+	u8 *Op = Dst;
+
+	if (SrcSize > LZ_MATCH_FIND_LIMIT) {
+		// NOTE(ivan): Positions are stored relative to Src, so a zeroed table just points to the block start.
+		u32 HashTable[1 << LZ_HASH_BITS];
+		memset(HashTable, 0, sizeof(HashTable));
+
+		const u8 *MatchLimit = SrcEnd - LZ_LAST_LITERALS;
+		const u8 *IpLimit = SrcEnd - LZ_MATCH_FIND_LIMIT;
+
+		Ip++;
+		while (Ip < IpLimit) {
+			u32 Sequence = LoadU32(Ip);
+			u32 Hash = HashLZSequence(Sequence);
+			const u8 *Match = Src + HashTable[Hash];
+			HashTable[Hash] = (u32)(Ip - Src);
+
+			if ((Match >= Ip) || ((Ip - Match) > LZ_MAX_OFFSET) || (LoadU32(Match) != Sequence)) {
+				// NOTE(ivan): Step faster through incompressible regions.
+				Ip += 1 + ((Ip - Anchor) >> 6);
+				continue;
+			}
+
+			// NOTE(ivan): Extend the match backwards into pending literals.
+			while ((Ip > Anchor) && (Match > Src) && (Ip[-1] == Match[-1])) {
+				Ip--;
+				Match--;
+			}
+
+			// NOTE(ivan): Extend the match forward, 8 bytes at a time while possible.
+			const u8 *MatchEnd = Ip + LZ_MIN_MATCH;
+			const u8 *Ref = Match + LZ_MIN_MATCH;
+			b32 IsMismatchFound = false;
+			while ((MatchEnd + 8) <= MatchLimit) {
+				u64 Diff = LoadU64(MatchEnd) ^ LoadU64(Ref);
+				if (Diff) {
+					MatchEnd += CountTrailingZeroBytesU64(Diff);
+					IsMismatchFound = true;
+					break;
+				}
+				MatchEnd += 8;
+				Ref += 8;
+			}
+			if (!IsMismatchFound) {
+				while ((MatchEnd < MatchLimit) && (*MatchEnd == *Ref)) {
+					MatchEnd++;
+					Ref++;
+				}
+			}
+
+			u8 *Token = Op++;
+			Op = EmitLZLiterals(Op, Token, Anchor, Ip - Anchor);
+
+			uptr Offset = (uptr)(Ip - Match);
+			*Op++ = (u8)(Offset & 0xFF);
+			*Op++ = (u8)(Offset >> 8);
+
+			uptr MatchLength = (uptr)(MatchEnd - Ip) - LZ_MIN_MATCH;
+			if (MatchLength >= 15) {
+				*Token |= 15;
+				Op = EmitLZLengthExtension(Op, MatchLength - 15);
+			} else {
+				*Token |= (u8)MatchLength;
+			}
+
+			Ip = MatchEnd;
+			Anchor = Ip;
+
+			// NOTE(ivan): Prime the table with a position inside the match for better ratios on repetitive data.
+			if (Ip < IpLimit)
+				HashTable[HashLZSequence(LoadU32(Ip - 2))] = (u32)(Ip - 2 - Src);
+		}
+	}
+
+	// NOTE(ivan): Last literals.
+	u8 *Token = Op++;
+	Op = EmitLZLiterals(Op, Token, Anchor, SrcEnd - Anchor);
+
+	return (uptr)(Op - Dst);
+}
+
+b32
+DecompressLZ(const void *SrcInit, uptr SrcSize, void *DstInit, uptr DstSize) {
+	Assert(SrcInit);
+	Assert(DstInit || !DstSize);
+
+	const u8 *Ip = (const u8 *)SrcInit;
+	const u8 *IpEnd = Ip + SrcSize;
+	u8 *Dst = (u8 *)DstInit;
+	u8 *Op = Dst;
+	u8 *OpEnd = Dst + DstSize;
+
+	for (;;) {
+		if (Ip >= IpEnd)
+			return false;
+		u32 Token = *Ip++;
+
+		// NOTE(ivan): Literals.
+		uptr LiteralCount = (Token >> 4);
+		if (LiteralCount == 15) {
+			u32 Byte;
+			do {
+				if (Ip >= IpEnd)
+					return false;
+				Byte = *Ip++;
+				LiteralCount += Byte;
+			} while (Byte == 255);
+		}
+
+		if ((LiteralCount > (uptr)(IpEnd - Ip)) || (LiteralCount > (uptr)(OpEnd - Op)))
+			return false;
+		if (((uptr)(IpEnd - Ip) >= (LiteralCount + 16)) && ((uptr)(OpEnd - Op) >= (LiteralCount + 16)))
+			WildCopy16(Op, Ip, LiteralCount);
+		else
+			memcpy(Op, Ip, LiteralCount);
+		Ip += LiteralCount;
+		Op += LiteralCount;
+
+		// NOTE(ivan): Last sequence carries literals only.
+		if (Ip == IpEnd)
+			return (Op == OpEnd);
+
+		// NOTE(ivan): Match.
+		if ((IpEnd - Ip) < 2)
+			return false;
+		uptr Offset = (uptr)Ip[0] | ((uptr)Ip[1] << 8);
+		Ip += 2;
+		if ((Offset == 0) || (Offset > (uptr)(Op - Dst)))
+			return false;
+
+		uptr MatchLength = (Token & 15);
+		if (MatchLength == 15) {
+			u32 Byte;
+			do {
+				if (Ip >= IpEnd)
+					return false;
+				Byte = *Ip++;
+				MatchLength += Byte;
+			} while (Byte == 255);
+		}
+		MatchLength += LZ_MIN_MATCH;
+		if (MatchLength > (uptr)(OpEnd - Op))
+			return false;
+
+		const u8 *Match = Op - Offset;
+		uptr Room = (uptr)(OpEnd - Op);
+		if ((Offset >= 16) && (Room >= (MatchLength + 16))) {
+			// NOTE(ivan): Source and destination never overlap within one 16-byte stride.
+			WildCopy16(Op, Match, MatchLength);
+		} else if ((Offset >= 8) && (Room >= (MatchLength + 8))) {
+			u8 *CopyAt = Op;
+			u8 *CopyEnd = Op + MatchLength;
+			do {
+				StoreU64(CopyAt, LoadU64(Match));
+				CopyAt += 8;
+				Match += 8;
+			} while (CopyAt < CopyEnd);
+		} else if (Room >= (MatchLength + 8)) {
+			// NOTE(ivan): Short offsets repeat a pattern (a run of equal pixels is offset 4).
+			// Seed the first 8 bytes one by one, then keep copying in 8-byte strides
+			// from the nearest multiple of the pattern period that is at least 8 bytes behind.
+			for (u32 Index = 0; Index < 8; Index++)
+				Op[Index] = Match[Index];
+
+			uptr Period = Offset;
+			while (Period < 8)
+				Period += Offset;
+
+			u8 *CopyAt = Op + 8;
+			u8 *CopyEnd = Op + MatchLength;
+			while (CopyAt < CopyEnd) {
+				StoreU64(CopyAt, LoadU64(CopyAt - Period));
+				CopyAt += 8;
+			}
+		} else {
+			// NOTE(ivan): Close to the end of the buffer, go byte by byte.
+			for (uptr Index = 0; Index < MatchLength; Index++)
+				Op[Index] = Match[Index];
+		}
+		Op += MatchLength;
+	}
+}
+
+// NOTE(ivan): Inflate bit reader, bits are consumed from the least significant end.
+struct inflate_stream {
+	const u8 *At;
+	const u8 *End;
+	u64 BitBuffer;
+	u32 BitCount;
+	u32 OverrunBytes; // NOTE(ivan): Zero bytes fed past the end of the input.
+
+	u8 *Dst;
+	u8 *Op;
+	u8 *OpEnd;
+
+	inflate_huffman Lengths;
+	inflate_huffman Distances;
+};
+
+static const u16 InflateLengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+										35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const u8 InflateLengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+										3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const u16 InflateDistanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+										  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const u8 InflateDistanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+										  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const u8 InflateCodeLengthOrder[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+inline u32
+ReverseBits16(u32 Value) {
+	Value = ((Value & 0xAAAA) >> 1) | ((Value & 0x5555) << 1);
+	Value = ((Value & 0xCCCC) >> 2) | ((Value & 0x3333) << 2);
+	Value = ((Value & 0xF0F0) >> 4) | ((Value & 0x0F0F) << 4);
+	Value = ((Value & 0xFF00) >> 8) | ((Value & 0x00FF) << 8);
+	return Value;
+}
+
+inline void
+RefillInflateBits(inflate_stream *Stream) {
+	if ((Stream->End - Stream->At) >= 8) {
+		// NOTE(ivan): Branchless refill, tops the buffer up to 56..63 bits.
+		Stream->BitBuffer |= (LoadU64(Stream->At) << Stream->BitCount);
+		Stream->At += ((63 - Stream->BitCount) >> 3);
+		Stream->BitCount |= 56;
+	} else {
+		while (Stream->BitCount <= 56) {
+			u64 Byte = 0;
+			if (Stream->At < Stream->End)
+				Byte = *Stream->At++;
+			else
+				Stream->OverrunBytes++;
+			Stream->BitBuffer |= (Byte << Stream->BitCount);
+			Stream->BitCount += 8;
+		}
+	}
+}
+
+inline u32
+ReadInflateBits(inflate_stream *Stream, u32 Count) {
+	Assert(Count <= 32);
+	if (Stream->BitCount < Count)
+		RefillInflateBits(Stream);
+
+	u32 Result = (u32)(Stream->BitBuffer & ((1ULL << Count) - 1));
+	Stream->BitBuffer >>= Count;
+	Stream->BitCount -= Count;
+
+	return Result;
+}
+
+static b32
+BuildInflateHuffman(inflate_huffman *Huffman, const u8 *CodeLengths, u32 Count) {
+	Assert(Huffman);
+	Assert(CodeLengths);
+	Assert(Count <= INFLATE_MAX_SYMBOLS);
+
+	s32 Sizes[17] = {};
+	s32 NextCode[16];
+	memset(Huffman->Fast, 0, sizeof(Huffman->Fast));
+
+	for (u32 Index = 0; Index < Count; Index++)
+		Sizes[CodeLengths[Index]]++;
+	Sizes[0] = 0;
+	for (u32 Index = 1; Index < 16; Index++) {
+		if (Sizes[Index] > (1 << Index))
+			return false;
+	}
+
+	s32 Code = 0;
+	s32 Symbol = 0;
+	for (u32 Index = 1; Index < 16; Index++) {
+		NextCode[Index] = Code;
+		Huffman->FirstCode[Index] = (u16)Code;
+		Huffman->FirstSymbol[Index] = (u16)Symbol;
+		Code += Sizes[Index];
+		if (Sizes[Index] && ((Code - 1) >= (1 << Index)))
+			return false;
+		Huffman->MaxCode[Index] = Code << (16 - Index);
+		Code <<= 1;
+		Symbol += Sizes[Index];
+	}
+	Huffman->MaxCode[16] = 0x10000; // NOTE(ivan): Sentinel.
+
+	for (u32 Index = 0; Index < Count; Index++) {
+		s32 Size = CodeLengths[Index];
+		if (Size) {
+			s32 Slot = NextCode[Size] - Huffman->FirstCode[Size] + Huffman->FirstSymbol[Size];
+			Huffman->Size[Slot] = (u8)Size;
+			Huffman->Value[Slot] = (u16)Index;
+			if (Size <= INFLATE_FAST_BITS) {
+				u16 FastValue = (u16)((Size << 9) | Index);
+				u32 Fast = ReverseBits16(NextCode[Size]) >> (16 - Size);
+				while (Fast < (1 << INFLATE_FAST_BITS)) {
+					Huffman->Fast[Fast] = FastValue;
+					Fast += (1 << Size);
+				}
+			}
+			NextCode[Size]++;
+		}
+	}
+
+	return true;
+}
+
+// NOTE(ivan): Returns -1 on an invalid code.
+inline s32
+DecodeInflateSymbol(inflate_stream *Stream, inflate_huffman *Huffman) {
+	if (Stream->BitCount < 16)
+		RefillInflateBits(Stream);
+
+	u32 Fast = Huffman->Fast[Stream->BitBuffer & ((1 << INFLATE_FAST_BITS) - 1)];
+	if (Fast) {
+		u32 Size = (Fast >> 9);
+		Stream->BitBuffer >>= Size;
+		Stream->BitCount -= Size;
+		return (s32)(Fast & 511);
+	}
+
+	// NOTE(ivan): Slow path for long codes, compare against the canonical code ranges.
+	s32 Code = (s32)ReverseBits16((u32)(Stream->BitBuffer & 0xFFFF));
+	u32 Size;
+	for (Size = INFLATE_FAST_BITS + 1; Size < 16; Size++) {
+		if (Code < Huffman->MaxCode[Size])
+			break;
+	}
+	if (Size >= 16)
+		return -1;
+
+	s32 Slot = (Code >> (16 - Size)) - Huffman->FirstCode[Size] + Huffman->FirstSymbol[Size];
+	if ((Slot >= INFLATE_MAX_SYMBOLS) || (Huffman->Size[Slot] != Size))
+		return -1;
+
+	Stream->BitBuffer >>= Size;
+	Stream->BitCount -= Size;
+	return Huffman->Value[Slot];
+}
+
+static b32
+ReadInflateDynamicTables(inflate_stream *Stream) {
+	u32 LengthCount = ReadInflateBits(Stream, 5) + 257;
+	u32 DistanceCount = ReadInflateBits(Stream, 5) + 1;
+	u32 CodeLengthCount = ReadInflateBits(Stream, 4) + 4;
+
+	// NOTE(ivan): HLIT and HDIST can encode up to 288 and 32 codes, RFC 1951 only allows 286 and 30.
+	if ((LengthCount > 286) || (DistanceCount > 30))
+		return false;
+
+	u8 CodeLengthSizes[19] = {};
+	for (u32 Index = 0; Index < CodeLengthCount; Index++)
+		CodeLengthSizes[InflateCodeLengthOrder[Index]] = (u8)ReadInflateBits(Stream, 3);
+
+	inflate_huffman CodeLengths;
+	if (!BuildInflateHuffman(&CodeLengths, CodeLengthSizes, 19))
+		return false;
+
+	u8 Sizes[286 + 30];
+	u32 Total = LengthCount + DistanceCount;
+	u32 Count = 0;
+	while (Count < Total) {
+		s32 Symbol = DecodeInflateSymbol(Stream, &CodeLengths);
+		if ((Symbol < 0) || (Symbol > 18))
+			return false;
+
+		if (Symbol < 16) {
+			Sizes[Count++] = (u8)Symbol;
+		} else {
+			u8 Fill = 0;
+			u32 Repeat;
+			if (Symbol == 16) {
+				if (Count == 0)
+					return false;
+				Fill = Sizes[Count - 1];
+				Repeat = ReadInflateBits(Stream, 2) + 3;
+			} else if (Symbol == 17) {
+				Repeat = ReadInflateBits(Stream, 3) + 3;
+			} else {
+				Repeat = ReadInflateBits(Stream, 7) + 11;
+			}
+
+			if ((Total - Count) < Repeat)
+				return false;
+			memset(Sizes + Count, Fill, Repeat);
+			Count += Repeat;
+		}
+	}
+
+	if (!BuildInflateHuffman(&Stream->Lengths, Sizes, LengthCount))
+		return false;
+	if (!BuildInflateHuffman(&Stream->Distances, Sizes + LengthCount, DistanceCount))
+		return false;
+
+	return true;
+}
+
+static b32
+InflateHuffmanBlock(inflate_stream *Stream) {
+	for (;;) {
+		s32 Symbol = DecodeInflateSymbol(Stream, &Stream->Lengths);
+		if (Symbol < 256) {
+			if (Symbol < 0)
+				return false;
+			if (Stream->Op >= Stream->OpEnd)
+				return false;
+			*Stream->Op++ = (u8)Symbol;
+			continue;
+		}
+
+		if (Symbol == 256)
+			return (Stream->OverrunBytes <= 8);
+
+		Symbol -= 257;
+		if (Symbol >= (s32)CountOf(InflateLengthBase))
+			return false;
+		uptr Length = InflateLengthBase[Symbol] + ReadInflateBits(Stream, InflateLengthExtra[Symbol]);
+
+		Symbol = DecodeInflateSymbol(Stream, &Stream->Distances);
+		if ((Symbol < 0) || (Symbol >= (s32)CountOf(InflateDistanceBase)))
+			return false;
+		uptr Distance = InflateDistanceBase[Symbol] + ReadInflateBits(Stream, InflateDistanceExtra[Symbol]);
+
+		if ((Distance > (uptr)(Stream->Op - Stream->Dst)) || (Length > (uptr)(Stream->OpEnd - Stream->Op)))
+			return false;
+		if (Stream->OverrunBytes > 8)
+			return false;
+
+		u8 *Op = Stream->Op;
+		const u8 *Match = Op - Distance;
+		if ((Distance >= 8) && ((uptr)(Stream->OpEnd - Op) >= (Length + 8))) {
+			u8 *CopyEnd = Op + Length;
+			do {
+				StoreU64(Op, LoadU64(Match));
+				Op += 8;
+				Match += 8;
+			} while (Op < CopyEnd);
+		} else if (Distance == 1) {
+			memset(Op, *Match, Length);
+		} else {
+			for (uptr Index = 0; Index < Length; Index++)
+				Op[Index] = Match[Index];
+		}
+		Stream->Op += Length;
+	}
+}
+
+b32
+InflateZlib(const void *Src, uptr SrcSize, void *Dst, uptr DstCapacity, uptr *OutSize) {
+	Assert(Src);
+	Assert(Dst || !DstCapacity);
+	Assert(OutSize);
+
+	*OutSize = 0;
+
+	const u8 *Bytes = (const u8 *)Src;
+	if (SrcSize < 2)
+		return false;
+
+	// NOTE(ivan): Zlib header: deflate method, no preset dictionary, valid check bits.
+	u32 CMF = Bytes[0];
+	u32 FLG = Bytes[1];
+	if (((CMF & 15) != 8) || (((CMF << 8) | FLG) % 31) || (FLG & 32))
+		return false;
+
+	inflate_stream Stream;
+	Stream.At = Bytes + 2;
+	Stream.End = Bytes + SrcSize;
+	Stream.BitBuffer = 0;
+	Stream.BitCount = 0;
+	Stream.OverrunBytes = 0;
+	Stream.Dst = (u8 *)Dst;
+	Stream.Op = (u8 *)Dst;
+	Stream.OpEnd = (u8 *)Dst + DstCapacity;
+
+	b32 IsFinal;
+	do {
+		IsFinal = ReadInflateBits(&Stream, 1);
+		u32 Type = ReadInflateBits(&Stream, 2);
+		if (Type == 0) {
+			// NOTE(ivan): Stored block, realign to a byte boundary and give buffered bytes back.
+			ReadInflateBits(&Stream, Stream.BitCount & 7);
+			u32 BufferedBytes = (Stream.BitCount >> 3);
+			if (BufferedBytes < Stream.OverrunBytes)
+				return false;
+			Stream.At -= (BufferedBytes - Stream.OverrunBytes);
+			Stream.OverrunBytes = 0;
+			Stream.BitBuffer = 0;
+			Stream.BitCount = 0;
+
+			if ((Stream.End - Stream.At) < 4)
+				return false;
+			u32 Length = Stream.At[0] | (Stream.At[1] << 8);
+			u32 NLength = Stream.At[2] | (Stream.At[3] << 8);
+			Stream.At += 4;
+			if ((Length != (~NLength & 0xFFFF)) ||
+				(Length > (uptr)(Stream.End - Stream.At)) ||
+				(Length > (uptr)(Stream.OpEnd - Stream.Op)))
+				return false;
+
+			memcpy(Stream.Op, Stream.At, Length);
+			Stream.Op += Length;
+			Stream.At += Length;
+		} else if (Type == 1) {
+			// NOTE(ivan): Fixed Huffman codes.
+			u8 Sizes[288 + 32];
+			memset(Sizes, 8, 144);
+			memset(Sizes + 144, 9, 112);
+			memset(Sizes + 256, 7, 24);
+			memset(Sizes + 280, 8, 8);
+			memset(Sizes + 288, 5, 32);
+			if (!BuildInflateHuffman(&Stream.Lengths, Sizes, 288) ||
+				!BuildInflateHuffman(&Stream.Distances, Sizes + 288, 32))
+				return false;
+			if (!InflateHuffmanBlock(&Stream))
+				return false;
+		} else if (Type == 2) {
+			if (!ReadInflateDynamicTables(&Stream))
+				return false;
+			if (!InflateHuffmanBlock(&Stream))
+				return false;
+		} else {
+			return false;
+		}
+	} while (!IsFinal);
+
+	*OutSize = (uptr)(Stream.Op - Stream.Dst);
+	return true;
+}
+
+#if SLOWCODE
+void
+DEBUGCheckInflate(void) {
+	u8 Out[64];
+	uptr OutSize;
+
+	// NOTE(ivan): zlib's own output for "Quantic".
+	static const u8 Valid[] = {
+		0x78, 0xDA, 0x0B, 0x2C, 0x4D, 0xCC, 0x2B, 0xC9, 0x4C, 0x06, 0x00, 0x0B, 0x2A, 0x02, 0xD6
+	};
+	Assert(InflateZlib(Valid, sizeof(Valid), Out, sizeof(Out), &OutSize));
+	Assert((OutSize == 7) && (memcmp(Out, "Quantic", 7) == 0));
+
+	// NOTE(ivan): Dynamic block with HLIT = 31 and HDIST = 31, then three repeat-zero codes
+	// spelling out all 288 + 32 code lengths. Must be refused before any of them is stored.
+	static const u8 TooManyCodes[] = {
+		0x78, 0x01, 0xFD, 0x1F, 0x80, 0xE4, 0xFF, 0x7F, 0x08
+	};
+	Assert(!InflateZlib(TooManyCodes, sizeof(TooManyCodes), Out, sizeof(Out), &OutSize));
+}
+#endif
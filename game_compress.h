@@ -0,0 +1,59 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#ifndef GAME_COMPRESS_H
+#define GAME_COMPRESS_H
+
+#include "game_platform.h"
+
+// NOTE(ivan): LZ block format (LZ4-alike byte-aligned sequences):
+// [token: 4 bits literals count | 4 bits match length - LZ_MIN_MATCH]
+// [literals count extension bytes, 255 means "continue"] [literals]
+// [u16 match offset, little-endian] [match length extension bytes, 255 means "continue"]
+// The last sequence of a block consists of literals only, with no offset following them.
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+#define LZ_LAST_LITERALS 5 // NOTE(ivan): Last bytes of a block are always encoded as literals.
+#define LZ_MATCH_FIND_LIMIT 12 // NOTE(ivan): No match can start closer than this to the end of a block.
+
+// NOTE(ivan): Worst-case compressed size for a given raw size (incompressible data).
+inline uptr
+GetLZCompressBound(uptr RawSize) {
+	return RawSize + (RawSize / 255) + 16;
+}
+
+// NOTE(ivan): Returns compressed size, DstCapacity must be at least GetLZCompressBound(SrcSize).
+uptr CompressLZ(const void *Src, uptr SrcSize, void *Dst, uptr DstCapacity);
+
+// NOTE(ivan): Returns false if the block is corrupted or does not decode to exactly DstSize bytes.
+// Never reads past Src + SrcSize nor writes past Dst + DstSize.
+b32 DecompressLZ(const void *Src, uptr SrcSize, void *Dst, uptr DstSize);
+
+// NOTE(ivan): Zlib (RFC 1950) / deflate (RFC 1951) decoder.
+#define INFLATE_FAST_BITS 10 // NOTE(ivan): Huffman codes up to this length are decoded with a single table lookup.
+#define INFLATE_MAX_SYMBOLS 288
+
+struct inflate_huffman {
+	u16 Fast[1 << INFLATE_FAST_BITS]; // NOTE(ivan): (Length << 9) | Symbol, zero if the code is longer than INFLATE_FAST_BITS.
+	u16 FirstCode[16];
+	s32 MaxCode[17]; // NOTE(ivan): Pre-shifted to 16 bits.
+	u16 FirstSymbol[16];
+	u8 Size[INFLATE_MAX_SYMBOLS];
+	u16 Value[INFLATE_MAX_SYMBOLS];
+};
+
+// NOTE(ivan): Returns false on a corrupted stream or if the output does not fit into DstCapacity.
+// The Adler-32 checksum is not verified.
+b32 InflateZlib(const void *Src, uptr SrcSize, void *Dst, uptr DstCapacity, uptr *OutSize);
+
+#if SLOWCODE
+// NOTE(ivan): Asserts the decoder against a few known streams, malformed ones included.
+void DEBUGCheckInflate(void);
+#endif
+
+#endif // #ifndef GAME_COMPRESS_H
@@ -6,6 +6,7 @@
    $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
    ===================================================================== */
 #include "game_draw.h"
+#include "game_parallel.h"
 
 // NOTE(ivan): Blending resulting color.
 struct blending_result {
@@ -14,19 +15,50 @@ struct blending_result {
 	u8 B;
 };
 
+// NOTE(ivan): Source color is premultiplied by AlphaChannel, see image.
 inline blending_result
 DoLinearBlending(f32 AlphaChannel,
 				 u8 DstR, u8 DstG, u8 DstB,
 				 u8 SrcR, u8 SrcG, u8 SrcB) {
 	blending_result Result;
 
-	Result.R = (u8)roundf((1.0f - AlphaChannel) * DstR + AlphaChannel * SrcR);
-	Result.G = (u8)roundf((1.0f - AlphaChannel) * DstG + AlphaChannel * SrcG);
-	Result.B = (u8)roundf((1.0f - AlphaChannel) * DstB + AlphaChannel * SrcB);
+	Result.R = (u8)Min(roundf((1.0f - AlphaChannel) * DstR + SrcR), 255.0f);
+	Result.G = (u8)Min(roundf((1.0f - AlphaChannel) * DstG + SrcG), 255.0f);
+	Result.B = (u8)Min(roundf((1.0f - AlphaChannel) * DstB + SrcB), 255.0f);
 
 	return Result;
 }
 
+// NOTE(ivan): Colors are passed in straight, 0..255 per channel.
+inline v4
+PremultiplyColor(v4 Color) {
+	f32 AlphaChannel = Color.A / 255.0f;
+
+	v4 Result;
+	Result.R = Color.R * AlphaChannel;
+	Result.G = Color.G * AlphaChannel;
+	Result.B = Color.B * AlphaChannel;
+	Result.A = Color.A;
+
+	return Result;
+}
+
+// NOTE(ivan): Alpha is ignored, the whole buffer is overwritten.
+void
+ClearVideoBuffer(game_video_buffer *Buffer, v4 Color) {
+	Assert(Buffer);
+
+	u32 Color32 = (((u32)roundf(Color.R) << 16) |
+				   ((u32)roundf(Color.G) << 8) |
+				   ((u32)roundf(Color.B) << 0));
+
+	for (s32 Y = 0; Y < Buffer->Height; Y++) {
+		u32 *DstRow = (u32 *)((u8 *)Buffer->Pixels + (Y * Buffer->Pitch));
+		for (s32 X = 0; X < Buffer->Width; X++)
+			DstRow[X] = Color32;
+	}
+}
+
 void
 DrawPixel(game_video_buffer *Buffer, v2 Pos, v4 Color) {
 	Assert(Buffer);
@@ -34,6 +66,8 @@ DrawPixel(game_video_buffer *Buffer, v2 Pos, v4 Color) {
 	s32 PosX = (s32)roundf(Pos.X);
 	s32 PosY = (s32)roundf(Pos.Y);
 
+	Color = PremultiplyColor(Color);
+
 	u8 ColorR = (u8)roundf(Color.R);
 	u8 ColorG = (u8)roundf(Color.G);
 	u8 ColorB = (u8)roundf(Color.B);
@@ -58,7 +92,6 @@ DrawPixel(game_video_buffer *Buffer, v2 Pos, v4 Color) {
 	u32 SrcC = Color32;
 	u32 DstC = *DstPixel;
 
-	// TODO(ivan): Premultiplied alpha!!!
 	blending_result BlendingResult = DoLinearBlending(((SrcC >> 24) & 0xFF) / 255.0f,
 													  (u8)((DstC >> 16) & 0xFF),
 													  (u8)((DstC >> 8) & 0xFF),
@@ -71,6 +104,43 @@ DrawPixel(game_video_buffer *Buffer, v2 Pos, v4 Color) {
 				((u32)BlendingResult.B << 0));
 }
 
+void
+DrawRectangle(game_video_buffer *Buffer, v2 Pos, v2 Dim, v4 Color) {
+	Assert(Buffer);
+
+	s32 MinX = Max((s32)roundf(Pos.X), 0);
+	s32 MinY = Max((s32)roundf(Pos.Y), 0);
+	s32 MaxX = Min((s32)roundf(Pos.X + Dim.X), Buffer->Width);
+	s32 MaxY = Min((s32)roundf(Pos.Y + Dim.Y), Buffer->Height);
+	if ((MinX >= MaxX) || (MinY >= MaxY))
+		return;
+
+	Color = PremultiplyColor(Color);
+	u8 ColorR = (u8)roundf(Color.R);
+	u8 ColorG = (u8)roundf(Color.G);
+	u8 ColorB = (u8)roundf(Color.B);
+	f32 AlphaChannel = Color.A / 255.0f;
+
+	// NOTE(ivan): Rows are independent, blend them on all threads.
+	u32 GrainSize = Max(1u, 16384u / (u32)(MaxX - MinX)); // NOTE(ivan): At least ~16k pixels per chunk.
+	ParallelFor((u32)(MaxY - MinY), GrainSize, [=](u32 Row) {
+		u8 *DstRow = ((u8 *)Buffer->Pixels + ((MinY + (s32)Row) * Buffer->Pitch));
+		for (s32 X = MinX; X < MaxX; X++) {
+			u32 *DstPixel = (u32 *)(DstRow + (X * Buffer->BytesPerPixel));
+			u32 DstC = *DstPixel;
+
+			blending_result BlendingResult = DoLinearBlending(AlphaChannel,
+															  (u8)((DstC >> 16) & 0xFF),
+															  (u8)((DstC >> 8)  & 0xFF),
+															  (u8)((DstC >> 0)  & 0xFF),
+															  ColorR, ColorG, ColorB);
+			*DstPixel = (((u32)BlendingResult.R << 16) |
+						 ((u32)BlendingResult.G << 8) |
+						 ((u32)BlendingResult.B << 0));
+		}
+	});
+}
+
 void
 DrawImage(game_video_buffer *Buffer, image *Image, v2 Pos) {
 	Assert(Buffer);
@@ -85,11 +155,15 @@ DrawImage(game_video_buffer *Buffer, image *Image, v2 Pos) {
 	Pos2.X = Pos1.X + Image->Width;
 	Pos2.Y = Pos1.Y + Image->Height;
 
-	for (s32 Y = Pos1.Y; Y < Pos2.Y; Y++) {
-		if (Y < 0)
-			continue;
-		if (Y >= Buffer->Height)
-			continue;
+	// NOTE(ivan): Rows are independent, blend them on all threads.
+	s32 MinY = Max(Pos1.Y, 0);
+	s32 MaxY = Min(Pos2.Y, Buffer->Height);
+	if (MinY >= MaxY)
+		return;
+
+	u32 GrainSize = Max(1u, 16384u / (u32)Max(Image->Width, 1)); // NOTE(ivan): At least ~16k pixels per chunk.
+	ParallelFor((u32)(MaxY - MinY), GrainSize, [=](u32 Row) {
+		s32 Y = MinY + (s32)Row;
 
 		u8 *DstRow = ((u8 *)Buffer->Pixels + (Y * Buffer->Pitch));
 		u8 *SrcRow = (u8 *)Image->Pixels + ((Y - Pos1.Y) * Image->Pitch);
@@ -106,7 +180,6 @@ DrawImage(game_video_buffer *Buffer, image *Image, v2 Pos) {
 			u32 DstC = *DstPixel;
 			u32 SrcC = *SrcPixel;
 
-			// TODO(ivan): Premultiplied alpha!
 			blending_result BlendingResult = DoLinearBlending(((SrcC >> 24) & 0xFF) / 255.0f,
 															  (u8)((DstC >> 16) & 0xFF),
 															  (u8)((DstC >> 8)  & 0xFF),
@@ -118,5 +191,5 @@ DrawImage(game_video_buffer *Buffer, image *Image, v2 Pos) {
 						 ((u32)BlendingResult.G << 8) |
 						 ((u32)BlendingResult.B << 0));
 		}
-	}
+	});
 }
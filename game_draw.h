@@ -11,7 +11,9 @@
 #include "game_math.h"
 #include "game_image.h"
 
+void ClearVideoBuffer(game_video_buffer *Buffer, v4 Color);
 void DrawPixel(game_video_buffer *Buffer, v2 Pos, v4 Color);
+void DrawRectangle(game_video_buffer *Buffer, v2 Pos, v2 Dim, v4 Color);
 void DrawImage(game_video_buffer *Buffer, image *Image, v2 Pos);
 
 #endif // #ifndef GAME_DRAW_H
@@ -17,8 +17,22 @@ enum error_code {
   ErrorCode_WrongSignature,
 
   // NOTE(ivan): BMP loader.
-  ErrorCode_BMPLoader_CompressionNot3,
-  ErrorCode_BMPLoader_BitnessNot32
+  ErrorCode_BMPLoader_Unsupported,
+  ErrorCode_BMPLoader_Corrupted,
+
+  // NOTE(ivan): PNG loader.
+  ErrorCode_PNGLoader_Unsupported,
+  ErrorCode_PNGLoader_Corrupted,
+
+  // NOTE(ivan): QOI loader.
+  ErrorCode_QOILoader_Corrupted,
+
+  // NOTE(ivan): Packed image loader.
+  ErrorCode_PackLoader_CorruptedHeader,
+  ErrorCode_PackLoader_CorruptedChunk,
+
+  // NOTE(ivan): Virtual file system.
+  ErrorCode_VfsPack_Corrupted
 };
 
 #endif // #ifndef GAME_DRAW_H
@@ -6,6 +6,64 @@
    $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
    ===================================================================== */
 #include "game_image.h"
+#include "game_parallel.h"
+
+// NOTE(ivan): Premultiplies two pixels unpacked to 16-bit lanes, alpha being the fourth lane of each.
+inline __m128i
+PremultiplyPixels(__m128i Pixels) {
+	__m128i ColorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	__m128i AlphaLanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+
+	__m128i Alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(Pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	Alpha = _mm_or_si128(_mm_and_si128(Alpha, ColorLanes), AlphaLanes);
+
+	// NOTE(ivan): Exact round(X / 255) for X up to 255 * 255.
+	__m128i Product = _mm_add_epi16(_mm_mullo_epi16(Pixels, Alpha), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(Product, _mm_srli_epi16(Product, 8)), 8);
+}
+
+inline u32
+PremultiplyPixel(u32 Pixel) {
+	u32 A = (Pixel >> 24);
+	u32 R = ((((Pixel >> 16) & 0xFF) * A) + 128);
+	u32 G = ((((Pixel >> 8) & 0xFF) * A) + 128);
+	u32 B = ((((Pixel >> 0) & 0xFF) * A) + 128);
+	R = (R + (R >> 8)) >> 8;
+	G = (G + (G >> 8)) >> 8;
+	B = (B + (B >> 8)) >> 8;
+	return ((A << 24) | (R << 16) | (G << 8) | (B << 0));
+}
+
+inline u32
+UnpremultiplyPixel(u32 Pixel) {
+	u32 A = (Pixel >> 24);
+	if (!A)
+		return 0;
+
+	u32 R = Min(((((Pixel >> 16) & 0xFF) * 255) + (A / 2)) / A, 255u);
+	u32 G = Min(((((Pixel >> 8) & 0xFF) * 255) + (A / 2)) / A, 255u);
+	u32 B = Min(((((Pixel >> 0) & 0xFF) * 255) + (A / 2)) / A, 255u);
+	return ((A << 24) | (R << 16) | (G << 8) | (B << 0));
+}
+
+// NOTE(ivan): In place, for loaders that produce straight 0xAARRGGBB first.
+static void
+PremultiplyARGB(u32 *Pixels, uptr Count) {
+	Assert(Pixels);
+
+	__m128i Zero = _mm_setzero_si128();
+
+	uptr Index = 0;
+	for (; (Index + 4) <= Count; Index += 4) {
+		__m128i P = _mm_loadu_si128((__m128i *)(Pixels + Index));
+		__m128i Lo = PremultiplyPixels(_mm_unpacklo_epi8(P, Zero));
+		__m128i Hi = PremultiplyPixels(_mm_unpackhi_epi8(P, Zero));
+		_mm_storeu_si128((__m128i *)(Pixels + Index), _mm_packus_epi16(Lo, Hi));
+	}
+
+	for (; Index < Count; Index++)
+		Pixels[Index] = PremultiplyPixel(Pixels[Index]);
+}
 
 // NOTE(ivan): BMP file header.
 #pragma pack(push, 1)
@@ -29,28 +87,151 @@ struct bmp_header {
 };
 #pragma pack(pop)
 
-// NOTE(ivan): BMP file bitfields masks
+// NOTE(ivan): BMP file bitfields masks, follow the 40-byte info header.
+// Alpha mask is present only with BITMAPV3INFOHEADER and later or with BI_ALPHABITFIELDS compression.
 #pragma pack(push, 1)
 struct bmp_bitfields_masks {
 	u32 RedMask;
 	u32 GreenMask;
 	u32 BlueMask;
+	u32 AlphaMask;
 };
 #pragma pack(pop)
 
+#define BMP_FILE_HEADER_SIZE 14
+#define BMP_INFO_HEADER_SIZE 40
+#define BMP_MAX_DIMENSION 32768
+
+// NOTE(ivan): BMP compression types.
+enum bmp_compression {
+	BmpCompression_RGB = 0,
+	BmpCompression_Bitfields = 3,
+	BmpCompression_AlphaBitfields = 6
+};
+
+// NOTE(ivan): Arbitrary mask channel extraction, scales the channel to 8 bits.
+struct bmp_channel {
+	u32 Mask;
+	u32 Shift;
+	u32 Max;
+	u32 Default; // NOTE(ivan): Used if the mask is empty.
+};
+
+inline bmp_channel
+MakeBmpChannel(u32 Mask, u32 Default) {
+	bmp_channel Result = {};
+	Result.Mask = Mask;
+	Result.Default = Default;
+
+	bit_scan_result Shift = FindLeastSignificantBit(Mask);
+	if (Shift.IsFound) {
+		Result.Shift = Shift.Index;
+		Result.Max = (Mask >> Shift.Index);
+	}
+
+	return Result;
+}
+
+inline u32
+ExtractBmpChannel(bmp_channel *Channel, u32 Value) {
+	if (!Channel->Max)
+		return Channel->Default;
+	
+	u32 Raw = ((Value & Channel->Mask) >> Channel->Shift);
+	if (Channel->Max == 0xFF)
+		return Raw;
+	return (u32)((((u64)Raw * 255) + (Channel->Max / 2)) / Channel->Max);
+}
+
+// NOTE(ivan): Is the mask exactly one whole byte? Such masks are handled by a single byte shuffle.
+inline b32
+IsBmpMaskByteAligned(u32 Mask) {
+	return (Mask == 0xFF) || (Mask == 0xFF00) || (Mask == 0xFF0000) || (Mask == 0xFF000000);
+}
+
+static void
+ConvertBmpRow32Shuffle(u32 *Dst, u8 *Src, s32 Width, __m128i Shuffle, u32 AlphaFill) {
+	s32 X = 0;
+
+	// NOTE(ivan): Four pixels per shuffle.
+	__m128i AlphaFill4 = _mm_set1_epi32((s32)AlphaFill);
+	for (; (X + 8) <= Width; X += 8) {
+		__m128i P0 = _mm_loadu_si128((__m128i *)(Src + (X * 4)));
+		__m128i P1 = _mm_loadu_si128((__m128i *)(Src + (X * 4) + 16));
+		P0 = _mm_or_si128(_mm_shuffle_epi8(P0, Shuffle), AlphaFill4);
+		P1 = _mm_or_si128(_mm_shuffle_epi8(P1, Shuffle), AlphaFill4);
+		_mm_storeu_si128((__m128i *)(Dst + X), P0);
+		_mm_storeu_si128((__m128i *)(Dst + X + 4), P1);
+	}
+	for (; (X + 4) <= Width; X += 4) {
+		__m128i P = _mm_loadu_si128((__m128i *)(Src + (X * 4)));
+		P = _mm_or_si128(_mm_shuffle_epi8(P, Shuffle), AlphaFill4);
+		_mm_storeu_si128((__m128i *)(Dst + X), P);
+	}
+
+	// NOTE(ivan): Tail, same shuffle done byte by byte.
+	u8 ShuffleBytes[16];
+	_mm_storeu_si128((__m128i *)ShuffleBytes, Shuffle);
+	for (; X < Width; X++) {
+		u8 *S = Src + (X * 4);
+		u32 C = AlphaFill;
+		for (u32 Byte = 0; Byte < 4; Byte++) {
+			if (!(ShuffleBytes[Byte] & 0x80))
+				C |= ((u32)S[ShuffleBytes[Byte]] << (Byte * 8));
+		}
+		Dst[X] = C;
+	}
+}
+
+static void
+ConvertBmpRow24(u32 *Dst, u8 *Src, s32 Width) {
+	s32 X = 0;
+
+	// NOTE(ivan): 16-byte loads consume 12 bytes (four BGR triples) each, keep the load inside the row.
+	__m128i Shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	__m128i AlphaFill = _mm_set1_epi32((s32)0xFF000000);
+	for (; (X + 10) <= Width; X += 8) {
+		__m128i P0 = _mm_loadu_si128((__m128i *)(Src + (X * 3)));
+		__m128i P1 = _mm_loadu_si128((__m128i *)(Src + (X * 3) + 12));
+		P0 = _mm_or_si128(_mm_shuffle_epi8(P0, Shuffle), AlphaFill);
+		P1 = _mm_or_si128(_mm_shuffle_epi8(P1, Shuffle), AlphaFill);
+		_mm_storeu_si128((__m128i *)(Dst + X), P0);
+		_mm_storeu_si128((__m128i *)(Dst + X + 4), P1);
+	}
+	for (; (X + 6) <= Width; X += 4) {
+		__m128i P = _mm_loadu_si128((__m128i *)(Src + (X * 3)));
+		P = _mm_or_si128(_mm_shuffle_epi8(P, Shuffle), AlphaFill);
+		_mm_storeu_si128((__m128i *)(Dst + X), P);
+	}
+
+	for (; X < Width; X++) {
+		u8 *S = Src + (X * 3);
+		Dst[X] = (0xFF000000 | ((u32)S[2] << 16) | ((u32)S[1] << 8) | (u32)S[0]);
+	}
+}
+
+static void
+ConvertBmpRowMasked(u32 *Dst, u8 *Src, s32 Width, u32 BytesPerPixel, bmp_channel *Channels) {
+	for (s32 X = 0; X < Width; X++) {
+		u32 Value = 0;
+		memcpy(&Value, Src + (X * BytesPerPixel), BytesPerPixel);
+
+		Dst[X] = ((ExtractBmpChannel(&Channels[3], Value) << 24) |
+				  (ExtractBmpChannel(&Channels[0], Value) << 16) |
+				  (ExtractBmpChannel(&Channels[1], Value) << 8) |
+				  (ExtractBmpChannel(&Channels[2], Value) << 0));
+	}
+}
+
 image
 LoadImageBmp(const char *FileName, memory_heap *Heap) {
 	Assert(FileName);
 	Assert(Heap);
 
-	// NOTE(ivan): WARNING - this loader is FAR from being universal. It supports only 32-bit A8R8G8B8 format,
-	// compression with value 3 (bitfields encoding), and alpha channel must be present.
-	// Without alpha channel no image will be shown (alpha channel will be always 0).
-	// Tested with GIMP exporter.
-	// This loader is written only for test purposes, it is unlikely will be used in a shipping product,
-	// so there is no reason to make it complete BMP loader at all.
-
-	// TODO(ivan): Detect somehow whether the alpha channel is present. Fail if not.
+	// NOTE(ivan): Supported are uncompressed 8-bit palettized, 16-bit, 24-bit and 32-bit images,
+	// with either default or arbitrary (bitfields) masks, stored both bottom-up and top-down.
+	// RLE compression, 1/4-bit palettes and embedded JPEG/PNG are not supported.
+	// Output is always top-down.
 	
 	image Result = {};
 
@@ -58,67 +239,191 @@ LoadImageBmp(const char *FileName, memory_heap *Heap) {
 	
 	DEBUGPlatformOutf("Loading BMP: %s", FileName);
 
-	piece FilePiece = PlatformReadEntireFile(FileName);
+	piece FilePiece = ReadVfsFile(FileName);
 	if (FilePiece.Base) {
 		piece At = FilePiece;
-		bmp_header *Header = ConsumeType(&At, bmp_header);
 
 		const u8 BmpSignature[] = {0x42, 0x4d}; // NOTE(ivan): "BM".
-		if (Header->FileType == *(u16 *)BmpSignature) {
-			if (Header->BitsPerPixel == 32) {
-				if (Header->Compression == 3) {
-					bmp_bitfields_masks *Masks = ConsumeType(&At, bmp_bitfields_masks);
-					
-					bit_scan_result RedShift = FindLeastSignificantBit(Masks->RedMask);
-					bit_scan_result GreenShift = FindLeastSignificantBit(Masks->GreenMask);
-					bit_scan_result BlueShift = FindLeastSignificantBit(Masks->BlueMask);
-					bit_scan_result AlphaShift = FindLeastSignificantBit(~(Masks->RedMask | Masks->GreenMask | Masks->BlueMask));
-
-					Assert(RedShift.IsFound);
-					Assert(GreenShift.IsFound);
-					Assert(BlueShift.IsFound);
-					Assert(AlphaShift.IsFound);
-
-					Result.Pixels = (u32 *)PushSize(Partition, Header->Width * Header->Height * (Header->BitsPerPixel / 8));
+		if ((At.Size >= sizeof(bmp_header)) && (*(u16 *)At.Base == *(u16 *)BmpSignature)) {
+			bmp_header *Header = ConsumeType(&At, bmp_header);
+
+			u32 BitsPerPixel = Header->BitsPerPixel;
+			u32 Compression = Header->Compression;
+			b32 IsTopDown = (Header->Height < 0);
+			s32 Width = Header->Width;
+
+			// NOTE(ivan): INT_MIN has no positive counterpart, it is left negative for the validation below to refuse.
+			s32 Height = Header->Height;
+			if (IsTopDown && (Height != INT_MIN))
+				Height = -Height;
+
+			b32 IsSupported = (Header->Size >= BMP_INFO_HEADER_SIZE);
+			if (BitsPerPixel == 8)
+				IsSupported = IsSupported && (Compression == BmpCompression_RGB);
+			else if ((BitsPerPixel == 16) || (BitsPerPixel == 32))
+				IsSupported = IsSupported && ((Compression == BmpCompression_RGB) ||
+											  (Compression == BmpCompression_Bitfields) ||
+											  (Compression == BmpCompression_AlphaBitfields));
+			else if (BitsPerPixel == 24)
+				IsSupported = IsSupported && (Compression == BmpCompression_RGB);
+			else
+				IsSupported = false;
+
+			if (IsSupported) {
+				// NOTE(ivan): Every offset below is validated against the file size before use.
+				u64 FileSize = FilePiece.Size;
+				u64 InfoEnd = (u64)BMP_FILE_HEADER_SIZE + Header->Size;
+				u64 SrcPitch = ((((u64)Width * BitsPerPixel) + 31) / 32) * 4;
+				u64 RowBytes = (((u64)Width * BitsPerPixel) + 7) / 8;
+				b32 IsValid = ((Width > 0) && (Height > 0) &&
+							   (Width <= BMP_MAX_DIMENSION) && (Height <= BMP_MAX_DIMENSION) &&
+							   (InfoEnd <= FileSize) &&
+							   ((u64)Header->BitmapOffset + (SrcPitch * (Height - 1)) + RowBytes <= FileSize));
+
+				// NOTE(ivan): Channels in R, G, B, A order.
+				bmp_channel Channels[4] = {};
+				u32 Palette[256];
+				if (IsValid) {
+					if (BitsPerPixel == 8) {
+						u32 ColorCount = Header->ColorsUsed ? Header->ColorsUsed : 256;
+						if ((ColorCount <= 256) && ((InfoEnd + (ColorCount * 4)) <= FileSize)) {
+							// NOTE(ivan): Palette entries are B8G8R8X8, the last byte is reserved.
+							u8 *Entry = FilePiece.Base + InfoEnd;
+							for (u32 Index = 0; Index < 256; Index++) {
+								if (Index < ColorCount)
+									Palette[Index] = (0xFF000000 | ((u32)Entry[2] << 16) | ((u32)Entry[1] << 8) | (u32)Entry[0]);
+								else
+									Palette[Index] = 0xFF000000;
+								Entry += 4;
+							}
+						} else {
+							IsValid = false;
+						}
+					} else if (BitsPerPixel != 24) {
+						bmp_bitfields_masks Masks = {};
+						if (Compression == BmpCompression_RGB) {
+							if (BitsPerPixel == 16) {
+								Masks.RedMask = 0x7C00;
+								Masks.GreenMask = 0x03E0;
+								Masks.BlueMask = 0x001F;
+							} else {
+								Masks.RedMask = 0x00FF0000;
+								Masks.GreenMask = 0x0000FF00;
+								Masks.BlueMask = 0x000000FF;
+							}
+						} else {
+							b32 HasAlphaMask = ((Compression == BmpCompression_AlphaBitfields) ||
+												(Header->Size >= (BMP_INFO_HEADER_SIZE + sizeof(bmp_bitfields_masks))));
+							u64 MasksSize = HasAlphaMask ? sizeof(bmp_bitfields_masks) : (sizeof(bmp_bitfields_masks) - sizeof(u32));
+							if ((sizeof(bmp_header) + MasksSize) <= FileSize) {
+								memcpy(&Masks, ConsumeSize(&At, MasksSize), MasksSize);
+
+								// NOTE(ivan): Older 32-bit exporters keep alpha in whatever the color masks leave out.
+								if (!HasAlphaMask && (BitsPerPixel == 32))
+									Masks.AlphaMask = ~(Masks.RedMask | Masks.GreenMask | Masks.BlueMask);
+							} else {
+								IsValid = false;
+							}
+						}
+
+						if (BitsPerPixel == 16) {
+							Masks.RedMask &= 0xFFFF;
+							Masks.GreenMask &= 0xFFFF;
+							Masks.BlueMask &= 0xFFFF;
+							Masks.AlphaMask &= 0xFFFF;
+						}
+
+						Channels[0] = MakeBmpChannel(Masks.RedMask, 0);
+						Channels[1] = MakeBmpChannel(Masks.GreenMask, 0);
+						Channels[2] = MakeBmpChannel(Masks.BlueMask, 0);
+						Channels[3] = MakeBmpChannel(Masks.AlphaMask, 0xFF);
+
+						// NOTE(ivan): Masks must be contiguous, otherwise the channel scaling is meaningless.
+						for (u32 Index = 0; Index < CountOf(Channels); Index++) {
+							u32 Max = Channels[Index].Max;
+							if (Max & (Max + 1))
+								IsValid = false;
+						}
+					}
+				}
+
+				if (IsValid) {
+					temporary_memory ImageMemory = BeginTemporaryMemory(Heap);
+					Result.Pixels = (u32 *)PushSize(Heap, (uptr)Width * Height * 4);
 					if (Result.Pixels) {
-						Result.Width = Header->Width;
-						Result.Height = Header->Height;
-						Result.BytesPerPixel = Header->BitsPerPixel / 8;
-						Result.Pitch = Header->Width * (Header->BitsPerPixel / 8);
-
-						u8 *DstRow = (u8 *)Result.Pixels;
-						u8 *SrcRow = FilePiece.Base + Header->BitmapOffset;
-						for (s32 Y = 0; Y < Header->Height; Y++) {
-							u32 *DstPixel = (u32 *)DstRow;
-							u32 *SrcPixel = (u32 *)SrcRow;
-							for (s32 X = 0; X < Header->Width; X++) {
-								u32 C = (u32)((((*SrcPixel >> AlphaShift.Index) & 0xFF) << 24) |
-											  (((*SrcPixel >> RedShift.Index) & 0xFF) << 16) |
-											  (((*SrcPixel >> GreenShift.Index) & 0xFF) << 8) |
-											  (((*SrcPixel >> BlueShift.Index) & 0xFF) << 0));
-								SrcPixel++;
-								*DstPixel++ = C;
+						Result.Width = Width;
+						Result.Height = Height;
+						Result.BytesPerPixel = 4;
+						Result.Pitch = Width * 4;
+
+						// NOTE(ivan): Byte shuffle for 32-bit images with whole-byte masks.
+						b32 IsShuffle = false;
+						__m128i Shuffle = _mm_setzero_si128();
+						u32 AlphaFill = 0;
+						if (BitsPerPixel == 32) {
+							IsShuffle = true;
+
+							u8 ShuffleBytes[16];
+							for (u32 Index = 0; Index < 4; Index++) {
+								// NOTE(ivan): Destination byte order is B, G, R, A.
+								bmp_channel *Channel = &Channels[(Index == 3) ? 3 : (2 - Index)];
+								if (Channel->Max) {
+									IsShuffle = IsShuffle && IsBmpMaskByteAligned(Channel->Mask);
+									ShuffleBytes[Index] = (u8)(Channel->Shift / 8);
+								} else {
+									ShuffleBytes[Index] = 0x80;
+									AlphaFill |= (Channel->Default << (Index * 8));
+								}
 							}
+							for (u32 Index = 4; Index < 16; Index++)
+								ShuffleBytes[Index] = (ShuffleBytes[Index & 3] & 0x80) ? 0x80 : (u8)(ShuffleBytes[Index & 3] + (Index & ~3));
 
-							DstRow += Result.Pitch;
-							SrcRow += Result.Pitch;
+							Shuffle = _mm_loadu_si128((__m128i *)ShuffleBytes);
 						}
+
+						// NOTE(ivan): Rows convert independently, spread them over all threads.
+						b32 HasAlpha = ((BitsPerPixel >= 16) && Channels[3].Max);
+						u8 *SrcBase = FilePiece.Base + Header->BitmapOffset;
+						u8 *DstBase = (u8 *)Result.Pixels;
+						uptr DstPitch = Result.Pitch;
+						u32 GrainSize = Max(1u, 65536u / (u32)Width); // NOTE(ivan): At least ~64k pixels per chunk.
+						ParallelFor((u32)Height, GrainSize, [&](u32 Y) {
+							u32 *DstRow = (u32 *)(DstBase + ((uptr)Y * DstPitch));
+							u8 *SrcRow = SrcBase + (SrcPitch * (IsTopDown ? Y : (Height - 1 - Y)));
+
+							if (BitsPerPixel == 8) {
+								for (s32 X = 0; X < Width; X++)
+									DstRow[X] = Palette[SrcRow[X]];
+							} else if (BitsPerPixel == 24) {
+								ConvertBmpRow24(DstRow, SrcRow, Width);
+							} else if (IsShuffle) {
+								ConvertBmpRow32Shuffle(DstRow, SrcRow, Width, Shuffle, AlphaFill);
+							} else {
+								ConvertBmpRowMasked(DstRow, SrcRow, Width, BitsPerPixel / 8, Channels);
+							}
+
+							if (HasAlpha)
+								PremultiplyARGB(DstRow, (uptr)Width);
+						});
+
+						CommitTemporaryMemory(ImageMemory);
+					} else {
+						EndTemporaryMemory(ImageMemory);
 					}
-				
 				} else {
-					// NOTE(ivan): Compression other than bitfields encoding is not supported.
-					GameTLState.LastError = ErrorCode_BMPLoader_CompressionNot3;
+					// NOTE(ivan): Header or palette points outside of the file, or masks are broken.
+					GameTLState.LastError = ErrorCode_BMPLoader_Corrupted;
 				}
 			} else {
-				// NOTE(ivan): Only 32-bit images are supported.
-				GameTLState.LastError = ErrorCode_BMPLoader_BitnessNot32;
+				// NOTE(ivan): Compressed, core-header or unusual bitness image.
+				GameTLState.LastError = ErrorCode_BMPLoader_Unsupported;
 			}
 		} else {
 			// NOTE(ivan): File is not BMP.
 			GameTLState.LastError = ErrorCode_WrongSignature;
 		}
 		
-		PlatformFreeEntireFilePiece(&FilePiece);
+		FreeVfsFile(&FilePiece);
 	} else {
 		// NOTE(ivan): Not found.
 		// NOTE(ivan): LastError is already set to GameError_NotFound.
@@ -126,3 +431,682 @@ LoadImageBmp(const char *FileName, memory_heap *Heap) {
 
 	return Result;
 }
+
+// NOTE(ivan): PNG header chunk, all the integers are big-endian.
+#pragma pack(push, 1)
+struct png_ihdr {
+	u32 Width;
+	u32 Height;
+	u8 BitDepth;
+	u8 ColorType;
+	u8 CompressionMethod;
+	u8 FilterMethod;
+	u8 InterlaceMethod;
+};
+#pragma pack(pop)
+
+// NOTE(ivan): PNG color types.
+enum png_color_type {
+	PngColorType_Gray = 0,
+	PngColorType_RGB = 2,
+	PngColorType_Palette = 3,
+	PngColorType_GrayAlpha = 4,
+	PngColorType_RGBA = 6
+};
+
+// NOTE(ivan): PNG row filters.
+enum png_filter {
+	PngFilter_None = 0,
+	PngFilter_Sub,
+	PngFilter_Up,
+	PngFilter_Average,
+	PngFilter_Paeth
+};
+
+inline u32
+ReadBigEndianU32(const u8 *At) {
+	u32 Result;
+	memcpy(&Result, At, sizeof(Result));
+#if INTELORDER
+	SwapEndianU32(&Result);
+#endif
+	return Result;
+}
+
+inline u8
+PngPaethPredictor(s32 A, s32 B, s32 C) {
+	s32 Pa = abs(B - C);
+	s32 Pb = abs(A - C);
+	s32 Pc = abs(A + B - 2 * C);
+	if ((Pa <= Pb) && (Pa <= Pc))
+		return (u8)A;
+	if (Pb <= Pc)
+		return (u8)B;
+	return (u8)C;
+}
+
+// NOTE(ivan): Bpp is a template parameter so that pixel loads/stores compile to plain moves.
+template <u32 Bpp> inline __m128i
+LoadPngPixel(const u8 *At) {
+	u32 Value = 0;
+	memcpy(&Value, At, Bpp);
+	return _mm_cvtsi32_si128((s32)Value);
+}
+
+template <u32 Bpp> inline void
+StorePngPixel(u8 *At, __m128i Pixel) {
+	u32 Value = (u32)_mm_cvtsi128_si32(Pixel);
+	memcpy(At, &Value, Bpp);
+}
+
+inline __m128i
+AbsEpi16(__m128i Value) {
+	return _mm_max_epi16(Value, _mm_sub_epi16(_mm_setzero_si128(), Value));
+}
+
+inline __m128i
+SelectEpi16(__m128i Mask, __m128i A, __m128i B) {
+	return _mm_or_si128(_mm_and_si128(Mask, A), _mm_andnot_si128(Mask, B));
+}
+
+// NOTE(ivan): Sub, Average and Paeth depend on the pixel to the left, so a whole pixel is processed per step.
+template <u32 Bpp> static void
+UnfilterPngRowPixels(u32 Filter, u8 *Row, const u8 *Prev, u32 RowBytes) {
+	__m128i Zero = _mm_setzero_si128();
+
+	switch (Filter) {
+	case PngFilter_Sub: {
+		__m128i A = Zero;
+		for (u32 Index = 0; Index < RowBytes; Index += Bpp) {
+			__m128i D = _mm_add_epi8(LoadPngPixel<Bpp>(Row + Index), A);
+			StorePngPixel<Bpp>(Row + Index, D);
+			A = D;
+		}
+	} break;
+
+	case PngFilter_Average: {
+		// NOTE(ivan): pavgb rounds up, PNG wants (A + B) >> 1, so subtract the lost low bit.
+		__m128i One = _mm_set1_epi8(1);
+		__m128i A = Zero;
+		for (u32 Index = 0; Index < RowBytes; Index += Bpp) {
+			__m128i B = LoadPngPixel<Bpp>(Prev + Index);
+			__m128i Average = _mm_sub_epi8(_mm_avg_epu8(A, B), _mm_and_si128(_mm_xor_si128(A, B), One));
+			__m128i D = _mm_add_epi8(LoadPngPixel<Bpp>(Row + Index), Average);
+			StorePngPixel<Bpp>(Row + Index, D);
+			A = D;
+		}
+	} break;
+
+	case PngFilter_Paeth: {
+		// NOTE(ivan): All the channels of a pixel are predicted at once in 16-bit lanes.
+		__m128i A = Zero;
+		__m128i C = Zero;
+		for (u32 Index = 0; Index < RowBytes; Index += Bpp) {
+			__m128i B = _mm_unpacklo_epi8(LoadPngPixel<Bpp>(Prev + Index), Zero);
+
+			__m128i Pa = _mm_sub_epi16(B, C);
+			__m128i Pb = _mm_sub_epi16(A, C);
+			__m128i Pc = AbsEpi16(_mm_add_epi16(Pa, Pb));
+			Pa = AbsEpi16(Pa);
+			Pb = AbsEpi16(Pb);
+
+			__m128i Smallest = _mm_min_epi16(Pc, _mm_min_epi16(Pa, Pb));
+			__m128i Nearest = SelectEpi16(_mm_cmpeq_epi16(Smallest, Pa), A,
+										  SelectEpi16(_mm_cmpeq_epi16(Smallest, Pb), B, C));
+
+			__m128i D = _mm_add_epi8(LoadPngPixel<Bpp>(Row + Index), _mm_packus_epi16(Nearest, Nearest));
+			StorePngPixel<Bpp>(Row + Index, D);
+
+			A = _mm_unpacklo_epi8(D, Zero);
+			C = B;
+		}
+	} break;
+
+	InvalidDefaultCase;
+	}
+}
+
+static void
+UnfilterPngRow(u32 Filter, u8 *Row, const u8 *Prev, u32 RowBytes, u32 Bpp) {
+	Assert(Row);
+	Assert(Prev);
+
+	if (Filter == PngFilter_None)
+		return;
+
+	if (Filter == PngFilter_Up) {
+		// NOTE(ivan): No dependency between neighbouring bytes, 16 at a time.
+		u32 Index = 0;
+		for (; (Index + 16) <= RowBytes; Index += 16) {
+			__m128i X = _mm_loadu_si128((const __m128i *)(Row + Index));
+			__m128i B = _mm_loadu_si128((const __m128i *)(Prev + Index));
+			_mm_storeu_si128((__m128i *)(Row + Index), _mm_add_epi8(X, B));
+		}
+		for (; Index < RowBytes; Index++)
+			Row[Index] = (u8)(Row[Index] + Prev[Index]);
+		return;
+	}
+
+	if (Bpp == 4) {
+		UnfilterPngRowPixels<4>(Filter, Row, Prev, RowBytes);
+		return;
+	}
+	if (Bpp == 3) {
+		UnfilterPngRowPixels<3>(Filter, Row, Prev, RowBytes);
+		return;
+	}
+
+	// NOTE(ivan): Other pixel sizes are rare enough to go byte by byte.
+	u32 Index = 0;
+	switch (Filter) {
+	case PngFilter_Sub: {
+		for (Index = Bpp; Index < RowBytes; Index++)
+			Row[Index] = (u8)(Row[Index] + Row[Index - Bpp]);
+	} break;
+
+	case PngFilter_Average: {
+		for (; Index < Bpp; Index++)
+			Row[Index] = (u8)(Row[Index] + (Prev[Index] >> 1));
+		for (; Index < RowBytes; Index++)
+			Row[Index] = (u8)(Row[Index] + ((Row[Index - Bpp] + Prev[Index]) >> 1));
+	} break;
+
+	case PngFilter_Paeth: {
+		for (; Index < Bpp; Index++)
+			Row[Index] = (u8)(Row[Index] + Prev[Index]);
+		for (; Index < RowBytes; Index++)
+			Row[Index] = (u8)(Row[Index] + PngPaethPredictor(Row[Index - Bpp], Prev[Index], Prev[Index - Bpp]));
+	} break;
+
+	InvalidDefaultCase;
+	}
+}
+
+// NOTE(ivan): Premultiplies two R8G8B8A8 pixels unpacked to 16-bit lanes and reorders them to B, G, R, A.
+inline __m128i
+PremultiplyAndSwizzlePixels(__m128i Pixels) {
+	__m128i Product = PremultiplyPixels(Pixels);
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(Product, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+static void
+PremultiplyRGBAToARGB(u32 *Dst, const u8 *Src, u32 Count) {
+	Assert(Dst);
+	Assert(Src);
+
+	__m128i Zero = _mm_setzero_si128();
+
+	u32 Index = 0;
+	for (; (Index + 4) <= Count; Index += 4) {
+		__m128i Pixels = _mm_loadu_si128((const __m128i *)(Src + (Index * 4)));
+		__m128i Lo = PremultiplyAndSwizzlePixels(_mm_unpacklo_epi8(Pixels, Zero));
+		__m128i Hi = PremultiplyAndSwizzlePixels(_mm_unpackhi_epi8(Pixels, Zero));
+		_mm_storeu_si128((__m128i *)(Dst + Index), _mm_packus_epi16(Lo, Hi));
+	}
+
+	for (; Index < Count; Index++) {
+		const u8 *Pixel = Src + (Index * 4);
+		Dst[Index] = PremultiplyPixel(((u32)Pixel[3] << 24) | ((u32)Pixel[0] << 16) | ((u32)Pixel[1] << 8) | (u32)Pixel[2]);
+	}
+}
+
+image
+LoadImagePng(const char *FileName, memory_heap *Heap) {
+	Assert(FileName);
+	Assert(Heap);
+
+	// NOTE(ivan): Supports 8 and 16-bit gray, gray+alpha, RGB, RGBA, and 8-bit palettized images
+	// (with transparency for palettized ones). Interlaced images are not supported.
+	// 16-bit samples are truncated to their high byte.
+
+	image Result = {};
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	DEBUGPlatformOutf("Loading PNG: %s", FileName);
+
+	piece FilePiece = ReadVfsFile(FileName);
+	if (FilePiece.Base) {
+		const u8 PngSignature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+		if ((FilePiece.Size >= sizeof(PngSignature)) && (memcmp(FilePiece.Base, PngSignature, sizeof(PngSignature)) == 0)) {
+			png_ihdr *Header = 0;
+			u8 *Palette = 0;
+			u32 PaletteCount = 0;
+			u8 *Transparency = 0;
+			u32 TransparencyCount = 0;
+			u8 *FirstIDAT = 0;
+			uptr IDATSize = 0;
+			u32 IDATCount = 0;
+			b32 IsCorrupted = false;
+
+			// NOTE(ivan): Walk the chunks, every length is checked against what is left in the file.
+			piece At = {FilePiece.Base + sizeof(PngSignature), FilePiece.Size - sizeof(PngSignature)};
+			while (!IsCorrupted && At.Size) {
+				if (At.Size < 12) {
+					IsCorrupted = true;
+					break;
+				}
+
+				u32 Length = ReadBigEndianU32(At.Base);
+				u32 Type = ReadBigEndianU32(At.Base + 4);
+				if (Length > (At.Size - 12)) {
+					IsCorrupted = true;
+					break;
+				}
+				u8 *Data = At.Base + 8;
+
+				if (Type == FourCC("IHDR")) {
+					if (Length >= sizeof(png_ihdr))
+						Header = (png_ihdr *)Data;
+					else
+						IsCorrupted = true;
+				} else if (Type == FourCC("PLTE")) {
+					Palette = Data;
+					PaletteCount = Min(Length / 3, 256U);
+				} else if (Type == FourCC("tRNS")) {
+					Transparency = Data;
+					TransparencyCount = Min(Length, 256U);
+				} else if (Type == FourCC("IDAT")) {
+					if (!FirstIDAT)
+						FirstIDAT = Data;
+					IDATSize += Length;
+					IDATCount++;
+				} else if (Type == FourCC("IEND")) {
+					break;
+				}
+
+				ConsumeSize(&At, Length + 12);
+			}
+
+			u32 Width = 0, Height = 0, BitDepth = 0, ColorType = 0, Channels = 0;
+			if (Header && !IsCorrupted && FirstIDAT) {
+				Width = ReadBigEndianU32((u8 *)&Header->Width);
+				Height = ReadBigEndianU32((u8 *)&Header->Height);
+				BitDepth = Header->BitDepth;
+				ColorType = Header->ColorType;
+
+				switch (ColorType) {
+				case PngColorType_Gray: {Channels = 1;} break;
+				case PngColorType_RGB: {Channels = 3;} break;
+				case PngColorType_Palette: {Channels = (PaletteCount ? 1 : 0);} break;
+				case PngColorType_GrayAlpha: {Channels = 2;} break;
+				case PngColorType_RGBA: {Channels = 4;} break;
+				}
+
+				b32 IsBitDepthSupported = ((ColorType == PngColorType_Palette) ? (BitDepth == 8) : ((BitDepth == 8) || (BitDepth == 16)));
+				if (!Channels || !IsBitDepthSupported || Header->InterlaceMethod ||
+					(Width == 0) || (Height == 0) || (Width > 32768) || (Height > 32768)) {
+					GameTLState.LastError = ErrorCode_PNGLoader_Unsupported;
+					Channels = 0;
+				}
+			} else {
+				GameTLState.LastError = ErrorCode_PNGLoader_Corrupted;
+			}
+
+			if (Channels) {
+				u32 Bpp = Channels * (BitDepth / 8);
+				u32 RowBytes = Width * Bpp;
+				uptr InflatedSize = (uptr)Height * (RowBytes + 1);
+
+				temporary_memory ImageMemory = BeginTemporaryMemory(Heap);
+				u32 *Pixels = (u32 *)PushSize(Heap, (uptr)Width * Height * 4);
+
+				temporary_memory WorkMemory = BeginTemporaryMemory(Heap);
+				u8 *Inflated = (u8 *)PushSize(Heap, InflatedSize);
+				u8 *ZeroRow = (u8 *)PushSize(Heap, RowBytes);
+				u8 *RGBARow = (u8 *)PushSize(Heap, (uptr)Width * 4);
+				u8 *Compressed = FirstIDAT;
+				if (IDATCount > 1) {
+					// NOTE(ivan): Stitch the IDAT chunks into one continuous zlib stream.
+					Compressed = (u8 *)PushSize(Heap, IDATSize);
+					if (Compressed) {
+						u8 *Dest = Compressed;
+						piece Chunks = {FirstIDAT - 8, (uptr)((FilePiece.Base + FilePiece.Size) - (FirstIDAT - 8))};
+						while (Dest < (Compressed + IDATSize)) {
+							u32 Length = ReadBigEndianU32(Chunks.Base);
+							if (ReadBigEndianU32(Chunks.Base + 4) == FourCC("IDAT")) {
+								memcpy(Dest, Chunks.Base + 8, Length);
+								Dest += Length;
+							}
+							ConsumeSize(&Chunks, Length + 12);
+						}
+					}
+				}
+
+				if (Pixels && Inflated && ZeroRow && RGBARow && Compressed) {
+					uptr DecodedSize;
+					if (InflateZlib(Compressed, IDATSize, Inflated, InflatedSize, &DecodedSize) && (DecodedSize == InflatedSize)) {
+						u32 PaletteRGBA[256];
+						if (ColorType == PngColorType_Palette) {
+							for (u32 Index = 0; Index < CountOf(PaletteRGBA); Index++) {
+								u8 *Entry = Palette + ((Index % PaletteCount) * 3);
+								u32 Alpha = (Transparency && (Index < TransparencyCount)) ? Transparency[Index] : 0xFF;
+								PaletteRGBA[Index] = ((Alpha << 24) | (Entry[2] << 16) | (Entry[1] << 8) | Entry[0]);
+							}
+						}
+
+						memset(ZeroRow, 0, RowBytes);
+						u8 *Prev = ZeroRow;
+						u32 BytesPerSample = BitDepth / 8;
+						for (u32 Y = 0; Y < Height; Y++) {
+							u8 *Row = Inflated + ((uptr)Y * (RowBytes + 1));
+							u32 Filter = *Row++;
+							if (Filter > PngFilter_Paeth) {
+								GameTLState.LastError = ErrorCode_PNGLoader_Corrupted;
+								break;
+							}
+							UnfilterPngRow(Filter, Row, Prev, RowBytes, Bpp);
+							Prev = Row;
+
+							// NOTE(ivan): Bring the row to R8G8B8A8 unless it already is.
+							u8 *Source = Row;
+							if ((ColorType != PngColorType_RGBA) || (BitDepth != 8)) {
+								Source = RGBARow;
+								for (u32 X = 0; X < Width; X++) {
+									u8 *Sample = Row + ((uptr)X * Bpp);
+									u8 *Out = RGBARow + ((uptr)X * 4);
+									switch (ColorType) {
+									case PngColorType_Gray: {
+										Out[0] = Out[1] = Out[2] = Sample[0];
+										Out[3] = 0xFF;
+									} break;
+
+									case PngColorType_GrayAlpha: {
+										Out[0] = Out[1] = Out[2] = Sample[0];
+										Out[3] = Sample[BytesPerSample];
+									} break;
+
+									case PngColorType_RGB: {
+										Out[0] = Sample[0];
+										Out[1] = Sample[BytesPerSample];
+										Out[2] = Sample[BytesPerSample * 2];
+										Out[3] = 0xFF;
+									} break;
+
+									case PngColorType_RGBA: {
+										Out[0] = Sample[0];
+										Out[1] = Sample[BytesPerSample];
+										Out[2] = Sample[BytesPerSample * 2];
+										Out[3] = Sample[BytesPerSample * 3];
+									} break;
+
+									case PngColorType_Palette: {
+										memcpy(Out, &PaletteRGBA[Sample[0]], 4);
+									} break;
+									}
+								}
+							}
+
+							PremultiplyRGBAToARGB(Pixels + ((uptr)Y * Width), Source, Width);
+						}
+
+						if (GameTLState.LastError == ErrorCode_NoError) {
+							Result.Pixels = Pixels;
+							Result.Width = (s32)Width;
+							Result.Height = (s32)Height;
+							Result.BytesPerPixel = 4;
+							Result.Pitch = (s32)Width * 4;
+						}
+					} else {
+						GameTLState.LastError = ErrorCode_PNGLoader_Corrupted;
+					}
+				}
+				EndTemporaryMemory(WorkMemory);
+
+				if (Result.Pixels)
+					CommitTemporaryMemory(ImageMemory);
+				else
+					EndTemporaryMemory(ImageMemory);
+			}
+		} else {
+			// NOTE(ivan): File is not PNG.
+			GameTLState.LastError = ErrorCode_WrongSignature;
+		}
+
+		FreeVfsFile(&FilePiece);
+	} else {
+		// NOTE(ivan): Not found.
+		// NOTE(ivan): LastError is already set to GameError_NotFound.
+	}
+
+	return Result;
+}
+
+// NOTE(ivan): QOI ("Quite OK Image") format, see https://qoiformat.org/qoi-specification.pdf
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8 // NOTE(ivan): 7 zero bytes and a single 0x01.
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xC0
+#define QOI_OP_RGB 0xFE
+#define QOI_OP_RGBA 0xFF
+#define QOI_MASK_2 0xC0
+
+inline u32
+HashQoiPixel(u32 Pixel) {
+	u32 A = (Pixel >> 24) & 0xFF;
+	u32 R = (Pixel >> 16) & 0xFF;
+	u32 G = (Pixel >> 8) & 0xFF;
+	u32 B = (Pixel >> 0) & 0xFF;
+	return ((R * 3) + (G * 5) + (B * 7) + (A * 11)) & 63;
+}
+
+inline void
+WriteBigEndianU32(u8 *At, u32 Value) {
+#if INTELORDER
+	SwapEndianU32(&Value);
+#endif
+	memcpy(At, &Value, sizeof(Value));
+}
+
+image
+LoadImageQoi(const char *FileName, memory_heap *Heap) {
+	Assert(FileName);
+	Assert(Heap);
+
+	image Result = {};
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	DEBUGPlatformOutf("Loading QOI: %s", FileName);
+
+	piece FilePiece = ReadVfsFile(FileName);
+	if (FilePiece.Base) {
+		if ((FilePiece.Size >= (QOI_HEADER_SIZE + QOI_PADDING_SIZE)) && (ReadBigEndianU32(FilePiece.Base) == FourCC("qoif"))) {
+			u32 Width = ReadBigEndianU32(FilePiece.Base + 4);
+			u32 Height = ReadBigEndianU32(FilePiece.Base + 8);
+			if ((Width > 0) && (Height > 0) && (Width <= 32768) && (Height <= 32768)) {
+				temporary_memory ImageMemory = BeginTemporaryMemory(Heap);
+				u32 *Pixels = (u32 *)PushSize(Heap, (uptr)Width * Height * 4);
+				if (Pixels) {
+					u32 Index[64] = {};
+					u32 Pixel = 0xFF000000;
+					u32 Run = 0;
+
+					// NOTE(ivan): No op is longer than the padding, so checking the op start is enough.
+					u8 *At = FilePiece.Base + QOI_HEADER_SIZE;
+					u8 *End = FilePiece.Base + FilePiece.Size - QOI_PADDING_SIZE;
+
+					uptr PixelCount = (uptr)Width * Height;
+					for (uptr PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++) {
+						if (Run) {
+							Run--;
+						} else if (At < End) {
+							u32 Op = *At++;
+							if (Op == QOI_OP_RGB) {
+								Pixel = ((Pixel & 0xFF000000) | ((u32)At[0] << 16) | ((u32)At[1] << 8) | (u32)At[2]);
+								At += 3;
+							} else if (Op == QOI_OP_RGBA) {
+								Pixel = (((u32)At[3] << 24) | ((u32)At[0] << 16) | ((u32)At[1] << 8) | (u32)At[2]);
+								At += 4;
+							} else {
+								switch (Op & QOI_MASK_2) {
+								case QOI_OP_INDEX: {
+									Pixel = Index[Op];
+								} break;
+
+								case QOI_OP_DIFF: {
+									u32 R = (((Pixel >> 16) + ((Op >> 4) & 3) - 2) & 0xFF);
+									u32 G = (((Pixel >> 8) + ((Op >> 2) & 3) - 2) & 0xFF);
+									u32 B = (((Pixel >> 0) + ((Op >> 0) & 3) - 2) & 0xFF);
+									Pixel = ((Pixel & 0xFF000000) | (R << 16) | (G << 8) | B);
+								} break;
+
+								case QOI_OP_LUMA: {
+									u32 Next = *At++;
+									s32 DiffG = (s32)(Op & 0x3F) - 32;
+									u32 R = (((Pixel >> 16) + DiffG - 8 + ((Next >> 4) & 0x0F)) & 0xFF);
+									u32 G = (((Pixel >> 8) + DiffG) & 0xFF);
+									u32 B = (((Pixel >> 0) + DiffG - 8 + (Next & 0x0F)) & 0xFF);
+									Pixel = ((Pixel & 0xFF000000) | (R << 16) | (G << 8) | B);
+								} break;
+
+								case QOI_OP_RUN: {
+									Run = (Op & 0x3F);
+								} break;
+								}
+							}
+
+							Index[HashQoiPixel(Pixel)] = Pixel;
+						} else {
+							// NOTE(ivan): Truncated stream.
+							GameTLState.LastError = ErrorCode_QOILoader_Corrupted;
+							break;
+						}
+
+						Pixels[PixelIndex] = Pixel;
+					}
+
+					if (GameTLState.LastError == ErrorCode_NoError) {
+						// NOTE(ivan): The channels field is only a hint, RGBA ops may still show up in a 3-channel file.
+						PremultiplyARGB(Pixels, PixelCount);
+
+						Result.Pixels = Pixels;
+						Result.Width = (s32)Width;
+						Result.Height = (s32)Height;
+						Result.BytesPerPixel = 4;
+						Result.Pitch = (s32)Width * 4;
+					}
+				}
+
+				if (Result.Pixels)
+					CommitTemporaryMemory(ImageMemory);
+				else
+					EndTemporaryMemory(ImageMemory);
+			} else {
+				GameTLState.LastError = ErrorCode_QOILoader_Corrupted;
+			}
+		} else {
+			// NOTE(ivan): File is not QOI.
+			GameTLState.LastError = ErrorCode_WrongSignature;
+		}
+
+		FreeVfsFile(&FilePiece);
+	} else {
+		// NOTE(ivan): Not found.
+		// NOTE(ivan): LastError is already set to GameError_NotFound.
+	}
+
+	return Result;
+}
+
+b32
+WriteImageQoi(const char *FileName, image *Image, memory_heap *TempHeap, b32 IsOpaque) {
+	Assert(FileName);
+	Assert(Image);
+	Assert(Image->Pixels);
+	Assert(Image->BytesPerPixel == 4);
+	Assert(TempHeap);
+
+	b32 Result = false;
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	// NOTE(ivan): Worst case is QOI_OP_RGBA for every pixel.
+	uptr MaxSize = QOI_HEADER_SIZE + ((uptr)Image->Width * Image->Height * 5) + QOI_PADDING_SIZE;
+
+	temporary_memory TempMemory = BeginTemporaryMemory(TempHeap);
+	u8 *Output = (u8 *)PushSize(TempHeap, MaxSize);
+	if (Output) {
+		u8 *At = Output;
+		WriteBigEndianU32(At, FourCC("qoif"));
+		WriteBigEndianU32(At + 4, (u32)Image->Width);
+		WriteBigEndianU32(At + 8, (u32)Image->Height);
+		At[12] = IsOpaque ? 3 : 4; // NOTE(ivan): Channels.
+		At[13] = 0; // NOTE(ivan): sRGB with linear alpha.
+		At += QOI_HEADER_SIZE;
+
+		u32 Index[64] = {};
+		u32 Prev = 0xFF000000;
+		u32 Run = 0;
+
+		for (s32 Y = 0; Y < Image->Height; Y++) {
+			u32 *Row = (u32 *)((u8 *)Image->Pixels + ((uptr)Y * Image->Pitch));
+			for (s32 X = 0; X < Image->Width; X++) {
+				// NOTE(ivan): QOI stores straight alpha.
+				u32 Pixel = IsOpaque ? (Row[X] | 0xFF000000) : UnpremultiplyPixel(Row[X]);
+				if (Pixel == Prev) {
+					Run++;
+					if (Run == 62) {
+						*At++ = (u8)(QOI_OP_RUN | (Run - 1));
+						Run = 0;
+					}
+					continue;
+				}
+
+				if (Run) {
+					*At++ = (u8)(QOI_OP_RUN | (Run - 1));
+					Run = 0;
+				}
+
+				u32 Hash = HashQoiPixel(Pixel);
+				if (Index[Hash] == Pixel) {
+					*At++ = (u8)(QOI_OP_INDEX | Hash);
+				} else {
+					Index[Hash] = Pixel;
+
+					if ((Pixel & 0xFF000000) == (Prev & 0xFF000000)) {
+						s8 DiffR = (s8)(((Pixel >> 16) & 0xFF) - ((Prev >> 16) & 0xFF));
+						s8 DiffG = (s8)(((Pixel >> 8) & 0xFF) - ((Prev >> 8) & 0xFF));
+						s8 DiffB = (s8)(((Pixel >> 0) & 0xFF) - ((Prev >> 0) & 0xFF));
+						s8 DiffRG = (s8)(DiffR - DiffG);
+						s8 DiffBG = (s8)(DiffB - DiffG);
+
+						if ((DiffR > -3) && (DiffR < 2) && (DiffG > -3) && (DiffG < 2) && (DiffB > -3) && (DiffB < 2)) {
+							*At++ = (u8)(QOI_OP_DIFF | ((DiffR + 2) << 4) | ((DiffG + 2) << 2) | (DiffB + 2));
+						} else if ((DiffRG > -9) && (DiffRG < 8) && (DiffG > -33) && (DiffG < 32) && (DiffBG > -9) && (DiffBG < 8)) {
+							*At++ = (u8)(QOI_OP_LUMA | (DiffG + 32));
+							*At++ = (u8)(((DiffRG + 8) << 4) | (DiffBG + 8));
+						} else {
+							*At++ = QOI_OP_RGB;
+							*At++ = (u8)(Pixel >> 16);
+							*At++ = (u8)(Pixel >> 8);
+							*At++ = (u8)(Pixel >> 0);
+						}
+					} else {
+						*At++ = QOI_OP_RGBA;
+						*At++ = (u8)(Pixel >> 16);
+						*At++ = (u8)(Pixel >> 8);
+						*At++ = (u8)(Pixel >> 0);
+						*At++ = (u8)(Pixel >> 24);
+					}
+				}
+
+				Prev = Pixel;
+			}
+		}
+		if (Run)
+			*At++ = (u8)(QOI_OP_RUN | (Run - 1));
+
+		memset(At, 0, QOI_PADDING_SIZE - 1);
+		At[QOI_PADDING_SIZE - 1] = 1;
+		At += QOI_PADDING_SIZE;
+
+		Result = PlatformWriteEntireFile(FileName, Output, At - Output);
+	}
+	EndTemporaryMemory(TempMemory);
+
+	return Result;
+}
@@ -9,10 +9,13 @@
 #define GAME_IMAGE_H
 
 #include "game_memory.h"
+#include "game_vfs.h"
 
 // NOTE(ivan): Image container.
+// Pixels are always premultiplied by alpha, every loader converts to that and the draw routines
+// blend as Dst * (1 - SrcA) + Src. Files that store straight alpha are converted on the way in and out.
 struct image {
-	u32 *Pixels; // NOTE(ivan): Format - 0xAARRGGBB.
+	u32 *Pixels; // NOTE(ivan): Format - 0xAARRGGBB, premultiplied.
 	s32 Width;
 	s32 Height;
 	s32 BytesPerPixel;
@@ -20,5 +23,8 @@ struct image {
 };
 
 image LoadImageBmp(const char *FileName, memory_heap *Heap);
+image LoadImagePng(const char *FileName, memory_heap *Heap);
+image LoadImageQoi(const char *FileName, memory_heap *Heap);
+b32 WriteImageQoi(const char *FileName, image *Image, memory_heap *TempHeap, b32 IsOpaque); // NOTE(ivan): IsOpaque forces alpha to 0xFF.
 
 #endif // #ifndef GAME_IMAGE_H
@@ -0,0 +1,385 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#ifndef GAME_JOB_H
+#define GAME_JOB_H
+
+#include "game_platform.h"
+
+// NOTE(ivan): Job scheduler shared by the platform layers, the game uses the Platform*() interface.
+// The platform layer owns the threads and the way idle threads sleep, everything else is here.
+
+// NOTE(ivan): Bounded lock-free multi-producer multi-consumer ring (D. Vyukov's algorithm).
+// Every entry carries a sequence number telling whether it is free for the producer
+// at a given position or ready for the consumer, so producers and consumers only contend
+// on their own position counter. Takes jobs from threads that own no deque, and work queue entries.
+#define WORK_QUEUE_SIZE 1024 // NOTE(ivan): Must be a power of two.
+
+struct work_queue_entry {
+	volatile u32 Sequence;
+	job Job;
+};
+
+struct work_queue {
+	// NOTE(ivan): Positions live on separate cache lines so producers and consumers do not fight over one.
+	volatile u32 EnqueuePos;
+	u8 Pad0[60];
+	volatile u32 DequeuePos;
+	u8 Pad1[60];
+
+	work_queue_entry Entries[WORK_QUEUE_SIZE];
+};
+
+inline void
+InitializeWorkQueue(work_queue *Queue) {
+	Assert(Queue);
+	Assert(IsPow2(WORK_QUEUE_SIZE));
+
+	Queue->EnqueuePos = 0;
+	Queue->DequeuePos = 0;
+	for (u32 Index = 0; Index < WORK_QUEUE_SIZE; Index++)
+		Queue->Entries[Index].Sequence = Index;
+}
+
+// NOTE(ivan): Returns false if the ring is full.
+inline b32
+PushWorkQueueEntry(work_queue *Queue, job *Job) {
+	Assert(Queue);
+	Assert(Job);
+
+	for (;;) {
+		u32 Pos = Queue->EnqueuePos;
+		work_queue_entry *Entry = &Queue->Entries[Pos & (WORK_QUEUE_SIZE - 1)];
+		u32 Sequence = Entry->Sequence;
+		CompilerBarrier();
+
+		s32 Diff = (s32)(Sequence - Pos);
+		if (Diff == 0) {
+			if (AtomicCompareExchangeU32(&Queue->EnqueuePos, Pos + 1, Pos) == Pos) {
+				Entry->Job = *Job;
+				CompilerBarrier();
+				Entry->Sequence = Pos + 1; // NOTE(ivan): Publish.
+				return true;
+			}
+		} else if (Diff < 0) {
+			return false;
+		}
+	}
+}
+
+// NOTE(ivan): Returns false if the ring is empty.
+inline b32
+PopWorkQueueEntry(work_queue *Queue, job *Job) {
+	Assert(Queue);
+	Assert(Job);
+
+	for (;;) {
+		u32 Pos = Queue->DequeuePos;
+		work_queue_entry *Entry = &Queue->Entries[Pos & (WORK_QUEUE_SIZE - 1)];
+		u32 Sequence = Entry->Sequence;
+		CompilerBarrier();
+
+		s32 Diff = (s32)(Sequence - (Pos + 1));
+		if (Diff == 0) {
+			if (AtomicCompareExchangeU32(&Queue->DequeuePos, Pos + 1, Pos) == Pos) {
+				*Job = Entry->Job;
+				CompilerBarrier();
+				Entry->Sequence = Pos + WORK_QUEUE_SIZE; // NOTE(ivan): Free for the producer one lap later.
+				return true;
+			}
+		} else if (Diff < 0) {
+			return false;
+		}
+	}
+}
+
+// NOTE(ivan): Chase-Lev work-stealing deque, fixed size.
+// The owner thread pushes and pops at the bottom, any other thread steals from the top.
+// Ordering follows "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.) mapped onto x86:
+// the only store-load ordering needed is the owner's bottom store against its top load in PopJobDeque().
+#define JOB_DEQUE_SIZE 2048 // NOTE(ivan): Must be a power of two.
+
+struct job_deque {
+	volatile u64 Top;
+	u8 Pad0[56];
+	volatile u64 Bottom;
+	u8 Pad1[56];
+
+	job Jobs[JOB_DEQUE_SIZE];
+};
+
+// NOTE(ivan): Owner only. Returns false if the deque is full.
+inline b32
+PushJobDeque(job_deque *Deque, job *Job) {
+	Assert(Deque);
+	Assert(Job);
+
+	u64 Bottom = Deque->Bottom;
+	u64 Top = Deque->Top;
+	CompilerBarrier();
+	if ((s64)(Bottom - Top) >= JOB_DEQUE_SIZE)
+		return false;
+
+	Deque->Jobs[Bottom & (JOB_DEQUE_SIZE - 1)] = *Job;
+	CompilerBarrier();
+	Deque->Bottom = Bottom + 1; // NOTE(ivan): Publish.
+
+	return true;
+}
+
+// NOTE(ivan): Owner only. Takes the newest job.
+inline b32
+PopJobDeque(job_deque *Deque, job *Job) {
+	Assert(Deque);
+	Assert(Job);
+
+	u64 Bottom = Deque->Bottom - 1;
+	AtomicExchangeU64(&Deque->Bottom, Bottom); // NOTE(ivan): Must be visible to thieves before Top is read.
+	u64 Top = Deque->Top;
+
+	b32 Result = false;
+	if ((s64)(Bottom - Top) >= 0) {
+		*Job = Deque->Jobs[Bottom & (JOB_DEQUE_SIZE - 1)];
+		Result = true;
+
+		if (Bottom == Top) {
+			// NOTE(ivan): The last job, thieves may be racing for it.
+			if (AtomicCompareExchangeU64(&Deque->Top, Top + 1, Top) != Top)
+				Result = false;
+			Deque->Bottom = Bottom + 1;
+		}
+	} else {
+		Deque->Bottom = Bottom + 1;
+	}
+
+	return Result;
+}
+
+// NOTE(ivan): Any thread. Takes the oldest job.
+inline b32
+StealJobDeque(job_deque *Deque, job *Job) {
+	Assert(Deque);
+	Assert(Job);
+
+	u64 Top = Deque->Top;
+	CompilerBarrier();
+	u64 Bottom = Deque->Bottom;
+	if ((s64)(Bottom - Top) <= 0)
+		return false;
+
+	// NOTE(ivan): May be a torn read if the owner wrapped around, but then the exchange below fails.
+	*Job = Deque->Jobs[Top & (JOB_DEQUE_SIZE - 1)];
+	CompilerBarrier();
+
+	return AtomicCompareExchangeU64(&Deque->Top, Top + 1, Top) == Top;
+}
+
+// NOTE(ivan): Scheduler state of a single thread, on its own cache lines.
+struct job_worker {
+	job_deque Deque;
+	job_worker_stats Stats;
+	u32 RandomState; // NOTE(ivan): Victim selection.
+	u8 Pad[20];
+};
+
+// NOTE(ivan): Spins done looking for work before an idle thread goes to sleep.
+#define JOB_IDLE_SPIN_COUNT 64
+
+struct job_system {
+	work_queue Queue;
+	job_counter AllWork; // NOTE(ivan): Entries added by PlatformAddWorkQueueEntry().
+
+	volatile u32 SleepingCount;
+	u32 ThreadCount; // NOTE(ivan): Primary thread and the workers.
+	job_worker Workers[MAX_WORKER_THREADS + 1]; // NOTE(ivan): Primary thread is the first.
+};
+
+inline void
+InitializeJobSystem(job_system *System) {
+	Assert(System);
+
+	InitializeWorkQueue(&System->Queue);
+	System->AllWork.Value = 0;
+	System->SleepingCount = 0;
+	System->ThreadCount = 1;
+	for (u32 Index = 0; Index < CountOf(System->Workers); Index++) {
+		job_worker *Worker = &System->Workers[Index];
+		Worker->Deque.Top = 0;
+		Worker->Deque.Bottom = 0;
+		Worker->Stats = {};
+		Worker->RandomState = (Index + 1) * 2654435761u;
+	}
+}
+
+inline void
+RunJob(job_system *System, s32 Self, job *Job) {
+	Assert(System);
+	Assert(Job);
+
+	Job->Callback(Job->Data);
+	if (Job->Counter)
+		AtomicDecrementU32(&Job->Counter->Value);
+
+	if (Self >= 0)
+		System->Workers[Self].Stats.JobsExecuted++;
+}
+
+// NOTE(ivan): Own deque first, then the shared ring, then the other threads' deques starting from a random one.
+// Self is -1 for threads that own no deque.
+inline b32
+GetNextJob(job_system *System, s32 Self, job *Job) {
+	Assert(System);
+	Assert(Job);
+
+	if (Self < 0)
+		return PopWorkQueueEntry(&System->Queue, Job);
+
+	job_worker *Worker = &System->Workers[Self];
+	if (PopJobDeque(&Worker->Deque, Job))
+		return true;
+	if (PopWorkQueueEntry(&System->Queue, Job))
+		return true;
+
+	u32 ThreadCount = System->ThreadCount;
+	if (ThreadCount > 1) {
+		// NOTE(ivan): Xorshift.
+		u32 Random = Worker->RandomState;
+		Random ^= (Random << 13);
+		Random ^= (Random >> 17);
+		Random ^= (Random << 5);
+		Worker->RandomState = Random;
+
+		u32 Victim = Random % ThreadCount;
+		for (u32 Index = 0; Index < ThreadCount; Index++, Victim = ((Victim + 1) == ThreadCount) ? 0 : (Victim + 1)) {
+			if (Victim == (u32)Self)
+				continue;
+
+			Worker->Stats.StealAttempts++;
+			if (StealJobDeque(&System->Workers[Victim].Deque, Job)) {
+				Worker->Stats.JobsStolen++;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// NOTE(ivan): Own deque if there is one and it has room, the shared ring otherwise.
+// If both are full the job runs right away.
+inline void
+PushJob(job_system *System, s32 Self, job *Job) {
+	Assert(System);
+	Assert(Job);
+
+	if ((Self >= 0) && PushJobDeque(&System->Workers[Self].Deque, Job))
+		return;
+	if (PushWorkQueueEntry(&System->Queue, Job))
+		return;
+
+	RunJob(System, Self, Job);
+}
+
+// NOTE(ivan): How many sleeping threads should be woken up after Count jobs were pushed.
+inline u32
+GetJobWakeCount(job_system *System, u32 Count) {
+	Assert(System);
+
+	// NOTE(ivan): Pairs with the sleeper incrementing SleepingCount before its last look for work,
+	// one of the two sides always sees the other.
+	FullMemoryBarrier();
+	return Min(Count, System->SleepingCount);
+}
+
+// NOTE(ivan): Runs jobs until the counter reaches zero.
+inline void
+WaitForJobCounter(job_system *System, s32 Self, job_counter *Counter) {
+	Assert(System);
+	Assert(Counter);
+
+	while (Counter->Value) {
+		job Job;
+		if (GetNextJob(System, Self, &Job)) {
+			RunJob(System, Self, &Job);
+		} else {
+			u64 IdleStart = __rdtsc();
+			YieldProcessor();
+			if (Self >= 0)
+				System->Workers[Self].Stats.IdleCycles += (__rdtsc() - IdleStart);
+		}
+	}
+}
+
+// NOTE(ivan): CPU layout detected by the platform layer. Threads of the job system get pinned one per physical core
+// in core order (the primary thread takes the first one), so no two of them share an SMT pair.
+// A render thread of the platform layer takes the core after the last worker.
+// Threads beyond the core count are not pinned to a single CPU.
+#define MAX_CPUS 256
+
+struct cpu_layout {
+	u32 CpuCount; // NOTE(ivan): Logical CPUs the game is allowed to run on.
+	u32 CoreCount; // NOTE(ivan): Physical cores with at least one allowed CPU.
+	u16 CoreCpus[MAX_CPUS]; // NOTE(ivan): Lowest allowed logical CPU of every core, the one threads get pinned to.
+	u8 IsAllowed[MAX_CPUS];
+};
+
+// NOTE(ivan): Adds a Linux-style CPU list ("0-3,8,10-11") to the set, CPUs past MAX_CPUS are dropped.
+// Returns false on a malformed list, the set may be partially filled then.
+inline b32
+ParseCpuList(const char *List, u8 *Cpus) {
+	Assert(List);
+	Assert(Cpus);
+
+	const char *At = List;
+	while ((*At == ' ') || (*At == '\t'))
+		At++;
+	if ((*At == 0) || (*At == '\n'))
+		return true; // NOTE(ivan): Empty list.
+
+	for (;;) {
+		if ((*At < '0') || (*At > '9'))
+			return false;
+
+		u32 First = 0;
+		while ((*At >= '0') && (*At <= '9'))
+			First = (First * 10) + (*At++ - '0');
+
+		u32 Last = First;
+		if (*At == '-') {
+			At++;
+			if ((*At < '0') || (*At > '9'))
+				return false;
+
+			Last = 0;
+			while ((*At >= '0') && (*At <= '9'))
+				Last = (Last * 10) + (*At++ - '0');
+			if (Last < First)
+				return false;
+		}
+
+		for (u32 Cpu = First; (Cpu <= Last) && (Cpu < MAX_CPUS); Cpu++)
+			Cpus[Cpu] = true;
+
+		if (*At != ',')
+			break;
+		At++;
+	}
+
+	return (*At == 0) || (*At == '\n');
+}
+
+// NOTE(ivan): Logical CPU the thread should be pinned to, -1 if it gets no core of its own.
+inline s32
+GetThreadCpu(cpu_layout *Layout, u32 ThreadIndex) {
+	Assert(Layout);
+
+	if (ThreadIndex < Layout->CoreCount)
+		return Layout->CoreCpus[ThreadIndex];
+	return -1;
+}
+
+#endif // #ifndef GAME_JOB_H
@@ -10,9 +10,81 @@
 
 #include "game_platform.h"
 
-// NOTE(ivan): Memory heap.
+// NOTE(ivan): Memory heap, a linear allocator over a piece of the hunk.
 struct memory_heap {
-	s32 Placeholder;
+	u8 *Base;
+	uptr Size;
+	uptr Used;
+
+	s32 TempCount;
+};
+
+// NOTE(ivan): Temporary memory, rolls the heap back to where it was at BeginTemporaryMemory().
+struct temporary_memory {
+	memory_heap *Heap;
+	uptr Used;
 };
 
+inline void
+InitializeHeap(memory_heap *Heap, void *Base, uptr Size) {
+	Assert(Heap);
+	Assert(Base);
+
+	Heap->Base = (u8 *)Base;
+	Heap->Size = Size;
+	Heap->Used = 0;
+	Heap->TempCount = 0;
+}
+
+// NOTE(ivan): Returns 0 if the heap is exhausted.
+#define PushType(Heap, Type) (Type *)PushSize(Heap, sizeof(Type))
+#define PushArray(Heap, Type, Count) (Type *)PushSize(Heap, sizeof(Type) * (Count))
+inline void *
+PushSize(memory_heap *Heap, uptr Size, uptr Alignment = 16) {
+	Assert(Heap);
+
+	uptr Base = (uptr)(Heap->Base + Heap->Used);
+	uptr AlignedBase = AlignPow2(Base, Alignment);
+	uptr TotalSize = Size + (AlignedBase - Base);
+	if ((Heap->Used + TotalSize) > Heap->Size)
+		return 0;
+
+	Heap->Used += TotalSize;
+	return (void *)AlignedBase;
+}
+
+inline temporary_memory
+BeginTemporaryMemory(memory_heap *Heap) {
+	Assert(Heap);
+
+	temporary_memory Result;
+	Result.Heap = Heap;
+	Result.Used = Heap->Used;
+
+	Heap->TempCount++;
+
+	return Result;
+}
+
+inline void
+EndTemporaryMemory(temporary_memory TempMem) {
+	memory_heap *Heap = TempMem.Heap;
+	Assert(Heap);
+	Assert(Heap->Used >= TempMem.Used);
+	Assert(Heap->TempCount > 0);
+
+	Heap->Used = TempMem.Used;
+	Heap->TempCount--;
+}
+
+// NOTE(ivan): Keeps everything allocated since BeginTemporaryMemory().
+inline void
+CommitTemporaryMemory(temporary_memory TempMem) {
+	memory_heap *Heap = TempMem.Heap;
+	Assert(Heap);
+	Assert(Heap->TempCount > 0);
+
+	Heap->TempCount--;
+}
+
 #endif // #ifndef GAME_MEMORY_H
@@ -10,6 +10,37 @@
 
 #include "game_platform.h"
 
+// NOTE(ivan): String and memory helpers.
+inline b32
+AreStringsEqual(const char *A, const char *B) {
+	Assert(A);
+	Assert(B);
+	return strcmp(A, B) == 0;
+}
+
+inline void
+CopyString(char *Dest, const char *Src) {
+	Assert(Dest);
+	Assert(Src);
+	strcpy(Dest, Src);
+}
+
+// NOTE(ivan): Copies exactly Count characters and terminates the destination.
+inline void
+CopyStringN(char *Dest, const char *Src, uptr Count) {
+	Assert(Dest);
+	Assert(Src);
+	memcpy(Dest, Src, Count);
+	Dest[Count] = 0;
+}
+
+inline void
+CopyBytes(void *Dest, const void *Src, uptr Size) {
+	Assert(Dest);
+	Assert(Src);
+	memcpy(Dest, Src, Size);
+}
+
 void
 ExtractFileExtension(char *Buffer, uptr Size, const char *FileName) {
 	Assert(Buffer);
@@ -0,0 +1,174 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#ifndef GAME_PARALLEL_H
+#define GAME_PARALLEL_H
+
+#include "game_platform.h"
+
+// NOTE(ivan): Parallel loops over [0, Count) on top of the job system.
+// The range is cut into chunks of at least GrainSize indices, a few chunks per thread,
+// and every participating thread (the calling one included) keeps claiming the next chunk until none are left,
+// so threads that got cheap chunks simply take more of them. Ranges of up to GrainSize indices,
+// or any range when there are no worker threads, run inline on the calling thread.
+// NOTE(ivan): Lambdas run concurrently, they must not allocate from a shared memory_heap.
+#define PARALLEL_CHUNKS_PER_THREAD 4
+#define PARALLEL_MAX_CHUNKS 256
+
+struct parallel_range {
+	u32 Count;
+	u32 ChunkSize;
+	u32 ChunkCount;
+	volatile u32 NextChunk;
+};
+
+// NOTE(ivan): Returns the number of helper jobs worth starting besides the calling thread, zero means run inline.
+inline u32
+InitializeParallelRange(parallel_range *Range, u32 Count, u32 GrainSize) {
+	Assert(Range);
+
+	if (!GrainSize)
+		GrainSize = 1;
+
+	u32 ThreadCount = PlatformGetWorkerCount() + 1;
+	u32 ChunkCount = 1;
+	if ((Count > GrainSize) && (ThreadCount > 1)) {
+		ChunkCount = (u32)(((u64)Count + GrainSize - 1) / GrainSize);
+		ChunkCount = Min(ChunkCount, Min(ThreadCount * PARALLEL_CHUNKS_PER_THREAD, (u32)PARALLEL_MAX_CHUNKS));
+	}
+
+	Range->Count = Count;
+	Range->ChunkSize = (u32)(((u64)Count + ChunkCount - 1) / ChunkCount);
+	Range->ChunkCount = ChunkCount;
+	Range->NextChunk = 0;
+
+	return Min(ChunkCount, ThreadCount) - 1;
+}
+
+// NOTE(ivan): Claims the next unprocessed chunk, returns false once the whole range is handed out.
+inline b32
+GetNextParallelChunk(parallel_range *Range, u32 *Chunk, u32 *Begin, u32 *End) {
+	Assert(Range);
+	Assert(Chunk);
+	Assert(Begin);
+	Assert(End);
+
+	// NOTE(ivan): Cheap check first, late helpers should not bump the counter of a finished range.
+	if (Range->NextChunk >= Range->ChunkCount)
+		return false;
+
+	u32 Index = AtomicAddU32(&Range->NextChunk, 1);
+	if (Index >= Range->ChunkCount)
+		return false;
+
+	*Chunk = Index;
+	*Begin = Index * Range->ChunkSize;
+	*End = Min(*Begin + Range->ChunkSize, Range->Count);
+
+	return true;
+}
+
+// NOTE(ivan): Starts HelperCount copies of the callback as jobs, runs one more on the calling thread
+// and returns once all of them are done.
+inline void
+RunParallelJobs(platform_work_queue_callback *Callback, void *Data, u32 HelperCount) {
+	Assert(Callback);
+	Assert(HelperCount <= MAX_WORKER_THREADS);
+
+	job Jobs[MAX_WORKER_THREADS];
+	for (u32 Index = 0; Index < HelperCount; Index++) {
+		Jobs[Index].Callback = Callback;
+		Jobs[Index].Data = Data;
+		Jobs[Index].Counter = 0;
+	}
+
+	job_counter Counter = {};
+	PlatformRunJobs(Jobs, HelperCount, &Counter);
+	Callback(Data);
+	PlatformWaitForCounter(&Counter);
+}
+
+template <typename F>
+struct parallel_for_task {
+	parallel_range Range;
+	F *Lambda;
+};
+
+template <typename F> static void
+ParallelForJob(void *Data) {
+	parallel_for_task<F> *Task = (parallel_for_task<F> *)Data;
+
+	u32 Chunk, Begin, End;
+	while (GetNextParallelChunk(&Task->Range, &Chunk, &Begin, &End)) {
+		for (u32 Index = Begin; Index < End; Index++)
+			(*Task->Lambda)(Index);
+	}
+}
+
+// NOTE(ivan): Calls Lambda(u32 Index) once for every index in [0, Count), in no particular order.
+template <typename F> inline void
+ParallelFor(u32 Count, u32 GrainSize, F Lambda) {
+	parallel_for_task<F> Task;
+	Task.Lambda = &Lambda;
+
+	u32 HelperCount = InitializeParallelRange(&Task.Range, Count, GrainSize);
+	if (HelperCount) {
+		RunParallelJobs(ParallelForJob<F>, &Task, HelperCount);
+	} else {
+		for (u32 Index = 0; Index < Count; Index++)
+			Lambda(Index);
+	}
+}
+
+template <typename T, typename F, typename C>
+struct parallel_reduce_task {
+	parallel_range Range;
+	T Identity;
+	F *Lambda;
+	C *Combine;
+	T Partials[PARALLEL_MAX_CHUNKS];
+};
+
+template <typename T, typename F, typename C> static void
+ParallelReduceJob(void *Data) {
+	parallel_reduce_task<T, F, C> *Task = (parallel_reduce_task<T, F, C> *)Data;
+
+	u32 Chunk, Begin, End;
+	while (GetNextParallelChunk(&Task->Range, &Chunk, &Begin, &End)) {
+		T Partial = Task->Identity;
+		for (u32 Index = Begin; Index < End; Index++)
+			Partial = (*Task->Combine)(Partial, (*Task->Lambda)(Index));
+		Task->Partials[Chunk] = Partial;
+	}
+}
+
+// NOTE(ivan): Combines Lambda(u32 Index) of every index in [0, Count) with Combine(T, T), starting from Identity.
+// Partial results are combined in index order, so the result does not depend on the thread count
+// as long as Combine is associative (not quite the case with floats, but then it is at least repeatable).
+template <typename T, typename F, typename C> inline T
+ParallelReduce(u32 Count, u32 GrainSize, T Identity, F Lambda, C Combine) {
+	parallel_reduce_task<T, F, C> Task;
+	Task.Identity = Identity;
+	Task.Lambda = &Lambda;
+	Task.Combine = &Combine;
+
+	T Result = Identity;
+
+	u32 HelperCount = InitializeParallelRange(&Task.Range, Count, GrainSize);
+	if (HelperCount) {
+		RunParallelJobs(ParallelReduceJob<T, F, C>, &Task, HelperCount);
+		for (u32 Chunk = 0; Chunk < Task.Range.ChunkCount; Chunk++)
+			Result = Combine(Result, Task.Partials[Chunk]);
+	} else {
+		for (u32 Index = 0; Index < Count; Index++)
+			Result = Combine(Result, Lambda(Index));
+	}
+
+	return Result;
+}
+
+#endif // #ifndef GAME_PARALLEL_H
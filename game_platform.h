@@ -41,6 +41,7 @@
 #include <intrin.h>
 #elif GNUC
 #include <x86intrin.h>
+#include <cpuid.h>
 #endif
 
 // NOTE(ivan): Detect target CPU architecture.
@@ -237,8 +238,8 @@ FindMostSignificantBit(u32 Value)
 #if MSVC
 	Result.IsFound = _BitScanReverse((unsigned long *)&Result.Index, Value);
 #else
-	for (s32 Test = 31; Test >= 0; Test++) {
-		if (Value & (1 << Test)) {
+	for (s32 Test = 31; Test >= 0; Test--) {
+		if (Value & (1u << Test)) {
 			Result.IsFound = true;
 			Result.Index = Test;
 			break;
@@ -310,6 +311,7 @@ inline u32 AtomicExchangeU32(volatile u32 *Target, u32 Value) {return _Interlock
 inline u64 AtomicExchangeU64(volatile u64 *Target, u64 Value) {return _InterlockedExchange64((volatile __int64 *)Target, Value);}
 inline u32 AtomicCompareExchangeU32(volatile u32 *Value, u32 NewValue, u32 Exp) {return _InterlockedCompareExchange((volatile long *)Value, NewValue, Exp);}
 inline u64 AtomicCompareExchangeU64(volatile u64 *Value, u64 NewValue, u64 Exp) {return _InterlockedCompareExchange64((volatile __int64 *)Value, NewValue, Exp);}
+inline u32 AtomicAddU32(volatile u32 *Value, u32 Addend) {return _InterlockedExchangeAdd((volatile long *)Value, Addend);}
 #elif GNUC
 inline u32 AtomicIncrementU32(volatile u32 *Value) {return __sync_fetch_and_add(Value, 1);}
 inline u64 AtomicIncrementU64(volatile u64 *Value) {return __sync_fetch_and_add(Value, 1);}
@@ -319,6 +321,7 @@ inline u32 AtomicExchangeU32(volatile u32 *Target, u32 Value) {return __sync_loc
 inline u64 AtomicExchangeU64(volatile u64 *Target, u64 Value) {return __sync_lock_test_and_set(Target, Value);}
 inline u32 AtomicCompareExchangeU32(volatile u32 *Value, u32 NewValue, u32 Exp) {return __sync_val_compare_and_swap(Value, Exp, NewValue);}
 inline u64 AtomicCompareExchangeU64(volatile u64 *Value, u64 NewValue, u64 Exp) {return __sync_val_compare_and_swap(Value, Exp, NewValue);}
+inline u32 AtomicAddU32(volatile u32 *Value, u32 Addend) {return __sync_fetch_and_add(Value, Addend);}
 #endif
 
 // NOTE(ivan): Yield processor, give its time to other threads.
@@ -328,29 +331,163 @@ inline void YieldProcessor(void) {_mm_pause();}
 inline void YieldProcessor(void) {_mm_pause();}
 #endif
 
-// NOTE(ivan): Cross-platform ticket-mutex.
+// NOTE(ivan): Compiler-only memory barrier. Every supported CPU is x86, where neither stores are reordered
+// with older stores nor loads with older loads, so keeping the compiler from reordering is all
+// acquire/release semantics need there.
+#if MSVC
+#define CompilerBarrier() _ReadWriteBarrier()
+#elif GNUC
+#define CompilerBarrier() __asm__ __volatile__("" ::: "memory")
+#endif
+
+// NOTE(ivan): Full memory barrier, the only one x86 needs: orders a store before a later load.
+#define FullMemoryBarrier() _mm_mfence()
+
+// NOTE(ivan): CPUID, Regs receive EAX, EBX, ECX, EDX. Returns false if the leaf is not supported.
+inline b32
+QueryCpuid(u32 Leaf, u32 *Regs) {
+	Assert(Regs);
+
+#if MSVC
+	s32 Info[4];
+	__cpuid(Info, Leaf & 0x80000000);
+	if ((u32)Info[0] < Leaf)
+		return false;
+	__cpuidex(Info, Leaf, 0);
+	for (u32 Index = 0; Index < 4; Index++)
+		Regs[Index] = (u32)Info[Index];
+	return true;
+#elif GNUC
+	return __get_cpuid(Leaf, &Regs[0], &Regs[1], &Regs[2], &Regs[3]) != 0;
+#endif
+}
+
+// NOTE(ivan): Time stamp counter rate as CPUID leaf 0x15 reports it (TSC / crystal ratio times the crystal clock),
+// zero if the CPU does not enumerate the crystal clock. IsInvariant tells whether the TSC ticks at a constant rate
+// through frequency changes and sleep states, which all of the cycles-to-time conversion relies on.
+inline u64
+GetCpuidTscFrequency(b32 *IsInvariant) {
+	Assert(IsInvariant);
+
+	u32 Regs[4];
+	*IsInvariant = (QueryCpuid(0x80000007, Regs) && (Regs[3] & (1 << 8)));
+
+	u64 Result = 0;
+	if (QueryCpuid(0x15, Regs) && Regs[0] && Regs[1] && Regs[2])
+		Result = ((u64)Regs[2] * Regs[1]) / Regs[0];
+
+	return Result;
+}
+
+// NOTE(ivan): Thread parking on an address, implemented by the platform layer (futex on Linux, WaitOnAddress() on Win32).
+// PlatformWaitOnAddress() sleeps only while *Address still equals Expected, and may return spuriously.
+void PlatformWaitOnAddress(volatile u32 *Address, u32 Expected);
+void PlatformWakeAllOnAddress(volatile u32 *Address);
+
+// NOTE(ivan): Cross-platform adaptive ticket-mutex.
+// Waiters spin proportionally to their distance from the head of the line, then park on the wake slot of their ticket.
+// A release bumps and wakes only the slot of the next ticket, so the handoff wakes the one thread that can take the lock
+// rather than every parked one. Tickets TICKET_MUTEX_SLOT_COUNT apart share a slot, with that many waiters
+// or more a few of them wake for nothing and park again.
 // NOTE(ivan): Any instance of this structure MUST be ZERO-initialized for proper functioning of EnterTicketMutex()/LeaveTicketMutex() macros.
+#define TICKET_MUTEX_SPIN_COUNT 128
+#define TICKET_MUTEX_SLOT_COUNT 16 // NOTE(ivan): Must be a power of two.
+
 struct ticket_mutex {
-	volatile u64 Ticket;
-	volatile u64 Serving;
+	volatile u32 Ticket;
+	volatile u32 Serving;
+	volatile u32 ParkedCount;
+	volatile u32 WakeSlots[TICKET_MUTEX_SLOT_COUNT]; // NOTE(ivan): Bumped every time the lock is handed to a ticket of the slot.
+
+#if INTERNAL
+	// NOTE(ivan): Contention statistics, only updated by the lock holder.
+	u64 AcquireCount;
+	u64 ContendedCount;
+	u64 WaitCycles;
+#endif
 };
 
 // NOTE(ivan): Ticket-mutex locking/unlocking.
 inline void
 EnterTicketMutex(ticket_mutex *Mutex) {
 	Assert(Mutex);
-	AtomicIncrementU64(&Mutex->Ticket);
-	
-	u64 Ticket = Mutex->Ticket - 1;
-	while (Ticket != Mutex->Serving)
-		YieldProcessor();
+
+	u32 Ticket = AtomicAddU32(&Mutex->Ticket, 1);
+	if (Mutex->Serving == Ticket) {
+#if INTERNAL
+		Mutex->AcquireCount++;
+#endif
+		return;
+	}
+
+#if INTERNAL
+	u64 WaitStart = __rdtsc();
+#endif
+
+	for (u32 Spin = 0; Spin < TICKET_MUTEX_SPIN_COUNT; Spin++) {
+		u32 Serving = Mutex->Serving;
+		if (Serving == Ticket)
+			break;
+
+		// NOTE(ivan): Proportional backoff, the farther in line the less often the shared line gets polled.
+		for (u32 Pause = (Ticket - Serving); Pause; Pause--)
+			YieldProcessor();
+	}
+
+	volatile u32 *WakeSlot = &Mutex->WakeSlots[Ticket & (TICKET_MUTEX_SLOT_COUNT - 1)];
+	while (Mutex->Serving != Ticket) {
+		// NOTE(ivan): The locked increment orders itself before the loads of the slot and Serving,
+		// LeaveTicketMutex() increments Serving before it looks at ParkedCount, and bumps the slot before it wakes it.
+		// Either the releaser sees this waiter parked, or this waiter sees the new Serving, so no wakeup can get lost.
+		AtomicIncrementU32(&Mutex->ParkedCount);
+		u32 Wake = *WakeSlot;
+		if (Mutex->Serving != Ticket)
+			PlatformWaitOnAddress(WakeSlot, Wake);
+		AtomicDecrementU32(&Mutex->ParkedCount);
+	}
+
+#if INTERNAL
+	Mutex->AcquireCount++;
+	Mutex->ContendedCount++;
+	Mutex->WaitCycles += (__rdtsc() - WaitStart);
+#endif
 }
 inline void
 LeaveTicketMutex(ticket_mutex *Mutex) {
 	Assert(Mutex);
-	AtomicIncrementU64(&Mutex->Serving);
+
+	u32 Serving = AtomicAddU32(&Mutex->Serving, 1) + 1;
+	if (Mutex->ParkedCount) {
+		// NOTE(ivan): Everything parked on the slot is woken, a single wake could pick a waiter sharing it with the next ticket.
+		volatile u32 *WakeSlot = &Mutex->WakeSlots[Serving & (TICKET_MUTEX_SLOT_COUNT - 1)];
+		AtomicIncrementU32(WakeSlot);
+		PlatformWakeAllOnAddress(WakeSlot);
+	}
 }
 
+// NOTE(ivan): Work queue callback, runs on any worker thread or on the thread waiting in PlatformCompleteAllWork().
+typedef void platform_work_queue_callback(void *Data);
+
+// NOTE(ivan): Job, counters are decremented once the callback returns.
+struct job_counter {
+	volatile u32 Value;
+};
+
+struct job {
+	platform_work_queue_callback *Callback;
+	void *Data;
+	job_counter *Counter; // NOTE(ivan): Optional.
+};
+
+// NOTE(ivan): Per-thread job scheduling statistics, cumulative since startup.
+struct job_worker_stats {
+	u64 JobsExecuted;
+	u64 JobsStolen;
+	u64 StealAttempts; // NOTE(ivan): Victims probed, including the successful ones.
+	u64 IdleCycles; // NOTE(ivan): Spinning or sleeping with nothing to run.
+	u64 SleepCount;
+};
+
 //
 // NOTE(ivan): Platform-specific interface.
 //
@@ -364,6 +501,55 @@ piece PlatformReadEntireFile(const char *FileName);
 b32 PlatformWriteEntireFile(const char *FileName, void *Base, uptr Size);
 void PlatformFreeEntireFilePiece(piece *Piece);
 
+// NOTE(ivan): Read-only file mapping, the piece stays valid until PlatformUnmapEntireFile().
+piece PlatformMapEntireFile(const char *FileName);
+void PlatformUnmapEntireFile(piece *Piece);
+
+// NOTE(ivan): Recursive enumeration of regular files under a directory.
+// RelativeName uses '/' as separator and does not include DirName.
+typedef void platform_enumerate_files_callback(const char *RelativeName, uptr FileSize, void *Param);
+b32 PlatformEnumerateFiles(const char *DirName, platform_enumerate_files_callback *Callback, void *Param);
+
+// NOTE(ivan): Work queue, shared by all threads. Entries may be added from any thread.
+// PlatformCompleteAllWork() helps running the entries until every entry added so far is done,
+// so it must not be called from inside a work queue callback.
+#define MAX_WORKER_THREADS 64
+void PlatformAddWorkQueueEntry(platform_work_queue_callback *Callback, void *Data);
+void PlatformCompleteAllWork(void);
+u32 PlatformGetWorkerCount(void); // NOTE(ivan): Not counting the primary thread, may be zero.
+
+// NOTE(ivan): Job system. Jobs go to the calling thread's own deque and idle threads steal them.
+// PlatformRunJobs() adds Count to the counter, every finished job takes one back.
+// PlatformWaitForCounter() runs other jobs until the counter reaches zero, so it may be called
+// from inside a job to wait for the jobs it depends on.
+void PlatformRunJobs(job *Jobs, u32 Count, job_counter *Counter);
+void PlatformWaitForCounter(job_counter *Counter);
+u32 PlatformGetJobStats(job_worker_stats *Stats, u32 MaxCount); // NOTE(ivan): Primary thread first, returns the thread count.
+
+// NOTE(ivan): Time stamp counter calibration, done once by the platform layer at startup.
+// Anything timed with __rdtsc() converts to real units with these.
+u64 PlatformGetCyclesPerSecond(void);
+f64 PlatformGetNanosecondsPerCycle(void);
+
+inline f64
+CyclesToNanoseconds(u64 Cycles) {
+	return (f64)Cycles * PlatformGetNanosecondsPerCycle();
+}
+inline f64
+CyclesToSeconds(u64 Cycles) {
+	return CyclesToNanoseconds(Cycles) * 1e-9;
+}
+inline u64
+NanosecondsToCycles(f64 Nanoseconds) {
+	return (u64)(Nanoseconds / PlatformGetNanosecondsPerCycle());
+}
+
+// NOTE(ivan): File watching, PlatformIsFileChanged() reports every change once.
+#define FILE_WATCH_INVALID ((s32)-1)
+s32 PlatformWatchFile(const char *FileName);
+void PlatformUnwatchFile(s32 Watch);
+b32 PlatformIsFileChanged(s32 Watch);
+
 //
 // NOTE(ivan): Platform-specific debug-only interface.
 //
@@ -373,4 +559,16 @@ void DEBUGPlatformOutf(const char *Format, ...);
 inline void DEBUGPlatformOutf(const char *Format, ...) {}
 #endif
 
+#if INTERNAL
+inline void
+DEBUGOutputTicketMutexStats(const char *Name, ticket_mutex *Mutex) {
+	Assert(Name);
+	Assert(Mutex);
+
+	DEBUGPlatformOutf("Lock %s: %llu acquisitions, %llu contended, %.3fms waited (%.3fus per contended)",
+					  Name, Mutex->AcquireCount, Mutex->ContendedCount, CyclesToNanoseconds(Mutex->WaitCycles) / 1000000.0,
+					  Mutex->ContendedCount ? (CyclesToNanoseconds(Mutex->WaitCycles / Mutex->ContendedCount) / 1000.0) : 0.0);
+}
+#endif
+
 #endif // #ifndef GAME_PLATFORM_H
@@ -8,6 +8,10 @@
 #include "game.h"
 #include "game_misc.h"
 #include "game_math.h"
+#include "game_job.h"
+#include "game_record.h"
+#include "game_parallel.h"
+#include "game_step.h"
 
 // NOTE(ivan): POSIX standard includes.
 #include <unistd.h>
@@ -19,6 +23,17 @@
 #include <time.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <dlfcn.h>
+
+// NOTE(ivan): Linux-specific standard includes.
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 // NOTE(ivan): X11 includes.
 #include <X11/Xlib.h>
@@ -32,33 +47,13 @@
 #include <X11/extensions/Xrandr.h>
 
 // NOTE(ivan): Linux includes.
-#include <linux/joystick.h>
+#include <linux/input.h>
 
-#define MAX_CONTROLLERS 8
+#define MAX_CONTROLLERS 4 // NOTE(ivan): One per game_state::XboxControllers.
+#define MAX_WATCHED_FILES 256
 
-// NOTE(ivan): Xbox controller definitions (found out by xev).
 #define XBOX_CONTROLLER_DEADZONE 5000
 
-#define XBOX_CONTROLLER_AXIS_LEFT_THUMB_X 0
-#define XBOX_CONTROLLER_AXIS_LEFT_THUMB_Y 1
-#define XBOX_CONTROLLER_AXIS_RIGHT_THUMB_X 2
-#define XBOX_CONTROLLER_AXIS_RIGHT_THUMB_Y 3
-#define XBOX_CONTROLLER_AXIS_RIGHT_TRIGGER 4
-#define XBOX_CONTROLLER_AXIS_LEFT_TRIGGER 5
-#define XBOX_CONTROLLER_AXIS_DPAD_HORZ 6
-#define XBOX_CONTROLLER_AXIS_DPAD_VERT 7
-
-#define XBOX_CONTROLLER_BUTTON_A 0
-#define XBOX_CONTROLLER_BUTTON_B 1
-#define XBOX_CONTROLLER_BUTTON_X 2
-#define XBOX_CONTROLLER_BUTTON_Y 3
-#define XBOX_CONTROLLER_BUTTON_LEFT_SHOULDER 4
-#define XBOX_CONTROLLER_BUTTON_RIGHT_SHOULDER 5
-#define XBOX_CONTROLLER_BUTTON_BACK 6
-#define XBOX_CONTROLLER_BUTTON_START 7
-#define XBOX_CONTROLLER_BUTTON_LEFT_THUMB 9
-#define XBOX_CONTROLLER_BUTTON_RIGHT_THUMB 10
-
 // NOTE(ivan): Linux video buffer.
 struct linux_video_buffer {
 	XImage *Image;
@@ -70,6 +65,83 @@ struct linux_video_buffer {
 	s32 Pitch;
 };
 
+// NOTE(ivan): Linux replay loop, see LinuxUpdateReplayLoop().
+enum linux_replay_loop_state {
+	LinuxReplayLoop_Off = 0,
+	LinuxReplayLoop_Recording,
+	LinuxReplayLoop_Playing
+};
+
+struct linux_replay_loop {
+	linux_replay_loop_state State;
+	u64 FirstFrame; // NOTE(ivan): "-loop <first>,<last>", LastFrame is 0 without it.
+	u64 LastFrame;
+
+	s32 InputFile; // NOTE(ivan): While recording.
+	input_recorder Recorder;
+	input_player Player;
+	u32 LoopCount;
+
+	// NOTE(ivan): Simulation clock at the first frame of the loop, it lives outside of the hunk.
+	fixed_step FixedStep;
+	u64 TickCount;
+};
+
+// NOTE(ivan): Game module, %OutputName%_ents.so next to the executable.
+struct linux_game_module {
+	void *Library;
+	game_update_func *Update;
+	game_render_func *Render;
+
+	char FileName[2048];
+	struct timespec LastWriteTime; // NOTE(ivan): Of the file the loaded library was copied from.
+	s32 Watch;
+	u32 LoadCount;
+};
+
+// NOTE(ivan): Linux renderer, rasterizes the render command lists of the game and presents them.
+// Right after the game update by default. With "-pipeline" it is done by a thread of its own: the game hands over
+// the finished list of frame N and goes on with frame N+1 into the other list, while frame N is rasterized and presented.
+// A frame then takes about as long as the slower of the two rather than both together, at the cost of one frame of latency.
+typedef void linux_present_func(void *Data, game_video_buffer *Buffer, u64 Frame);
+
+struct linux_renderer {
+	b32 IsPipelined;
+	render_commands Commands[2];
+	u64 Frames[2]; // NOTE(ivan): Frame number of each list.
+	u32 WriteIndex; // NOTE(ivan): The list the game fills, the other one may be in flight.
+
+	game_video_buffer Target;
+	linux_present_func *Present; // NOTE(ivan): May be 0.
+	void *PresentData;
+
+	pthread_t Thread;
+	sem_t ReadySemaphore; // NOTE(ivan): Posted for every list handed over.
+	sem_t FreeSemaphore; // NOTE(ivan): Posted once the render thread is done with a list, at most one is in flight.
+	volatile b32 IsQuitting;
+};
+
+// NOTE(ivan): Linux watched file.
+// NOTE(ivan): The containing directory is watched rather than the file itself,
+// because editors usually save by writing a temporary file and renaming it over the old one.
+struct linux_watched_file {
+	b32 IsUsed;
+	b32 IsChanged;
+	s32 DirWatch;
+	char BaseName[256];
+};
+
+// NOTE(ivan): Linux game controller, an evdev device.
+struct linux_controller {
+	b32 IsUsed;
+	s32 File;
+	u32 EventNumber; // NOTE(ivan): N of /dev/input/eventN.
+	b32 IsDropped; // NOTE(ivan): The kernel buffer overflowed, events are skipped up to the next SYN_REPORT and the state is read anew.
+
+	u8 AxisBits[(ABS_CNT + 7) / 8];
+	struct input_absinfo Axes[ABS_CNT];
+};
+
 // NOTE(ivan): Linux global variables.
 static struct linux_state {
 	s32 ArgC;
@@ -89,7 +161,50 @@ static struct linux_state {
 	u32 XDefBlack;
 	u32 XDefWhite;
 	Atom XWMDeleteWindow;
+
+	s32 INotifyFD;
+	linux_watched_file WatchedFiles[MAX_WATCHED_FILES];
+
+	// NOTE(ivan): Job system and its workers, idle workers sleep on the semaphore.
+	job_system Jobs;
+	sem_t WorkSemaphore;
+	volatile b32 AreWorkersQuitting;
+	u32 WorkerCount;
+	pthread_t Workers[MAX_WORKER_THREADS];
+	u8 *ThreadMemory; // NOTE(ivan): THREAD_MEMORY_SIZE for every thread of the job system.
+	uptr ThreadMemorySize;
+
+	cpu_layout CpuLayout;
+	b32 IsAffinityEnabled;
+
+	u64 TscCyclesPerSecond;
+	f64 TscNanosecondsPerCycle;
+
+	// NOTE(ivan): Input recording and playback, see game_record.h.
+	s32 InputRecordFile; // NOTE(ivan): -1 if not recording.
+	input_recorder InputRecorder;
+	b32 IsPlayingBack;
+	input_player InputPlayer;
+
+	linux_replay_loop ReplayLoop;
+
+	fixed_step FixedStep;
+
+	linux_game_module GameModule;
+	linux_renderer Renderer;
+
+	// NOTE(ivan): Game controllers, see LinuxProcessControllers().
+	s32 ControllerEpollFD;
+	s32 ControllerINotifyFD;
+	linux_controller Controllers[MAX_CONTROLLERS];
+
+#if INTERNAL
+	ticket_mutex DebugOutputMutex; // NOTE(ivan): Keeps lines printed by different threads whole.
+#endif
 } LinuxState = {};
+static game_state GameState;
+thread_local game_tl_state GameTLState;
+static thread_local s32 LinuxJobWorkerIndex = -1; // NOTE(ivan): Deque owned by this thread, -1 if none.
 
 inline struct timespec
 LinuxGetClock(void) {
@@ -117,6 +232,150 @@ LinuxGetSecondsElapsed(struct timespec Start,
 	return ((f64)(End.tv_sec - Start.tv_sec) + ((f64)(End.tv_nsec - Start.tv_nsec) * 1e-9f));
 }
 
+inline u64
+LinuxGetNanoseconds(void) {
+	struct timespec Clock = LinuxGetClock();
+	return ((u64)Clock.tv_sec * 1000000000ull) + (u64)Clock.tv_nsec;
+}
+
+// NOTE(ivan): Reads the TSC and the clock as close together as possible, the pair with the shortest TSC window wins.
+static void
+LinuxSampleTscAndClock(u64 *Tsc, u64 *Nanoseconds) {
+	Assert(Tsc);
+	Assert(Nanoseconds);
+
+	u64 BestWindow = (u64)-1;
+	for (u32 Try = 0; Try < 8; Try++) {
+		u64 Before = LinuxGetRDTSC();
+		u64 Clock = LinuxGetNanoseconds();
+		u64 After = LinuxGetRDTSC();
+		if ((After - Before) < BestWindow) {
+			BestWindow = After - Before;
+			*Tsc = Before + ((After - Before) / 2);
+			*Nanoseconds = Clock;
+		}
+	}
+}
+
+// NOTE(ivan): CPUID leaf 0x15 when the CPU enumerates its crystal clock, otherwise measured against CLOCK_MONOTONIC.
+static void
+LinuxCalibrateTsc(void) {
+	b32 IsInvariant;
+	u64 CyclesPerSecond = GetCpuidTscFrequency(&IsInvariant);
+	b32 IsFromCpuid = (CyclesPerSecond != 0);
+
+	if (!IsFromCpuid) {
+		u64 StartTsc, StartNs;
+		LinuxSampleTscAndClock(&StartTsc, &StartNs);
+
+		struct timespec Duration = {0, 50 * 1000000};
+		while ((nanosleep(&Duration, &Duration) == -1) && (errno == EINTR)) {}
+
+		u64 EndTsc, EndNs;
+		LinuxSampleTscAndClock(&EndTsc, &EndNs);
+
+		CyclesPerSecond = (u64)(((f64)(EndTsc - StartTsc) * 1e9) / (f64)Max(EndNs - StartNs, (u64)1));
+	}
+
+	LinuxState.TscCyclesPerSecond = Max(CyclesPerSecond, (u64)1);
+	LinuxState.TscNanosecondsPerCycle = 1e9 / (f64)LinuxState.TscCyclesPerSecond;
+
+	DEBUGPlatformOutf("TSC: %.3fMHz (%s), %s", (f64)LinuxState.TscCyclesPerSecond / 1000000.0,
+					  IsFromCpuid ? "CPUID" : "measured",
+					  IsInvariant ? "invariant" : "NOT invariant, timings may drift");
+}
+
+u64
+PlatformGetCyclesPerSecond(void) {
+	return LinuxState.TscCyclesPerSecond;
+}
+
+f64
+PlatformGetNanosecondsPerCycle(void) {
+	return LinuxState.TscNanosecondsPerCycle;
+}
+
+// NOTE(ivan): Frame pacer. Frames are due at absolute deadlines one period apart, so a late wakeup
+// does not push every following frame back. The thread sleeps with clock_nanosleep(TIMER_ABSTIME)
+// until SleepMarginNs before the deadline, then spins on the TSC for the rest.
+// The margin follows how late the kernel actually wakes the thread up.
+#define FRAME_PACER_MIN_MARGIN_NS ((u64)50000)
+#define FRAME_PACER_MAX_MARGIN_NS ((u64)2000000)
+
+struct linux_frame_pacer {
+	u64 PeriodNs;
+	u64 DeadlineNs; // NOTE(ivan): CLOCK_MONOTONIC.
+	u64 SleepMarginNs;
+	f64 TscPerNs;
+
+	u64 LastFrameNs;
+	f64 FramesPerSecond; // NOTE(ivan): Of the last frame, sleep included.
+};
+
+static void
+LinuxInitializeFramePacer(linux_frame_pacer *Pacer, f64 FramesPerSecond) {
+	Assert(Pacer);
+	Assert(FramesPerSecond > 0.0);
+
+	Pacer->PeriodNs = (u64)(1000000000.0 / FramesPerSecond);
+	Pacer->SleepMarginNs = 500000;
+	Pacer->TscPerNs = 1.0 / PlatformGetNanosecondsPerCycle();
+
+	Pacer->LastFrameNs = LinuxGetNanoseconds();
+	Pacer->DeadlineNs = Pacer->LastFrameNs + Pacer->PeriodNs;
+	Pacer->FramesPerSecond = 0.0;
+}
+
+// NOTE(ivan): Returns false if the frame was already past its deadline.
+static b32
+LinuxWaitForNextFrame(linux_frame_pacer *Pacer) {
+	Assert(Pacer);
+
+	b32 Result = true;
+
+	u64 NowNs = LinuxGetNanoseconds();
+	if (NowNs < Pacer->DeadlineNs) {
+		if ((Pacer->DeadlineNs - NowNs) > Pacer->SleepMarginNs) {
+			u64 WakeNs = Pacer->DeadlineNs - Pacer->SleepMarginNs;
+
+			struct timespec Wake;
+			Wake.tv_sec = (time_t)(WakeNs / 1000000000ull);
+			Wake.tv_nsec = (long)(WakeNs % 1000000000ull);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Wake, 0) == EINTR) {}
+
+			// NOTE(ivan): Grow the margin right away if the wakeup was late, shrink it slowly otherwise.
+			NowNs = LinuxGetNanoseconds();
+			u64 LateNs = (NowNs > WakeNs) ? (NowNs - WakeNs) : 0;
+			u64 Margin = Pacer->SleepMarginNs - (Pacer->SleepMarginNs / 64);
+			Margin = Max(Margin, LateNs + (LateNs / 4));
+			Pacer->SleepMarginNs = Min(Max(Margin, FRAME_PACER_MIN_MARGIN_NS), FRAME_PACER_MAX_MARGIN_NS);
+		}
+
+		// NOTE(ivan): Spin tail, reading the TSC is much cheaper than reading the clock.
+		if (NowNs < Pacer->DeadlineNs) {
+			u64 DeadlineTsc = LinuxGetRDTSC() + (u64)((f64)(Pacer->DeadlineNs - NowNs) * Pacer->TscPerNs);
+			while (LinuxGetRDTSC() < DeadlineTsc)
+				YieldProcessor();
+		}
+
+		Pacer->DeadlineNs += Pacer->PeriodNs;
+	} else {
+		Result = false;
+
+		// NOTE(ivan): Missed by a whole period or more, start over from now instead of rushing frames to catch up.
+		if ((NowNs - Pacer->DeadlineNs) >= Pacer->PeriodNs)
+			Pacer->DeadlineNs = NowNs + Pacer->PeriodNs;
+		else
+			Pacer->DeadlineNs += Pacer->PeriodNs;
+	}
+
+	NowNs = LinuxGetNanoseconds();
+	Pacer->FramesPerSecond = 1000000000.0 / (f64)Max(NowNs - Pacer->LastFrameNs, (u64)1);
+	Pacer->LastFrameNs = NowNs;
+
+	return Result;
+}
+
 inline void
 LinuxProcessKeyboardOrMouseButton(game_input_button *Button, b32 IsDown) {
 	Assert(Button);
@@ -148,20 +407,409 @@ LinuxProcessXboxStickValue(s16 Value, s16 DeadZoneThreshold) {
 	return Result;
 }
 
-static b32
-LinuxMapXKeySymToKeyCode(KeySym XKeySym, key_code *OutCode) {
-	Assert(OutCode);
+// NOTE(ivan): Game controllers are read through evdev.
+// Every opened controller and an inotify descriptor watching /dev/input sit in one epoll set,
+// so a frame without controller activity costs a single epoll_wait() no matter how many are connected,
+// and plugged in or pulled out devices arrive as inotify events instead of being rescanned for.
+#define LINUX_CONTROLLER_HOTPLUG_TAG MAX_CONTROLLERS
+
+inline b32
+LinuxTestBit(const u8 *Bits, u32 Bit) {
+	Assert(Bits);
+	return (Bits[Bit / 8] >> (Bit % 8)) & 1;
+}
+
+// NOTE(ivan): Maps an axis value onto the signed 16-bit range, whatever range the device reports.
+inline s16
+LinuxNormalizeControllerAxis(struct input_absinfo *Axis, s32 Value) {
+	Assert(Axis);
+
+	if (Axis->maximum <= Axis->minimum)
+		return 0;
+
+	s64 Result = (((s64)Value - Axis->minimum) * 65535) / ((s64)Axis->maximum - Axis->minimum) - 32768;
+	if (Result < -32768)
+		Result = -32768;
+	else if (Result > 32767)
+		Result = 32767;
+
+	return (s16)Result;
+}
+
+inline u8
+LinuxNormalizeControllerTrigger(struct input_absinfo *Axis, s32 Value) {
+	Assert(Axis);
+
+	if (Axis->maximum <= Axis->minimum)
+		return 0;
+
+	s64 Result = (((s64)Value - Axis->minimum) * 255) / ((s64)Axis->maximum - Axis->minimum);
+	if (Result < 0)
+		Result = 0;
+	else if (Result > 255)
+		Result = 255;
+
+	return (u8)Result;
+}
+
+// NOTE(ivan): Buttons only change on actual transitions, so key repeats and state resyncs do not look like new presses.
+inline void
+LinuxUpdateControllerButton(game_input_button *Button, b32 IsDown) {
+	Assert(Button);
+
+	if (Button->IsDown != IsDown)
+		LinuxProcessXboxDigitalButton(Button, (s16)IsDown);
+}
+
+static void
+LinuxProcessControllerEvent(linux_controller *Controller, game_input_xbox_controller *Input, u16 Type, u16 Code, s32 Value) {
+	Assert(Controller);
+	Assert(Input);
+
+	if (Type == EV_KEY) {
+		game_input_button *Button = 0;
+		switch (Code) {
+		case BTN_A: {Button = &Input->A;} break;
+		case BTN_B: {Button = &Input->B;} break;
+		case BTN_X: {Button = &Input->X;} break;
+		case BTN_Y: {Button = &Input->Y;} break;
+		case BTN_START: {Button = &Input->Start;} break;
+		case BTN_SELECT: {Button = &Input->Back;} break;
+		case BTN_TL: {Button = &Input->LeftBumper;} break;
+		case BTN_TR: {Button = &Input->RightBumper;} break;
+		case BTN_THUMBL: {Button = &Input->LeftStick;} break;
+		case BTN_THUMBR: {Button = &Input->RightStick;} break;
+		case BTN_DPAD_UP: {Button = &Input->Up;} break;
+		case BTN_DPAD_DOWN: {Button = &Input->Down;} break;
+		case BTN_DPAD_LEFT: {Button = &Input->Left;} break;
+		case BTN_DPAD_RIGHT: {Button = &Input->Right;} break;
+		}
+
+		if (Button)
+			LinuxUpdateControllerButton(Button, Value != 0);
+	} else if ((Type == EV_ABS) && (Code < ABS_CNT)) {
+		struct input_absinfo *Axis = &Controller->Axes[Code];
+		Axis->value = Value;
+
+		// NOTE(ivan): evdev reports Y growing downwards, flip it to match XInput.
+		switch (Code) {
+		case ABS_X: {
+			Input->LeftStickPos.X = LinuxProcessXboxStickValue(LinuxNormalizeControllerAxis(Axis, Value), XBOX_CONTROLLER_DEADZONE);
+		} break;
+		case ABS_Y: {
+			Input->LeftStickPos.Y = -LinuxProcessXboxStickValue(LinuxNormalizeControllerAxis(Axis, Value), XBOX_CONTROLLER_DEADZONE);
+		} break;
+		case ABS_RX: {
+			Input->RightStickPos.X = LinuxProcessXboxStickValue(LinuxNormalizeControllerAxis(Axis, Value), XBOX_CONTROLLER_DEADZONE);
+		} break;
+		case ABS_RY: {
+			Input->RightStickPos.Y = -LinuxProcessXboxStickValue(LinuxNormalizeControllerAxis(Axis, Value), XBOX_CONTROLLER_DEADZONE);
+		} break;
+
+		case ABS_Z: {
+			Input->LeftTrigger = LinuxNormalizeControllerTrigger(Axis, Value);
+		} break;
+		case ABS_RZ: {
+			Input->RightTrigger = LinuxNormalizeControllerTrigger(Axis, Value);
+		} break;
+
+		case ABS_HAT0X: {
+			LinuxUpdateControllerButton(&Input->Left, Value < 0);
+			LinuxUpdateControllerButton(&Input->Right, Value > 0);
+		} break;
+		case ABS_HAT0Y: {
+			LinuxUpdateControllerButton(&Input->Up, Value < 0);
+			LinuxUpdateControllerButton(&Input->Down, Value > 0);
+		} break;
+		}
+	}
+}
+
+// NOTE(ivan): Reads the whole current state of a controller, on connection and after the kernel dropped events.
+static void
+LinuxSyncController(u32 Index) {
+	Assert(Index < MAX_CONTROLLERS);
+
+	linux_controller *Controller = &LinuxState.Controllers[Index];
+	game_input_xbox_controller *Input = &GameState.XboxControllers[Index];
+	Assert(Controller->IsUsed);
+
+	u8 KeyBits[(KEY_CNT + 7) / 8] = {};
+	if (ioctl(Controller->File, EVIOCGKEY(sizeof(KeyBits)), KeyBits) != -1) {
+		for (u32 Code = BTN_GAMEPAD; Code <= BTN_THUMBR; Code++)
+			LinuxProcessControllerEvent(Controller, Input, EV_KEY, (u16)Code, LinuxTestBit(KeyBits, Code));
+		for (u32 Code = BTN_DPAD_UP; Code <= BTN_DPAD_RIGHT; Code++)
+			LinuxProcessControllerEvent(Controller, Input, EV_KEY, (u16)Code, LinuxTestBit(KeyBits, Code));
+	}
+
+	for (u32 Code = 0; Code < ABS_CNT; Code++) {
+		if (LinuxTestBit(Controller->AxisBits, Code) &&
+			(ioctl(Controller->File, EVIOCGABS(Code), &Controller->Axes[Code]) != -1))
+			LinuxProcessControllerEvent(Controller, Input, EV_ABS, (u16)Code, Controller->Axes[Code].value);
+	}
+}
+
+static void
+LinuxOpenController(u32 EventNumber) {
+	// NOTE(ivan): Both the creation and the permission change of a device node come through, open it once.
+	u32 FreeIndex = MAX_CONTROLLERS;
+	for (u32 Index = 0; Index < MAX_CONTROLLERS; Index++) {
+		linux_controller *Controller = &LinuxState.Controllers[Index];
+		if (Controller->IsUsed && (Controller->EventNumber == EventNumber))
+			return;
+		if (!Controller->IsUsed && (FreeIndex == MAX_CONTROLLERS))
+			FreeIndex = Index;
+	}
+
+	char FileName[64];
+	snprintf(FileName, CountOf(FileName), "/dev/input/event%u", EventNumber);
+
+	// NOTE(ivan): Fails for devices we may not read, which is most of them but game controllers.
+	// A freshly plugged controller usually becomes readable a moment later, its IN_ATTRIB brings us back here.
+	s32 File = open(FileName, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (File == -1)
+		return;
+
+	u8 KeyBits[(KEY_CNT + 7) / 8] = {};
+	if ((ioctl(File, EVIOCGBIT(EV_KEY, sizeof(KeyBits)), KeyBits) == -1) || !LinuxTestBit(KeyBits, BTN_GAMEPAD)) {
+		close(File);
+		return;
+	}
+
+	char Name[128] = "Unknown";
+	ioctl(File, EVIOCGNAME(sizeof(Name) - 1), Name);
+
+	if (FreeIndex == MAX_CONTROLLERS) {
+		DEBUGPlatformOutf("No room for the game controller %s (%s)!", Name, FileName);
+		close(File);
+		return;
+	}
+
+	struct epoll_event Event = {};
+	Event.events = EPOLLIN;
+	Event.data.u32 = FreeIndex;
+	if (epoll_ctl(LinuxState.ControllerEpollFD, EPOLL_CTL_ADD, File, &Event) == -1) {
+		close(File);
+		return;
+	}
+
+	linux_controller *Controller = &LinuxState.Controllers[FreeIndex];
+	memset(Controller, 0, sizeof(*Controller));
+	Controller->IsUsed = true;
+	Controller->File = File;
+	Controller->EventNumber = EventNumber;
+	ioctl(File, EVIOCGBIT(EV_ABS, sizeof(Controller->AxisBits)), Controller->AxisBits);
+
+	memset(&GameState.XboxControllers[FreeIndex], 0, sizeof(GameState.XboxControllers[FreeIndex]));
+	GameState.XboxControllers[FreeIndex].IsConnected = true;
+	LinuxSyncController(FreeIndex);
+
+	DEBUGPlatformOutf("Game controller %u connected: %s (%s)", FreeIndex, Name, FileName);
+}
+
+static void
+LinuxCloseController(u32 Index) {
+	Assert(Index < MAX_CONTROLLERS);
 
-	key_code KeyCode;
-	b32 KeyFound = false;
-#define KeyMap(MapXKeyCode, MapKeyCode)				\
-	if (XKeySym == MapXKeyCode) {					\
-		KeyCode = MapKeyCode;						\
-		KeyFound = true;							\
+	linux_controller *Controller = &LinuxState.Controllers[Index];
+	Assert(Controller->IsUsed);
+
+	epoll_ctl(LinuxState.ControllerEpollFD, EPOLL_CTL_DEL, Controller->File, 0);
+	close(Controller->File);
+	Controller->IsUsed = false;
+
+	memset(&GameState.XboxControllers[Index], 0, sizeof(GameState.XboxControllers[Index]));
+
+	DEBUGPlatformOutf("Game controller %u disconnected.", Index);
+}
+
+// NOTE(ivan): Returns the N of "eventN", -1 for any other device node name.
+inline s32
+LinuxParseEventDeviceName(const char *Name) {
+	Assert(Name);
+
+	if (strncmp(Name, "event", 5) != 0)
+		return -1;
+
+	const char *At = Name + 5;
+	if (!*At)
+		return -1;
+
+	s32 Result = 0;
+	for (; *At; At++) {
+		if ((*At < '0') || (*At > '9') || (Result > 100000))
+			return -1;
+		Result = (Result * 10) + (*At - '0');
+	}
+
+	return Result;
+}
+
+static void
+LinuxReadController(u32 Index) {
+	Assert(Index < MAX_CONTROLLERS);
+
+	linux_controller *Controller = &LinuxState.Controllers[Index];
+	game_input_xbox_controller *Input = &GameState.XboxControllers[Index];
+
+	struct input_event Events[64];
+	for (;;) {
+		ssize_t BytesRead = read(Controller->File, Events, sizeof(Events));
+		if (BytesRead <= 0) {
+			// NOTE(ivan): The device is gone, usually noticed here before inotify tells.
+			if ((BytesRead == -1) && (errno == ENODEV))
+				LinuxCloseController(Index);
+			break;
+		}
+
+		u32 Count = (u32)(BytesRead / sizeof(struct input_event));
+		for (u32 EventIndex = 0; EventIndex < Count; EventIndex++) {
+			struct input_event *Event = &Events[EventIndex];
+			if (Event->type == EV_SYN) {
+				if (Event->code == SYN_DROPPED) {
+					Controller->IsDropped = true;
+				} else if ((Event->code == SYN_REPORT) && Controller->IsDropped) {
+					Controller->IsDropped = false;
+					LinuxSyncController(Index);
+				}
+			} else if (!Controller->IsDropped) {
+				LinuxProcessControllerEvent(Controller, Input, Event->type, Event->code, Event->value);
+			}
+		}
+
+		// NOTE(ivan): A short read means the queue is empty, no need to hear it from EAGAIN.
+		if ((uptr)BytesRead < sizeof(Events))
+			break;
+	}
+}
+
+static void
+LinuxProcessControllerHotplug(void) {
+	alignas(struct inotify_event) u8 Buffer[4096];
+	for (;;) {
+		ssize_t BytesRead = read(LinuxState.ControllerINotifyFD, Buffer, sizeof(Buffer));
+		if (BytesRead <= 0)
+			break;
+
+		for (u8 *At = Buffer; At < (Buffer + BytesRead);) {
+			struct inotify_event *Event = (struct inotify_event *)At;
+			s32 EventNumber = Event->len ? LinuxParseEventDeviceName(Event->name) : -1;
+			if (EventNumber != -1) {
+				if (Event->mask & IN_DELETE) {
+					for (u32 Index = 0; Index < MAX_CONTROLLERS; Index++) {
+						linux_controller *Controller = &LinuxState.Controllers[Index];
+						if (Controller->IsUsed && (Controller->EventNumber == (u32)EventNumber))
+							LinuxCloseController(Index);
+					}
+				} else {
+					LinuxOpenController((u32)EventNumber);
+				}
+			}
+
+			At += sizeof(struct inotify_event) + Event->len;
+		}
+	}
+}
+
+static void
+LinuxInitializeControllers(void) {
+	static_assert(MAX_CONTROLLERS == CountOf(GameState.XboxControllers), "Controller slots do not match game_state!");
+
+	LinuxState.ControllerINotifyFD = -1;
+	LinuxState.ControllerEpollFD = epoll_create1(EPOLL_CLOEXEC);
+	if (LinuxState.ControllerEpollFD == -1) {
+		DEBUGPlatformOutf("epoll is not available, game controllers disabled.");
+		return;
+	}
+
+	// NOTE(ivan): Hotplug is not critical, controllers present at startup work without it.
+	LinuxState.ControllerINotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (LinuxState.ControllerINotifyFD != -1) {
+		struct epoll_event Event = {};
+		Event.events = EPOLLIN;
+		Event.data.u32 = LINUX_CONTROLLER_HOTPLUG_TAG;
+		if ((inotify_add_watch(LinuxState.ControllerINotifyFD, "/dev/input", IN_CREATE | IN_ATTRIB | IN_DELETE) == -1) ||
+			(epoll_ctl(LinuxState.ControllerEpollFD, EPOLL_CTL_ADD, LinuxState.ControllerINotifyFD, &Event) == -1)) {
+			close(LinuxState.ControllerINotifyFD);
+			LinuxState.ControllerINotifyFD = -1;
+		}
+	}
+	if (LinuxState.ControllerINotifyFD == -1)
+		DEBUGPlatformOutf("Cannot watch /dev/input, game controller hotplug disabled.");
+
+	// NOTE(ivan): The one and only scan, everything after comes through hotplug.
+	DIR *Dir = opendir("/dev/input");
+	if (Dir) {
+		struct dirent *Entry;
+		while ((Entry = readdir(Dir)) != 0) {
+			s32 EventNumber = LinuxParseEventDeviceName(Entry->d_name);
+			if (EventNumber != -1)
+				LinuxOpenController((u32)EventNumber);
+		}
+
+		closedir(Dir);
+	}
+}
+
+// NOTE(ivan): Drains whatever the controllers and hotplug have queued since the last frame.
+static void
+LinuxProcessControllers(void) {
+	if (LinuxState.ControllerEpollFD == -1)
+		return;
+
+	struct epoll_event Events[MAX_CONTROLLERS + 1];
+	s32 Count = epoll_wait(LinuxState.ControllerEpollFD, Events, CountOf(Events), 0);
+	for (s32 Index = 0; Index < Count; Index++) {
+		u32 Tag = Events[Index].data.u32;
+		if (Tag == LINUX_CONTROLLER_HOTPLUG_TAG)
+			LinuxProcessControllerHotplug();
+		else if (LinuxState.Controllers[Tag].IsUsed)
+			LinuxReadController(Tag);
+	}
+}
+
+static void
+LinuxShutdownControllers(void) {
+	if (LinuxState.ControllerEpollFD == -1)
+		return;
+
+	for (u32 Index = 0; Index < MAX_CONTROLLERS; Index++) {
+		if (LinuxState.Controllers[Index].IsUsed)
+			LinuxCloseController(Index);
 	}
+
+	if (LinuxState.ControllerINotifyFD != -1)
+		close(LinuxState.ControllerINotifyFD);
+	close(LinuxState.ControllerEpollFD);
+	LinuxState.ControllerEpollFD = -1;
+}
+
+// NOTE(ivan): Keysym to key code lookup table, filled once at startup.
+// Every keysym we map is either a Latin-1 one (0x00XX) or a function and keypad one (0xFFXX),
+// so the low byte plus one bit telling the two ranges apart indexes the table directly.
+// Entries hold the key code plus one, zero means the keysym is not mapped.
+static u8 LinuxKeyCodeTable[512];
+static_assert(KeyCode_MaxCount < 0xFF, "Key codes do not fit the lookup table!");
+
+inline s32
+LinuxGetKeyCodeTableIndex(KeySym XKeySym) {
+	if (XKeySym <= 0xFF)
+		return (s32)XKeySym;
+	if ((XKeySym & ~(KeySym)0xFF) == 0xFF00)
+		return 0x100 | (s32)(XKeySym & 0xFF);
+
+	return -1;
+}
+
+static void
+LinuxInitializeKeyCodeTable(void) {
+#define KeyMap(MapXKeyCode, MapKeyCode)									\
+	Assert(LinuxGetKeyCodeTableIndex(MapXKeyCode) != -1);				\
+	LinuxKeyCodeTable[LinuxGetKeyCodeTableIndex(MapXKeyCode)] = (u8)(MapKeyCode + 1);
 	KeyMap(XK_Return, KeyCode_Enter);
 	KeyMap(XK_Tab, KeyCode_Tab);
 	KeyMap(XK_Escape, KeyCode_Escape);
+	KeyMap(XK_space, KeyCode_Space);
 	KeyMap(XK_KP_Space, KeyCode_Space);
 	KeyMap(XK_BackSpace, KeyCode_BackSpace);
 	KeyMap(XK_Shift_L, KeyCode_LeftShift);
@@ -172,7 +820,7 @@ LinuxMapXKeySymToKeyCode(KeySym XKeySym, key_code *OutCode) {
 	KeyMap(XK_Control_R, KeyCode_RightControl);
 	KeyMap(XK_Super_L, KeyCode_LeftSuper);
 	KeyMap(XK_Super_R, KeyCode_RightSuper);
-  	KeyMap(XK_Home, KeyCode_Home);
+	KeyMap(XK_Home, KeyCode_Home);
 	KeyMap(XK_End, KeyCode_End);
 	KeyMap(XK_Prior, KeyCode_PageUp);
 	KeyMap(XK_Next, KeyCode_PageDown);
@@ -243,12 +891,15 @@ LinuxMapXKeySymToKeyCode(KeySym XKeySym, key_code *OutCode) {
 	KeyMap(XK_bracketleft, KeyCode_OpenBracket);
 	KeyMap(XK_bracketright, KeyCode_CloseBracket);
 	KeyMap(XK_semicolon, KeyCode_Semicolon);
+	KeyMap(XK_apostrophe, KeyCode_Quote);
 	KeyMap(XK_quotedbl, KeyCode_Quote);
 	KeyMap(XK_comma, KeyCode_Comma);
 	KeyMap(XK_period, KeyCode_Period);
 	KeyMap(XK_slash, KeyCode_Slash);
 	KeyMap(XK_backslash, KeyCode_BackSlash);
+	KeyMap(XK_grave, KeyCode_Tilde);
 	KeyMap(XK_asciitilde, KeyCode_Tilde);
+	KeyMap(XK_equal, KeyCode_Plus);
 	KeyMap(XK_plus, KeyCode_Plus);
 	KeyMap(XK_minus, KeyCode_Minus);
 
@@ -260,6 +911,9 @@ LinuxMapXKeySymToKeyCode(KeySym XKeySym, key_code *OutCode) {
 	KeyMap(XK_KP_End, KeyCode_NumEnd);
 	KeyMap(XK_KP_Prior, KeyCode_NumPageUp);
 	KeyMap(XK_KP_Next, KeyCode_NumPageDown);
+	KeyMap(XK_KP_Insert, KeyCode_NumInsert);
+	KeyMap(XK_KP_Delete, KeyCode_NumDelete);
+	KeyMap(XK_KP_Enter, KeyCode_NumEnter);
 
 	KeyMap(XK_KP_0, KeyCode_Num0);
 	KeyMap(XK_KP_1, KeyCode_Num1);
@@ -277,23 +931,18 @@ LinuxMapXKeySymToKeyCode(KeySym XKeySym, key_code *OutCode) {
 	KeyMap(XK_KP_Add, KeyCode_NumPlus);
 	KeyMap(XK_KP_Subtract, KeyCode_NumMinus);
 	KeyMap(XK_KP_Separator, KeyCode_NumClear);
-#undef KeyMap	
-
-	if (!KeyFound)
-		return false;
-	*OutCode = KeyCode;
-	return true;
+#undef KeyMap
 }
 
 inline b32
-LinuxDirectoryExists(const char *DirName) {
-	Assert(DirName);
+LinuxMapXKeySymToKeyCode(KeySym XKeySym, key_code *OutCode) {
+	Assert(OutCode);
 
-	DIR *Dir = opendir(DirName);
-	if (!Dir)
+	s32 Index = LinuxGetKeyCodeTableIndex(XKeySym);
+	if ((Index == -1) || !LinuxKeyCodeTable[Index])
 		return false;
 
-	closedir(Dir);
+	*OutCode = (key_code)(LinuxKeyCodeTable[Index] - 1);
 	return true;
 }
 
@@ -361,6 +1010,48 @@ LinuxResizeVideoBuffer(linux_video_buffer *Buffer, s32 NewWidth, s32 NewHeight)
 	}
 }
 
+// NOTE(ivan): Copies the game-side pixels into the shared image and asks the X server to put it on the window.
+static void
+LinuxDisplayVideoBuffer(linux_video_buffer *Buffer, Window W, GC WindowGC) {
+	Assert(Buffer);
+
+	if (!Buffer->Image || !Buffer->Pixels)
+		return;
+
+	// NOTE(ivan): The shared image rows may be padded, so copy row by row.
+	u8 *Dest = (u8 *)Buffer->Image->data;
+	u8 *Source = (u8 *)Buffer->Pixels;
+	for (s32 Y = 0; Y < Buffer->Height; Y++) {
+		CopyBytes(Dest, Source, Buffer->Width * Buffer->BytesPerPixel);
+		Dest += Buffer->Image->bytes_per_line;
+		Source += Buffer->Pitch;
+	}
+
+	XShmPutImage(LinuxState.XDisplay,
+				 W, WindowGC,
+				 Buffer->Image,
+				 0, 0, 0, 0,
+				 Buffer->Width, Buffer->Height,
+				 False);
+	XFlush(LinuxState.XDisplay);
+}
+
+struct linux_window_present {
+	linux_video_buffer *Buffer;
+	Window W;
+	GC WindowGC;
+};
+
+static void
+LinuxPresentToWindow(void *Data, game_video_buffer *Buffer, u64 Frame) {
+	Assert(Data);
+	UnusedParam(Buffer);
+	UnusedParam(Frame);
+
+	linux_window_present *Present = (linux_window_present *)Data;
+	LinuxDisplayVideoBuffer(Present->Buffer, Present->W, Present->WindowGC);
+}
+
 static Cursor
 LinuxCreateNullCursor(void) {
 	Pixmap CursorMask = XCreatePixmap(LinuxState.XDisplay,
@@ -462,7 +1153,7 @@ PlatformWriteEntireFile(const char *FileName, void *Base, uptr Size) {
 
 	b32 Result = false;
 
-	s32 File = open(FileName, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+	s32 File = open(FileName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
 	if (File != -1) {
 		ssize_t Written = write(File, Base, Size);
 		if (fsync(File) >= 0)
@@ -483,44 +1174,1542 @@ PlatformFreeEntireFilePiece(piece *Piece) {
 	Piece->Size = 0;
 }
 
-#if INTERNAL
-#if SLOWCODE
-void
-DEBUGPlatformOutf(const char *Format, ...) {
-	Assert(Format);
-	
-	// TODO(ivan): Get rid of using CRT's va routines.
-	va_list ArgsList;
-	va_start(ArgsList, Format);
-	
-	printf("## ");
-	vprintf(Format, ArgsList);
-	printf("\n");
-	
-	va_end(ArgsList);
+piece
+PlatformMapEntireFile(const char *FileName) {
+	Assert(FileName);
+
+	piece Result = {};
+
+	s32 File = open(FileName, O_RDONLY);
+	if (File != -1) {
+		struct stat FileStat;
+		if ((fstat(File, &FileStat) == 0) && (FileStat.st_size > 0)) {
+			void *Base = mmap(0, FileStat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+			if (Base != MAP_FAILED) {
+				// NOTE(ivan): Mapped files are read through at random, ask the kernel to start paging them in now.
+				madvise(Base, FileStat.st_size, MADV_WILLNEED);
+
+				Result.Base = (u8 *)Base;
+				Result.Size = FileStat.st_size;
+			}
+		}
+
+		// NOTE(ivan): The mapping holds its own reference to the file.
+		close(File);
+	}
+
+	return Result;
 }
 
 void
-DEBUGPlatformOutFailedAssertion(const char *SrcFile,
-								u32 SrcLine,
-								const char *SrcExpr) {
-	Assert(SrcFile);
-	Assert(SrcExpr);
+PlatformUnmapEntireFile(piece *Piece) {
+	Assert(Piece);
+	Assert(Piece->Base);
 
-	DEBUGPlatformOutf("*** ASSERTION FAILED ***");
-	DEBUGPlatformOutf("[SrcFile] %s", SrcFile);
-	DEBUGPlatformOutf("[SrcLine] %d", SrcLine);
-	DEBUGPlatformOutf("[SrcExpr] %s", SrcExpr);
+	munmap(Piece->Base, Piece->Size);
+	Piece->Base = 0;
+	Piece->Size = 0;
 }
-#endif // #if SLOWCODE
-#endif // #if INTERNAL
 
-int
-main(int ArgC, char **ArgV) {
-	DEBUGPlatformOutf("Starting " GAMENAME "...");
+static b32
+LinuxEnumerateFiles(const char *DirName, char *RelativeName, uptr RelativeLength,
+					platform_enumerate_files_callback *Callback, void *Param) {
+	char FullName[PATH_MAX];
+	if (RelativeLength)
+		snprintf(FullName, CountOf(FullName), "%s/%s", DirName, RelativeName);
+	else
+		snprintf(FullName, CountOf(FullName), "%s", DirName);
+
+	DIR *Dir = opendir(FullName);
+	if (!Dir)
+		return false;
 
-	LinuxState.ArgC = ArgC;
+	struct dirent *Entry;
+	while ((Entry = readdir(Dir)) != 0) {
+		if (AreStringsEqual(Entry->d_name, ".") || AreStringsEqual(Entry->d_name, ".."))
+			continue;
+
+		uptr NameLength = strlen(Entry->d_name);
+		if ((RelativeLength + NameLength + 2) > PATH_MAX)
+			continue;
+
+		uptr NewLength = RelativeLength;
+		if (NewLength)
+			RelativeName[NewLength++] = '/';
+		CopyStringN(RelativeName + NewLength, Entry->d_name, NameLength);
+		NewLength += NameLength;
+
+		char EntryName[PATH_MAX];
+		snprintf(EntryName, CountOf(EntryName), "%s/%s", DirName, RelativeName);
+
+		struct stat EntryStat;
+		if (stat(EntryName, &EntryStat) == 0) {
+			if (S_ISDIR(EntryStat.st_mode))
+				LinuxEnumerateFiles(DirName, RelativeName, NewLength, Callback, Param);
+			else if (S_ISREG(EntryStat.st_mode))
+				Callback(RelativeName, EntryStat.st_size, Param);
+		}
+
+		RelativeName[RelativeLength] = 0;
+	}
+
+	closedir(Dir);
+	return true;
+}
+
+b32
+PlatformEnumerateFiles(const char *DirName, platform_enumerate_files_callback *Callback, void *Param) {
+	Assert(DirName);
+	Assert(Callback);
+
+	char RelativeName[PATH_MAX] = {};
+	return LinuxEnumerateFiles(DirName, RelativeName, 0, Callback, Param);
+}
+
+void
+PlatformWaitOnAddress(volatile u32 *Address, u32 Expected) {
+	Assert(Address);
+
+	// NOTE(ivan): Private futex, the address is never shared with another process.
+	syscall(SYS_futex, (u32 *)Address, FUTEX_WAIT_PRIVATE, Expected, 0, 0, 0);
+}
+
+void
+PlatformWakeAllOnAddress(volatile u32 *Address) {
+	Assert(Address);
+	syscall(SYS_futex, (u32 *)Address, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+}
+
+static void *
+LinuxWorkerThreadProc(void *Param) {
+	LinuxJobWorkerIndex = (s32)(uptr)Param;
+	InitializeThreadState(&GameTLState, LinuxJobWorkerIndex,
+						  LinuxState.ThreadMemory + ((uptr)LinuxJobWorkerIndex * THREAD_MEMORY_SIZE));
+
+	job_system *System = &LinuxState.Jobs;
+	job_worker *Worker = &System->Workers[LinuxJobWorkerIndex];
+	while (!LinuxState.AreWorkersQuitting) {
+		job Job;
+		if (GetNextJob(System, LinuxJobWorkerIndex, &Job)) {
+			RunJob(System, LinuxJobWorkerIndex, &Job);
+			continue;
+		}
+
+		// NOTE(ivan): New jobs often come right away, spin for a while before going to sleep.
+		u64 IdleStart = __rdtsc();
+		b32 IsFound = false;
+		for (u32 Spin = 0; !IsFound && (Spin < JOB_IDLE_SPIN_COUNT); Spin++) {
+			YieldProcessor();
+			IsFound = GetNextJob(System, LinuxJobWorkerIndex, &Job);
+		}
+
+		if (!IsFound) {
+			// NOTE(ivan): Announce the sleep before the last look, see GetJobWakeCount().
+			AtomicIncrementU32(&System->SleepingCount);
+			IsFound = GetNextJob(System, LinuxJobWorkerIndex, &Job);
+			if (!IsFound) {
+				Worker->Stats.SleepCount++;
+				while ((sem_wait(&LinuxState.WorkSemaphore) == -1) && (errno == EINTR)) {}
+			}
+			AtomicDecrementU32(&System->SleepingCount);
+		}
+
+		Worker->Stats.IdleCycles += (__rdtsc() - IdleStart);
+		if (IsFound)
+			RunJob(System, LinuxJobWorkerIndex, &Job);
+	}
+
+	return 0;
+}
+
+inline void
+LinuxWakeWorkers(u32 JobCount) {
+	u32 WakeCount = GetJobWakeCount(&LinuxState.Jobs, JobCount);
+	for (u32 Index = 0; Index < WakeCount; Index++)
+		sem_post(&LinuxState.WorkSemaphore);
+}
+
+// NOTE(ivan): Reads a small text file such as the ones in /sys or /proc, those report bogus sizes so they cannot be mapped.
+static b32
+LinuxReadSmallFile(const char *FileName, char *Buffer, uptr BufferSize) {
+	Assert(FileName);
+	Assert(Buffer);
+	Assert(BufferSize);
+
+	b32 Result = false;
+
+	s32 File = open(FileName, O_RDONLY);
+	if (File != -1) {
+		ssize_t BytesRead = read(File, Buffer, BufferSize - 1);
+		if (BytesRead >= 0) {
+			Buffer[BytesRead] = 0;
+			Result = true;
+		}
+		close(File);
+	}
+
+	return Result;
+}
+
+static void
+LinuxDetectCpuLayout(cpu_layout *Layout) {
+	Assert(Layout);
+
+	*Layout = {};
+
+	char Buffer[1024];
+	if (!LinuxReadSmallFile("/sys/devices/system/cpu/online", Buffer, sizeof(Buffer)) || !ParseCpuList(Buffer, Layout->IsAllowed)) {
+		s32 CpuCount = Min((s32)sysconf(_SC_NPROCESSORS_ONLN), (s32)MAX_CPUS);
+		for (s32 Cpu = 0; Cpu < CpuCount; Cpu++)
+			Layout->IsAllowed[Cpu] = true;
+	}
+
+	// NOTE(ivan): Respect whatever the process was started with (taskset, cgroups).
+	cpu_set_t ProcessSet;
+	if (sched_getaffinity(0, sizeof(ProcessSet), &ProcessSet) == 0) {
+		for (u32 Cpu = 0; Cpu < MAX_CPUS; Cpu++) {
+			if (!CPU_ISSET(Cpu, &ProcessSet))
+				Layout->IsAllowed[Cpu] = false;
+		}
+	}
+
+	// NOTE(ivan): Isolation lists, "-cpus" keeps only the listed CPUs, "-excludecpus" leaves the listed ones alone.
+	const char *ParamCpus = PlatformCheckParamValue("-cpus");
+	if (ParamCpus) {
+		u8 Listed[MAX_CPUS] = {};
+		if (ParseCpuList(ParamCpus, Listed)) {
+			for (u32 Cpu = 0; Cpu < MAX_CPUS; Cpu++)
+				Layout->IsAllowed[Cpu] = Layout->IsAllowed[Cpu] && Listed[Cpu];
+		} else {
+			DEBUGPlatformOutf("Malformed -cpus list ignored: %s", ParamCpus);
+		}
+	}
+	const char *ParamExcludeCpus = PlatformCheckParamValue("-excludecpus");
+	if (ParamExcludeCpus) {
+		u8 Listed[MAX_CPUS] = {};
+		if (ParseCpuList(ParamExcludeCpus, Listed)) {
+			for (u32 Cpu = 0; Cpu < MAX_CPUS; Cpu++)
+				Layout->IsAllowed[Cpu] = Layout->IsAllowed[Cpu] && !Listed[Cpu];
+		} else {
+			DEBUGPlatformOutf("Malformed -excludecpus list ignored: %s", ParamExcludeCpus);
+		}
+	}
+
+	// NOTE(ivan): Every allowed CPU not seen as a sibling yet starts a new core.
+	u8 IsTaken[MAX_CPUS] = {};
+	for (u32 Cpu = 0; Cpu < MAX_CPUS; Cpu++) {
+		if (!Layout->IsAllowed[Cpu])
+			continue;
+
+		Layout->CpuCount++;
+		if (IsTaken[Cpu])
+			continue;
+
+		Layout->CoreCpus[Layout->CoreCount++] = (u16)Cpu;
+		IsTaken[Cpu] = true;
+
+		char SiblingsName[128];
+		snprintf(SiblingsName, CountOf(SiblingsName), "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", Cpu);
+		if (LinuxReadSmallFile(SiblingsName, Buffer, sizeof(Buffer)))
+			ParseCpuList(Buffer, IsTaken);
+	}
+}
+
+// NOTE(ivan): Pins a thread of the job system, or the render thread, to its own core,
+// or keeps it inside the allowed CPUs if it has none.
+static void
+LinuxSetThreadAffinity(pthread_t Thread, u32 ThreadIndex, const char *ThreadName) {
+	cpu_layout *Layout = &LinuxState.CpuLayout;
+
+	cpu_set_t Set;
+	CPU_ZERO(&Set);
+
+	s32 Cpu = GetThreadCpu(Layout, ThreadIndex);
+	if (Cpu != -1) {
+		CPU_SET(Cpu, &Set);
+	} else {
+		for (u32 Index = 0; Index < MAX_CPUS; Index++) {
+			if (Layout->IsAllowed[Index])
+				CPU_SET(Index, &Set);
+		}
+	}
+
+	if (pthread_setaffinity_np(Thread, sizeof(Set), &Set) == 0) {
+		if (Cpu != -1)
+			DEBUGPlatformOutf("Thread %u (%s) pinned to CPU %d.", ThreadIndex, ThreadName, Cpu);
+		else
+			DEBUGPlatformOutf("Thread %u (%s) has no core of its own, runs on any allowed CPU.", ThreadIndex, ThreadName);
+	} else {
+		DEBUGPlatformOutf("Thread %u (%s) could not be pinned.", ThreadIndex, ThreadName);
+	}
+}
+
+static void
+LinuxStartWorkers(void) {
+	InitializeJobSystem(&LinuxState.Jobs);
+	LinuxJobWorkerIndex = 0; // NOTE(ivan): Primary thread.
+
+	LinuxDetectCpuLayout(&LinuxState.CpuLayout);
+	LinuxState.IsAffinityEnabled = ((PlatformCheckParam("-noaffinity") == PARAM_MISSING) && LinuxState.CpuLayout.CoreCount);
+	DEBUGPlatformOutf("CPU layout: %u logical CPUs allowed, %u physical cores, affinity %s.",
+					  LinuxState.CpuLayout.CpuCount, LinuxState.CpuLayout.CoreCount,
+					  LinuxState.IsAffinityEnabled ? "on" : "off");
+
+	// NOTE(ivan): One thread per physical core, the primary thread takes one of them and the render thread another.
+	s32 OtherThreadCount = LinuxState.Renderer.IsPipelined ? 2 : 1;
+	s32 WorkerCount = (s32)sysconf(_SC_NPROCESSORS_ONLN) - OtherThreadCount;
+	if (LinuxState.CpuLayout.CoreCount)
+		WorkerCount = (s32)LinuxState.CpuLayout.CoreCount - OtherThreadCount;
+	const char *ParamWorkers = PlatformCheckParamValue("-workers");
+	if (ParamWorkers)
+		WorkerCount = atoi(ParamWorkers);
+	WorkerCount = Min(Max(WorkerCount, 0), (s32)MAX_WORKER_THREADS);
+
+	// NOTE(ivan): Thread memory of all threads in one go, pages are only touched when used.
+	LinuxState.ThreadMemorySize = (uptr)(WorkerCount + 1) * THREAD_MEMORY_SIZE;
+	LinuxState.ThreadMemory = (u8 *)mmap(0, LinuxState.ThreadMemorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (LinuxState.ThreadMemory == MAP_FAILED) {
+		LinuxState.ThreadMemory = 0;
+		LinuxState.ThreadMemorySize = 0;
+	}
+
+	InitializeThreadState(&GameTLState, 0, LinuxState.ThreadMemory);
+	GameState.ThreadCount = 1;
+	GameState.ProfileRings[0] = GameTLState.ProfileRing;
+
+	if (LinuxState.IsAffinityEnabled)
+		LinuxSetThreadAffinity(pthread_self(), 0, "Main");
+
+	if (!LinuxState.ThreadMemory) {
+		DEBUGPlatformOutf("Could not allocate thread memory, running without worker threads.");
+		return;
+	}
+	if (sem_init(&LinuxState.WorkSemaphore, 0, 0) == -1) {
+		DEBUGPlatformOutf("sem_init() failed, running without worker threads.");
+		return;
+	}
+
+	// NOTE(ivan): Rings are published before the workers exist, the workers set them up themselves.
+	for (s32 Index = 1; Index <= WorkerCount; Index++)
+		GameState.ProfileRings[Index] = (profile_ring *)(LinuxState.ThreadMemory + ((uptr)Index * THREAD_MEMORY_SIZE));
+
+	// NOTE(ivan): Thieves look at every deque up to ThreadCount, set it before any worker runs.
+	LinuxState.Jobs.ThreadCount = (u32)WorkerCount + 1;
+	for (s32 Index = 0; Index < WorkerCount; Index++) {
+		pthread_t Thread;
+		if (pthread_create(&Thread, 0, LinuxWorkerThreadProc, (void *)(uptr)(Index + 1)) != 0)
+			break;
+
+		char ThreadName[16];
+		snprintf(ThreadName, CountOf(ThreadName), "Worker %d", Index + 1);
+		pthread_setname_np(Thread, ThreadName);
+		if (LinuxState.IsAffinityEnabled)
+			LinuxSetThreadAffinity(Thread, Index + 1, ThreadName);
+
+		LinuxState.Workers[LinuxState.WorkerCount++] = Thread;
+	}
+	LinuxState.Jobs.ThreadCount = LinuxState.WorkerCount + 1;
+	GameState.ThreadCount = LinuxState.Jobs.ThreadCount;
+
+	DEBUGPlatformOutf("Worker threads: %u", LinuxState.WorkerCount);
+}
+
+static void
+LinuxStopWorkers(void) {
+	PlatformCompleteAllWork();
+
+	LinuxState.AreWorkersQuitting = true;
+	for (u32 Index = 0; Index < LinuxState.WorkerCount; Index++)
+		sem_post(&LinuxState.WorkSemaphore);
+	for (u32 Index = 0; Index < LinuxState.WorkerCount; Index++)
+		pthread_join(LinuxState.Workers[Index], 0);
+
+#if INTERNAL
+	for (u32 Index = 0; Index < LinuxState.Jobs.ThreadCount; Index++) {
+		job_worker_stats *Stats = &LinuxState.Jobs.Workers[Index].Stats;
+		DEBUGPlatformOutf("Jobs thread %u: executed %llu, stolen %llu/%llu, idle %.1fms, slept %llu times",
+						  Index, Stats->JobsExecuted, Stats->JobsStolen, Stats->StealAttempts,
+						  CyclesToNanoseconds(Stats->IdleCycles) / 1000000.0, Stats->SleepCount);
+	}
+	DEBUGOutputTicketMutexStats("debug output", &LinuxState.DebugOutputMutex);
+#endif
+
+	LinuxState.WorkerCount = 0;
+	LinuxState.Jobs.ThreadCount = 1;
+	sem_destroy(&LinuxState.WorkSemaphore);
+
+	GameState.ThreadCount = 0;
+	GameTLState.ProfileRing = 0;
+	GameTLState.ScratchHeap = {};
+	if (LinuxState.ThreadMemory)
+		munmap(LinuxState.ThreadMemory, LinuxState.ThreadMemorySize);
+	LinuxState.ThreadMemory = 0;
+}
+
+void
+PlatformAddWorkQueueEntry(platform_work_queue_callback *Callback, void *Data) {
+	Assert(Callback);
+
+	job Job;
+	Job.Callback = Callback;
+	Job.Data = Data;
+	Job.Counter = &LinuxState.Jobs.AllWork;
+
+	// NOTE(ivan): Counted before it is visible, so PlatformCompleteAllWork() can never see it done too early.
+	AtomicIncrementU32(&LinuxState.Jobs.AllWork.Value);
+
+	// NOTE(ivan): The ring is full, help draining it instead of blocking.
+	while (!PushWorkQueueEntry(&LinuxState.Jobs.Queue, &Job)) {
+		job OtherJob;
+		if (GetNextJob(&LinuxState.Jobs, LinuxJobWorkerIndex, &OtherJob))
+			RunJob(&LinuxState.Jobs, LinuxJobWorkerIndex, &OtherJob);
+		else
+			YieldProcessor();
+	}
+
+	LinuxWakeWorkers(1);
+}
+
+void
+PlatformCompleteAllWork(void) {
+	WaitForJobCounter(&LinuxState.Jobs, LinuxJobWorkerIndex, &LinuxState.Jobs.AllWork);
+}
+
+u32
+PlatformGetWorkerCount(void) {
+	return LinuxState.WorkerCount;
+}
+
+void
+PlatformRunJobs(job *Jobs, u32 Count, job_counter *Counter) {
+	Assert(Jobs);
+	Assert(Counter);
+
+	AtomicAddU32(&Counter->Value, Count);
+	for (u32 Index = 0; Index < Count; Index++) {
+		Jobs[Index].Counter = Counter;
+		PushJob(&LinuxState.Jobs, LinuxJobWorkerIndex, &Jobs[Index]);
+	}
+
+	LinuxWakeWorkers(Count);
+}
+
+void
+PlatformWaitForCounter(job_counter *Counter) {
+	Assert(Counter);
+	WaitForJobCounter(&LinuxState.Jobs, LinuxJobWorkerIndex, Counter);
+}
+
+u32
+PlatformGetJobStats(job_worker_stats *Stats, u32 MaxCount) {
+	Assert(Stats);
+
+	u32 Result = Min(MaxCount, LinuxState.Jobs.ThreadCount);
+	for (u32 Index = 0; Index < Result; Index++)
+		Stats[Index] = LinuxState.Jobs.Workers[Index].Stats;
+
+	return Result;
+}
+
+s32
+PlatformWatchFile(const char *FileName) {
+	Assert(FileName);
+
+	if (LinuxState.INotifyFD == -1)
+		return FILE_WATCH_INVALID;
+
+	char DirName[2048] = ".";
+	const char *BaseName = FileName;
+	const char *LastSlash = strrchr(FileName, '/');
+	if (LastSlash) {
+		uptr DirNameLength = Min((uptr)(LastSlash - FileName), (uptr)CountOf(DirName) - 1);
+		memcpy(DirName, FileName, DirNameLength);
+		DirName[DirNameLength] = 0;
+		BaseName = LastSlash + 1;
+	}
+
+	for (s32 Index = 0; Index < (s32)CountOf(LinuxState.WatchedFiles); Index++) {
+		linux_watched_file *File = &LinuxState.WatchedFiles[Index];
+		if (!File->IsUsed) {
+			// NOTE(ivan): inotify hands out the same descriptor for a directory that is already watched.
+			s32 DirWatch = inotify_add_watch(LinuxState.INotifyFD, DirName, IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (DirWatch == -1) {
+				DEBUGPlatformOutf("Cannot watch %s for %s!", DirName, BaseName);
+				return FILE_WATCH_INVALID;
+			}
+
+			File->IsUsed = true;
+			File->IsChanged = false;
+			File->DirWatch = DirWatch;
+			strncpy(File->BaseName, BaseName, CountOf(File->BaseName) - 1);
+
+			return Index;
+		}
+	}
+
+	return FILE_WATCH_INVALID;
+}
+
+void
+PlatformUnwatchFile(s32 Watch) {
+	Assert(Watch >= 0 && Watch < (s32)CountOf(LinuxState.WatchedFiles));
+
+	linux_watched_file *File = &LinuxState.WatchedFiles[Watch];
+	Assert(File->IsUsed);
+	File->IsUsed = false;
+
+	// NOTE(ivan): Drop the directory watch when no other file needs it.
+	for (u32 Index = 0; Index < CountOf(LinuxState.WatchedFiles); Index++) {
+		linux_watched_file *Other = &LinuxState.WatchedFiles[Index];
+		if (Other->IsUsed && (Other->DirWatch == File->DirWatch))
+			return;
+	}
+	inotify_rm_watch(LinuxState.INotifyFD, File->DirWatch);
+}
+
+b32
+PlatformIsFileChanged(s32 Watch) {
+	Assert(Watch >= 0 && Watch < (s32)CountOf(LinuxState.WatchedFiles));
+
+	linux_watched_file *File = &LinuxState.WatchedFiles[Watch];
+	Assert(File->IsUsed);
+
+	b32 Result = File->IsChanged;
+	File->IsChanged = false;
+
+	return Result;
+}
+
+static void
+LinuxProcessWatchedFiles(void) {
+	if (LinuxState.INotifyFD == -1)
+		return;
+
+	// NOTE(ivan): Drain all pending inotify events, the descriptor is non-blocking.
+	alignas(struct inotify_event) u8 Buffer[4096];
+	for (;;) {
+		ssize_t BytesRead = read(LinuxState.INotifyFD, Buffer, sizeof(Buffer));
+		if (BytesRead <= 0)
+			break;
+
+		for (u8 *At = Buffer; At < (Buffer + BytesRead);) {
+			struct inotify_event *Event = (struct inotify_event *)At;
+			if (Event->len) {
+				for (u32 Index = 0; Index < CountOf(LinuxState.WatchedFiles); Index++) {
+					linux_watched_file *File = &LinuxState.WatchedFiles[Index];
+					if (File->IsUsed && (File->DirWatch == Event->wd) && (strcmp(File->BaseName, Event->name) == 0))
+						File->IsChanged = true;
+				}
+			}
+
+			At += sizeof(struct inotify_event) + Event->len;
+		}
+	}
+}
+
+#if INTERNAL
+#if SLOWCODE
+void
+DEBUGPlatformOutf(const char *Format, ...) {
+	Assert(Format);
+	
+	// TODO(ivan): Get rid of using CRT's va routines.
+	va_list ArgsList;
+	va_start(ArgsList, Format);
+
+	EnterTicketMutex(&LinuxState.DebugOutputMutex);
+	printf("## ");
+	vprintf(Format, ArgsList);
+	printf("\n");
+	LeaveTicketMutex(&LinuxState.DebugOutputMutex);
+	
+	va_end(ArgsList);
+}
+
+void
+DEBUGPlatformOutFailedAssertion(const char *SrcFile,
+								u32 SrcLine,
+								const char *SrcExpr) {
+	Assert(SrcFile);
+	Assert(SrcExpr);
+
+	DEBUGPlatformOutf("*** ASSERTION FAILED ***");
+	DEBUGPlatformOutf("[SrcFile] %s", SrcFile);
+	DEBUGPlatformOutf("[SrcLine] %d", SrcLine);
+	DEBUGPlatformOutf("[SrcExpr] %s", SrcExpr);
+}
+#endif // #if SLOWCODE
+#endif // #if INTERNAL
+
+inline void
+LinuxSemaphoreWait(sem_t *Semaphore) {
+	Assert(Semaphore);
+	while ((sem_wait(Semaphore) == -1) && (errno == EINTR)) {}
+}
+
+static void *
+LinuxRenderThreadProc(void *Param) {
+	UnusedParam(Param);
+
+	linux_renderer *Renderer = &LinuxState.Renderer;
+	u32 ReadIndex = 0;
+	for (;;) {
+		LinuxSemaphoreWait(&Renderer->ReadySemaphore);
+		if (Renderer->IsQuitting)
+			break;
+
+		LinuxState.GameModule.Render(&Renderer->Commands[ReadIndex], &Renderer->Target);
+		if (Renderer->Present)
+			Renderer->Present(Renderer->PresentData, &Renderer->Target, Renderer->Frames[ReadIndex]);
+
+		ReadIndex ^= 1;
+		sem_post(&Renderer->FreeSemaphore);
+	}
+
+	return 0;
+}
+
+// NOTE(ivan): Falls back to rendering on the calling thread if the render thread cannot be started.
+static b32
+LinuxStartRenderer(game_video_buffer *Target, linux_present_func *Present, void *PresentData) {
+	Assert(Target);
+
+	linux_renderer *Renderer = &LinuxState.Renderer;
+	Renderer->Target = *Target;
+	Renderer->Present = Present;
+	Renderer->PresentData = PresentData;
+	Renderer->WriteIndex = 0;
+	Renderer->IsQuitting = false;
+
+	// NOTE(ivan): Both lists in one go, pages are only touched when used.
+	u8 *Base = (u8 *)mmap(0, 2 * RENDER_COMMANDS_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (Base == MAP_FAILED) {
+		DEBUGPlatformOutf("Could not allocate render command lists!");
+		return false;
+	}
+	for (u32 Index = 0; Index < CountOf(Renderer->Commands); Index++) {
+		Renderer->Commands[Index] = {};
+		Renderer->Commands[Index].Base = Base + (Index * RENDER_COMMANDS_SIZE);
+		Renderer->Commands[Index].Size = RENDER_COMMANDS_SIZE;
+	}
+
+	if (Renderer->IsPipelined) {
+		if ((sem_init(&Renderer->ReadySemaphore, 0, 0) == -1) || (sem_init(&Renderer->FreeSemaphore, 0, 1) == -1) ||
+			(pthread_create(&Renderer->Thread, 0, LinuxRenderThreadProc, 0) != 0)) {
+			DEBUGPlatformOutf("Could not start the render thread, rendering after every update instead.");
+			Renderer->IsPipelined = false;
+		} else {
+			pthread_setname_np(Renderer->Thread, "Render");
+
+			// NOTE(ivan): The core right after the ones of the job system, so it never shares one with a worker.
+			if (LinuxState.IsAffinityEnabled)
+				LinuxSetThreadAffinity(Renderer->Thread, LinuxState.WorkerCount + 1, "Render");
+		}
+	}
+
+	DEBUGPlatformOutf("Rendering %s.", Renderer->IsPipelined ? "on a thread of its own, one frame behind" : "after every update");
+	return true;
+}
+
+// NOTE(ivan): Returns once no list is in flight.
+static void
+LinuxWaitForRenderer(void) {
+	linux_renderer *Renderer = &LinuxState.Renderer;
+	if (Renderer->IsPipelined && Renderer->Commands[0].Base) {
+		LinuxSemaphoreWait(&Renderer->FreeSemaphore);
+		sem_post(&Renderer->FreeSemaphore);
+	}
+}
+
+// NOTE(ivan): Right before the game update.
+static void
+LinuxBeginRenderFrame(void) {
+	linux_renderer *Renderer = &LinuxState.Renderer;
+
+	render_commands *Commands = &Renderer->Commands[Renderer->WriteIndex];
+	BeginRenderCommands(Commands, Renderer->Target.Width, Renderer->Target.Height);
+	GameState.RenderCommands = Commands;
+}
+
+// NOTE(ivan): Right after the game update. When pipelined, only waits if the previous frame is still being rendered.
+static void
+LinuxEndRenderFrame(u64 Frame) {
+	linux_renderer *Renderer = &LinuxState.Renderer;
+
+	render_commands *Commands = &Renderer->Commands[Renderer->WriteIndex];
+	if (Commands->DroppedCount)
+		DEBUGPlatformOutf("Frame %llu: %u render commands did not fit!", (unsigned long long)Frame, Commands->DroppedCount);
+
+	if (!Renderer->IsPipelined) {
+		LinuxState.GameModule.Render(Commands, &Renderer->Target);
+		if (Renderer->Present)
+			Renderer->Present(Renderer->PresentData, &Renderer->Target, Frame);
+		return;
+	}
+
+	Renderer->Frames[Renderer->WriteIndex] = Frame;
+	LinuxSemaphoreWait(&Renderer->FreeSemaphore);
+	sem_post(&Renderer->ReadySemaphore);
+
+	Renderer->WriteIndex ^= 1;
+	GameState.RenderCommands = 0;
+}
+
+static void
+LinuxStopRenderer(void) {
+	linux_renderer *Renderer = &LinuxState.Renderer;
+	if (!Renderer->Commands[0].Base)
+		return;
+
+	if (Renderer->IsPipelined) {
+		LinuxWaitForRenderer();
+
+		Renderer->IsQuitting = true;
+		sem_post(&Renderer->ReadySemaphore);
+		pthread_join(Renderer->Thread, 0);
+
+		sem_destroy(&Renderer->ReadySemaphore);
+		sem_destroy(&Renderer->FreeSemaphore);
+	}
+
+	munmap(Renderer->Commands[0].Base, 2 * RENDER_COMMANDS_SIZE);
+	for (u32 Index = 0; Index < CountOf(Renderer->Commands); Index++)
+		Renderer->Commands[Index] = {};
+	GameState.RenderCommands = 0;
+}
+
+inline b32
+AreFileTimesEqual(struct timespec A, struct timespec B) {
+	return ((A.tv_sec == B.tv_sec) && (A.tv_nsec == B.tv_nsec));
+}
+
+// NOTE(ivan): The library is loaded from a copy, so the build can overwrite the original at any time,
+// and a fresh name every time, so dlopen() never hands back the library it already has.
+static b32
+LinuxLoadGameModuleLibrary(linux_game_module *Module) {
+	Assert(Module);
+
+	struct stat FileStat;
+	if (stat(Module->FileName, &FileStat) != 0)
+		return false;
+
+	piece Image = PlatformReadEntireFile(Module->FileName);
+	if (!Image.Base)
+		return false;
+
+	char LiveName[2048 + 32];
+	snprintf(LiveName, CountOf(LiveName), "%s.live%u", Module->FileName, Module->LoadCount);
+	b32 IsCopied = PlatformWriteEntireFile(LiveName, Image.Base, Image.Size);
+	PlatformFreeEntireFilePiece(&Image);
+	if (!IsCopied)
+		return false;
+
+	void *Library = dlopen(LiveName, RTLD_NOW | RTLD_LOCAL);
+	unlink(LiveName); // NOTE(ivan): The mapping keeps the file alive, nothing to clean up later.
+	if (!Library) {
+		DEBUGPlatformOutf("dlopen() failed: %s", dlerror());
+		return false;
+	}
+
+	game_update_func *Update = (game_update_func *)dlsym(Library, "GameUpdate");
+	game_render_func *Render = (game_render_func *)dlsym(Library, "GameRender");
+	if (!Update || !Render) {
+		DEBUGPlatformOutf("Game module %s has no GameUpdate() or GameRender()!", Module->FileName);
+		dlclose(Library);
+		return false;
+	}
+
+	// NOTE(ivan): Nothing of the old library may be running by the time it is gone, job callbacks and the render thread included.
+	if (Module->Library) {
+		LinuxWaitForRenderer();
+		PlatformCompleteAllWork();
+		dlclose(Module->Library);
+	}
+
+	Module->Library = Library;
+	Module->Update = Update;
+	Module->Render = Render;
+	Module->LastWriteTime = FileStat.st_mtim;
+	Module->LoadCount++;
+
+	return true;
+}
+
+static b32
+LinuxLoadGameModule(linux_game_module *Module) {
+	Assert(Module);
+
+	Module->Watch = FILE_WATCH_INVALID;
+	snprintf(Module->FileName, CountOf(Module->FileName), "%s%s_ents.so", LinuxState.ExecutablePath, LinuxState.ExecutableName);
+	if (!LinuxLoadGameModuleLibrary(Module))
+		return false;
+
+	Module->Watch = PlatformWatchFile(Module->FileName);
+	DEBUGPlatformOutf("Game module: %s", Module->FileName);
+
+	return true;
+}
+
+// NOTE(ivan): Frame boundary only. game_state and the hunk belong to the platform layer and survive the swap,
+// whatever the game keeps in its own static variables does not.
+static void
+LinuxReloadChangedGameModule(linux_game_module *Module) {
+	Assert(Module);
+	Assert(Module->Library);
+
+	// NOTE(ivan): Without inotify the file time is polled every frame.
+	if ((Module->Watch != FILE_WATCH_INVALID) && !PlatformIsFileChanged(Module->Watch))
+		return;
+
+	struct stat FileStat;
+	if ((stat(Module->FileName, &FileStat) != 0) || AreFileTimesEqual(FileStat.st_mtim, Module->LastWriteTime))
+		return;
+
+	struct timespec ReloadStart = LinuxGetClock();
+	if (LinuxLoadGameModuleLibrary(Module))
+		DEBUGPlatformOutf("Game module reloaded in %.1fms.", LinuxGetSecondsElapsed(ReloadStart, LinuxGetClock()) * 1000.0);
+	else
+		DEBUGPlatformOutf("Game module reload failed, keeping the old one.");
+}
+
+static void
+LinuxUnloadGameModule(linux_game_module *Module) {
+	Assert(Module);
+
+	if (Module->Watch != FILE_WATCH_INVALID)
+		PlatformUnwatchFile(Module->Watch);
+
+	if (Module->Library) {
+		PlatformCompleteAllWork();
+		dlclose(Module->Library);
+	}
+
+	Module->Library = 0;
+	Module->Update = 0;
+}
+
+// NOTE(ivan): Game memory preparation (hunk), "-hunk <bytes>" or most of the available memory.
+static b32
+LinuxAllocateHunk(void) {
+	uptr HunkSize = 0;
+	u32 MemAvailable = sysconf(_SC_PAGE_SIZE) * sysconf(_SC_AVPHYS_PAGES);
+
+	const char *ParamHunk = PlatformCheckParamValue("-hunk");
+	if (ParamHunk) {
+		sscanf(ParamHunk, "%zu", &HunkSize); // TODO(ivan): Replace CRT's sscanf() with our own function.
+	} else if (MemAvailable) {
+		HunkSize = (u32)(0.9f * (f32)MemAvailable);
+	} else {
+#if defined(__i386__)					
+		HunkSize = Gigabytes(2);
+#elif defined(__x86_64__) || defined(__amd64__)
+		HunkSize = Gigabytes(4);
+#endif
+	}
+
+	DEBUGPlatformOutf("Memory available: %dKb", MemAvailable / 1024);
+	DEBUGPlatformOutf("Hunk size: %zuKb", HunkSize / 1024);
+
+	void *Base = mmap(0, HunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (Base == MAP_FAILED)
+		return false;
+
+	GameState.Hunk.Base = (u8 *)Base;
+	GameState.Hunk.Size = HunkSize;
+
+	return true;
+}
+
+static void
+LinuxFreeHunk(void) {
+	// NOTE(ivan): Queued work may still point into the hunk.
+	PlatformCompleteAllWork();
+	munmap(GameState.Hunk.Base, GameState.Hunk.Size);
+	GameState.Hunk.Base = 0;
+	GameState.Hunk.Size = 0;
+}
+
+// NOTE(ivan): Before the next frame, reset the mouse wheel and make all input states obsolete.
+static void
+LinuxFinishFrameInput(void) {
+	GameState.MouseWheel = 0;
+	GameState.InputEvents.Count = 0;
+
+	for (u32 Index = 0; Index < CountOf(GameState.KeyboardButtons); Index++)
+		GameState.KeyboardButtons[Index].IsNew = false;
+
+	for (u32 Index = 0; Index < CountOf(GameState.MouseButtons); Index++)
+		GameState.MouseButtons[Index].IsNew = false;
+
+	for (u32 Index = 0; Index < CountOf(GameState.XboxControllers); Index++) {
+		game_input_xbox_controller *XboxController = &GameState.XboxControllers[Index];
+
+		XboxController->Start.IsNew = false;
+		XboxController->Back.IsNew = false;
+
+		XboxController->A.IsNew = false;
+		XboxController->B.IsNew = false;
+		XboxController->X.IsNew = false;
+		XboxController->Y.IsNew = false;
+
+		XboxController->Up.IsNew = false;
+		XboxController->Down.IsNew = false;
+		XboxController->Left.IsNew = false;
+		XboxController->Right.IsNew = false;
+
+		XboxController->LeftBumper.IsNew = false;
+		XboxController->RightBumper.IsNew = false;
+
+		XboxController->LeftStick.IsNew = false;
+		XboxController->RightStick.IsNew = false;
+	}
+}
+
+// NOTE(ivan): Input recording ("-record <file>") and playback ("-playback <file>"), both may run at once.
+static void
+LinuxBeginInputRecordingAndPlayback(void) {
+	LinuxState.InputRecordFile = -1;
+	LinuxState.ReplayLoop.InputFile = -1;
+
+	const char *ParamLoop = PlatformCheckParamValue("-loop");
+	if (ParamLoop) {
+		unsigned long long FirstFrame, LastFrame;
+		if ((sscanf(ParamLoop, "%llu,%llu", &FirstFrame, &LastFrame) == 2) && (FirstFrame < LastFrame)) {
+			LinuxState.ReplayLoop.FirstFrame = FirstFrame;
+			LinuxState.ReplayLoop.LastFrame = LastFrame;
+		} else {
+			DEBUGPlatformOutf("Bad replay loop frames %s, expected <first>,<last>!", ParamLoop);
+		}
+	}
+
+	const char *ParamRecord = PlatformCheckParamValue("-record");
+	if (ParamRecord) {
+		LinuxState.InputRecordFile = open(ParamRecord, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (LinuxState.InputRecordFile != -1) {
+			BeginInputRecording(&LinuxState.InputRecorder);
+			DEBUGPlatformOutf("Recording input to %s", ParamRecord);
+		} else {
+			DEBUGPlatformOutf("Could not create input recording %s!", ParamRecord);
+		}
+	}
+
+	const char *ParamPlayback = PlatformCheckParamValue("-playback");
+	if (ParamPlayback) {
+		LinuxState.IsPlayingBack = BeginInputPlayback(&LinuxState.InputPlayer, ParamPlayback);
+		if (LinuxState.IsPlayingBack)
+			DEBUGPlatformOutf("Playing input back from %s", ParamPlayback);
+		else
+			DEBUGPlatformOutf("Input recording %s is missing or was made by an incompatible build!", ParamPlayback);
+	}
+}
+
+// NOTE(ivan): Writes out and empties the recorder buffer, closes the file and sets it to -1 on failure.
+static void
+LinuxFlushInputRecording(s32 *File, input_recorder *Recorder) {
+	Assert(File);
+	Assert(Recorder);
+
+	u8 *At = Recorder->Buffer;
+	uptr Left = Recorder->BufferUsed;
+	while (Left) {
+		ssize_t Written = write(*File, At, Left);
+		if (Written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			DEBUGPlatformOutf("Failed writing input recording, recording stopped!");
+			close(*File);
+			*File = -1;
+			break;
+		}
+
+		At += Written;
+		Left -= Written;
+	}
+
+	Recorder->BufferUsed = 0;
+}
+
+// NOTE(ivan): Replay loop, for running one section of a session over and over.
+// Marking the loop start snapshots the whole hunk into a file and starts recording input, marking the loop end
+// switches to playing that input back, and every time it runs out the hunk is restored and the input starts over.
+// The restore maps the snapshot file privately over the hunk with one mmap(), pages are brought back lazily
+// from the page cache as the game touches them, and copied only when it writes them.
+// INTERNAL builds toggle off -> recording -> playing -> off with F5, "-loop <first>,<last>" does the same
+// by frame number, which together with "-headless" profiles one slice as many times as needed.
+// NOTE(ivan): Only the hunk is restored. Anything the game keeps outside of it (mapped files, thread scratch heaps)
+// must not be referenced from the hunk across the loop start. Work queue entries may write into the hunk
+// (background asset reloads), so they are drained before the hunk is saved or replaced.
+#define REPLAY_LOOP_HUNK_NAME "loop.hunk"
+#define REPLAY_LOOP_INPUT_NAME "loop.qir"
+#define REPLAY_LOOP_BLOCK_SIZE Kilobytes(64)
+
+static void
+LinuxGetReplayLoopFileName(char *Buffer, uptr Size, const char *Name) {
+	snprintf(Buffer, Size, "%s%s", LinuxState.ExecutablePath, Name);
+}
+
+inline b32
+IsMemoryZero(const u8 *Base, uptr Size) {
+	Assert(((uptr)Base % sizeof(u64)) == 0);
+
+	const u64 *Words = (const u64 *)Base;
+	uptr WordCount = Size / sizeof(u64);
+	for (uptr Index = 0; Index < WordCount; Index++) {
+		if (Words[Index])
+			return false;
+	}
+
+	for (uptr Index = WordCount * sizeof(u64); Index < Size; Index++) {
+		if (Base[Index])
+			return false;
+	}
+
+	return true;
+}
+
+// NOTE(ivan): Copies the hunk into a fresh sparse file with all the job threads, blocks of zeroes are left as holes.
+static b32
+LinuxSnapshotHunk(const char *FileName) {
+	Assert(FileName);
+
+	// NOTE(ivan): The hunk may still be a private mapping of the previous snapshot, which has to keep its own inode:
+	// writing into that one would show through the pages the game has not touched since.
+	unlink(FileName);
+	s32 File = open(FileName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (File == -1)
+		return false;
+
+	b32 Result = false;
+	if (ftruncate(File, GameState.Hunk.Size) == 0) {
+		void *Snapshot = mmap(0, GameState.Hunk.Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+		if (Snapshot != MAP_FAILED) {
+			u8 *Dest = (u8 *)Snapshot;
+			u8 *Source = GameState.Hunk.Base;
+			uptr HunkSize = GameState.Hunk.Size;
+			u32 BlockCount = (u32)((HunkSize + REPLAY_LOOP_BLOCK_SIZE - 1) / REPLAY_LOOP_BLOCK_SIZE);
+			ParallelFor(BlockCount, 16, [Dest, Source, HunkSize](u32 Block) {
+				uptr Offset = (uptr)Block * REPLAY_LOOP_BLOCK_SIZE;
+				uptr Size = Min((uptr)REPLAY_LOOP_BLOCK_SIZE, HunkSize - Offset);
+				if (!IsMemoryZero(Source + Offset, Size))
+					CopyBytes(Dest + Offset, Source + Offset, Size);
+			});
+
+			munmap(Snapshot, GameState.Hunk.Size);
+			Result = true;
+		}
+	}
+
+	close(File);
+	return Result;
+}
+
+static b32
+LinuxRestoreHunk(const char *FileName) {
+	Assert(FileName);
+
+	s32 File = open(FileName, O_RDONLY | O_CLOEXEC);
+	if (File == -1)
+		return false;
+
+	// NOTE(ivan): Replaces the current hunk pages in place, the address does not change.
+	void *Base = mmap(GameState.Hunk.Base, GameState.Hunk.Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, File, 0);
+	close(File);
+
+	return (Base == GameState.Hunk.Base);
+}
+
+static void
+LinuxBeginReplayLoopRecording(void) {
+	linux_replay_loop *Loop = &LinuxState.ReplayLoop;
+	Assert(Loop->State == LinuxReplayLoop_Off);
+
+	char HunkFileName[PATH_MAX], InputFileName[PATH_MAX];
+	LinuxGetReplayLoopFileName(HunkFileName, CountOf(HunkFileName), REPLAY_LOOP_HUNK_NAME);
+	LinuxGetReplayLoopFileName(InputFileName, CountOf(InputFileName), REPLAY_LOOP_INPUT_NAME);
+
+	struct timespec SnapshotStart = LinuxGetClock();
+	PlatformCompleteAllWork();
+	if (!LinuxSnapshotHunk(HunkFileName)) {
+		DEBUGPlatformOutf("Replay loop: could not snapshot the hunk into %s!", HunkFileName);
+		return;
+	}
+
+	Loop->InputFile = open(InputFileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (Loop->InputFile == -1) {
+		DEBUGPlatformOutf("Replay loop: could not create %s!", InputFileName);
+		return;
+	}
+
+	BeginInputRecording(&Loop->Recorder);
+	Loop->FixedStep = LinuxState.FixedStep;
+	Loop->TickCount = GameState.TickCount;
+	Loop->State = LinuxReplayLoop_Recording;
+
+	DEBUGPlatformOutf("Replay loop: recording from frame %llu, hunk snapshot took %.1fms.",
+					  (unsigned long long)GameState.FrameStats.FrameCount,
+					  LinuxGetSecondsElapsed(SnapshotStart, LinuxGetClock()) * 1000.0);
+}
+
+static void
+LinuxBeginReplayLoopPlayback(void) {
+	linux_replay_loop *Loop = &LinuxState.ReplayLoop;
+	Assert(Loop->State == LinuxReplayLoop_Recording);
+
+	LinuxFlushInputRecording(&Loop->InputFile, &Loop->Recorder);
+	if (Loop->InputFile == -1) {
+		Loop->State = LinuxReplayLoop_Off;
+		return;
+	}
+
+	close(Loop->InputFile);
+	Loop->InputFile = -1;
+
+	// NOTE(ivan): The player starts out empty, so the very first frame restores the hunk and opens the recording.
+	memset(&Loop->Player, 0, sizeof(Loop->Player));
+	Loop->LoopCount = 0;
+	Loop->State = LinuxReplayLoop_Playing;
+
+	DEBUGPlatformOutf("Replay loop: playing %u frames over and over.", Loop->Recorder.FrameCount);
+}
+
+static void
+LinuxEndReplayLoop(void) {
+	linux_replay_loop *Loop = &LinuxState.ReplayLoop;
+
+	if (Loop->State == LinuxReplayLoop_Recording) {
+		close(Loop->InputFile);
+		Loop->InputFile = -1;
+	} else if (Loop->State == LinuxReplayLoop_Playing) {
+		EndInputPlayback(&Loop->Player);
+		DEBUGPlatformOutf("Replay loop: stopped after %u loops.", Loop->LoopCount);
+	}
+
+	Loop->State = LinuxReplayLoop_Off;
+}
+
+// NOTE(ivan): Jumps back to the first frame of the loop.
+static b32
+LinuxRestartReplayLoop(void) {
+	linux_replay_loop *Loop = &LinuxState.ReplayLoop;
+
+	char HunkFileName[PATH_MAX], InputFileName[PATH_MAX];
+	LinuxGetReplayLoopFileName(HunkFileName, CountOf(HunkFileName), REPLAY_LOOP_HUNK_NAME);
+	LinuxGetReplayLoopFileName(InputFileName, CountOf(InputFileName), REPLAY_LOOP_INPUT_NAME);
+
+	EndInputPlayback(&Loop->Player);
+	PlatformCompleteAllWork();
+	if (!LinuxRestoreHunk(HunkFileName) || !BeginInputPlayback(&Loop->Player, InputFileName))
+		return false;
+
+	LinuxState.FixedStep = Loop->FixedStep;
+	GameState.TickCount = Loop->TickCount;
+
+	return PlayInputFrame(&Loop->Player, &GameState);
+}
+
+static void
+LinuxUpdateReplayLoop(void) {
+	linux_replay_loop *Loop = &LinuxState.ReplayLoop;
+
+#if INTERNAL
+	// NOTE(ivan): Checked before the recorded input replaces the live one.
+	if (IsNewlyPressed(&GameState.KeyboardButtons[KeyCode_F5])) {
+		if (Loop->State == LinuxReplayLoop_Off)
+			LinuxBeginReplayLoopRecording();
+		else if (Loop->State == LinuxReplayLoop_Recording)
+			LinuxBeginReplayLoopPlayback();
+		else
+			LinuxEndReplayLoop();
+	}
+#endif
+
+	if (Loop->LastFrame) {
+		u64 Frame = GameState.FrameStats.FrameCount;
+		if ((Frame == Loop->FirstFrame) && (Loop->State == LinuxReplayLoop_Off))
+			LinuxBeginReplayLoopRecording();
+		else if ((Frame == Loop->LastFrame) && (Loop->State == LinuxReplayLoop_Recording))
+			LinuxBeginReplayLoopPlayback();
+	}
+
+	if (Loop->State == LinuxReplayLoop_Playing) {
+		if (!PlayInputFrame(&Loop->Player, &GameState)) {
+			if (LinuxRestartReplayLoop()) {
+				Loop->LoopCount++;
+			} else {
+				DEBUGPlatformOutf("Replay loop: could not restart the loop!");
+				LinuxEndReplayLoop();
+			}
+		}
+	} else if (Loop->State == LinuxReplayLoop_Recording) {
+		if (RecordInputFrame(&Loop->Recorder, &GameState))
+			LinuxFlushInputRecording(&Loop->InputFile, &Loop->Recorder);
+		if (Loop->InputFile == -1)
+			Loop->State = LinuxReplayLoop_Off;
+	}
+}
+
+// NOTE(ivan): Right before the game update: record the input the game is about to see, or replace it with the recorded one.
+// Returns false once the playback is over, the session ends there, before the frame the recording does not cover.
+static b32
+LinuxRecordOrPlaybackInput(void) {
+	if (LinuxState.IsPlayingBack) {
+		if (!PlayInputFrame(&LinuxState.InputPlayer, &GameState)) {
+			DEBUGPlatformOutf("Input playback %s after %u frames.",
+							  LinuxState.InputPlayer.IsCorrupted ? "stopped at corrupt data" : "finished",
+							  LinuxState.InputPlayer.FrameCount);
+			PlatformQuit(0);
+			return false;
+		}
+	}
+
+	LinuxUpdateReplayLoop();
+
+	if (LinuxState.InputRecordFile != -1) {
+		if (RecordInputFrame(&LinuxState.InputRecorder, &GameState))
+			LinuxFlushInputRecording(&LinuxState.InputRecordFile, &LinuxState.InputRecorder);
+	}
+
+	return true;
+}
+
+static void
+LinuxEndInputRecordingAndPlayback(void) {
+	LinuxEndReplayLoop();
+
+	if (LinuxState.InputRecordFile != -1) {
+		LinuxFlushInputRecording(&LinuxState.InputRecordFile, &LinuxState.InputRecorder);
+		if (LinuxState.InputRecordFile != -1) {
+			DEBUGPlatformOutf("Recorded %u frames of input.", LinuxState.InputRecorder.FrameCount);
+			close(LinuxState.InputRecordFile);
+			LinuxState.InputRecordFile = -1;
+		}
+	}
+
+	if (LinuxState.IsPlayingBack) {
+		EndInputPlayback(&LinuxState.InputPlayer);
+		LinuxState.IsPlayingBack = false;
+	}
+}
+
+// NOTE(ivan): Headless mode, "-headless". No X connection at all: the video buffer lives in memory,
+// input comes from a script and frames run as fast as possible unless "-fps <rate>" is given.
+// Everything above the platform layer runs unchanged.
+//
+// "-width <w>", "-height <h>"  video buffer size, 800x600 by default.
+// "-frames <n>"                stop after that many frames, otherwise run until the script or the game quits.
+// "-script <file>"             input script, see below.
+// "-dumpframes <dir>"          write every frame to <dir>/frameNNNNNN.bmp.
+//
+// The script is a text file with one event per line, in frame order, '#' starts a comment:
+//     <frame> key <keysym name> down|up    e.g. "10 key Escape down", names as in XStringToKeysym()
+//     <frame> button <index> down|up       mouse button, 0 is the left one
+//     <frame> mouse <x> <y>
+//     <frame> wheel <delta>
+//     <frame> quit
+// Events are applied right before the game update of their frame.
+#define HEADLESS_DEFAULT_WIDTH 800
+#define HEADLESS_DEFAULT_HEIGHT 600
+
+struct linux_headless_script {
+	piece Text;
+	char *At; // NOTE(ivan): Start of the next unconsumed line.
+	char *End;
+	u32 LineNumber;
+};
+
+static void
+LinuxApplyHeadlessScript(linux_headless_script *Script, u32 Frame) {
+	Assert(Script);
+
+	while (Script->At < Script->End) {
+		char *LineEnd = Script->At;
+		while ((LineEnd < Script->End) && (*LineEnd != '\n'))
+			LineEnd++;
+
+		char Line[256];
+		CopyStringN(Line, Script->At, Min((uptr)(LineEnd - Script->At), (uptr)(CountOf(Line) - 1)));
+
+		char *Comment = Line;
+		while (*Comment && (*Comment != '#'))
+			Comment++;
+		*Comment = 0;
+
+		u32 LineFrame;
+		char Command[32];
+		s32 ArgsOffset = 0;
+		if (sscanf(Line, "%u %31s %n", &LineFrame, Command, &ArgsOffset) == 2) {
+			// NOTE(ivan): Not this frame's yet, leave it for later.
+			if (LineFrame > Frame)
+				return;
+		} else {
+			Command[0] = 0;
+		}
+
+		Script->At = (LineEnd < Script->End) ? LineEnd + 1 : LineEnd;
+		Script->LineNumber++;
+
+		if (!Command[0])
+			continue;
+
+		const char *Args = Line + ArgsOffset;
+		u32 Time = (u32)(LinuxGetNanoseconds() / 1000000);
+		if (AreStringsEqual(Command, "key")) {
+			char Name[64], State[8];
+			key_code KeyCode;
+			if ((sscanf(Args, "%63s %7s", Name, State) == 2) &&
+				LinuxMapXKeySymToKeyCode(XStringToKeysym(Name), &KeyCode)) {
+				b32 IsDown = AreStringsEqual(State, "down");
+				LinuxProcessKeyboardOrMouseButton(&GameState.KeyboardButtons[KeyCode], IsDown);
+				PushInputEvent(&GameState.InputEvents, GameInputEvent_Key, KeyCode, IsDown, Time);
+			} else {
+				DEBUGPlatformOutf("Headless script line %u: unknown key!", Script->LineNumber);
+			}
+		} else if (AreStringsEqual(Command, "button")) {
+			u32 Index;
+			char State[8];
+			if ((sscanf(Args, "%u %7s", &Index, State) == 2) && (Index < CountOf(GameState.MouseButtons))) {
+				b32 IsDown = AreStringsEqual(State, "down");
+				LinuxProcessKeyboardOrMouseButton(&GameState.MouseButtons[Index], IsDown);
+				PushInputEvent(&GameState.InputEvents, GameInputEvent_MouseButton, Index, IsDown, Time);
+			} else {
+				DEBUGPlatformOutf("Headless script line %u: bad mouse button!", Script->LineNumber);
+			}
+		} else if (AreStringsEqual(Command, "mouse")) {
+			s32 X, Y;
+			if (sscanf(Args, "%d %d", &X, &Y) == 2) {
+				GameState.MousePos.X = X;
+				GameState.MousePos.Y = Y;
+			}
+		} else if (AreStringsEqual(Command, "wheel")) {
+			s32 Delta;
+			if (sscanf(Args, "%d", &Delta) == 1) {
+				GameState.MouseWheel += Delta;
+				PushInputEvent(&GameState.InputEvents, GameInputEvent_MouseWheel, 0, Delta, Time);
+			}
+		} else if (AreStringsEqual(Command, "quit")) {
+			PlatformQuit(0);
+		} else {
+			DEBUGPlatformOutf("Headless script line %u: unknown command %s!", Script->LineNumber, Command);
+		}
+	}
+}
+
+inline void
+LinuxStoreU16(u8 *At, u16 Value) {
+	At[0] = (u8)Value;
+	At[1] = (u8)(Value >> 8);
+}
+
+inline void
+LinuxStoreU32(u8 *At, u32 Value) {
+	At[0] = (u8)Value;
+	At[1] = (u8)(Value >> 8);
+	At[2] = (u8)(Value >> 16);
+	At[3] = (u8)(Value >> 24);
+}
+
+// NOTE(ivan): 32-bit top-down BMP, its BGRA byte order is exactly our 0xAARRGGBB in memory, so rows are written as is.
+static b32
+LinuxWriteVideoBufferBmp(const char *FileName, game_video_buffer *Buffer) {
+	Assert(FileName);
+	Assert(Buffer);
+	Assert(Buffer->BytesPerPixel == 4);
+
+	u32 RowSize = Buffer->Width * 4;
+	u32 PixelsSize = RowSize * Buffer->Height;
+
+	u8 Header[54] = {};
+	Header[0] = 'B';
+	Header[1] = 'M';
+	LinuxStoreU32(Header + 2, sizeof(Header) + PixelsSize);
+	LinuxStoreU32(Header + 10, sizeof(Header));
+	LinuxStoreU32(Header + 14, 40);
+	LinuxStoreU32(Header + 18, (u32)Buffer->Width);
+	LinuxStoreU32(Header + 22, (u32)-Buffer->Height); // NOTE(ivan): Negative height means top-down.
+	LinuxStoreU16(Header + 26, 1);
+	LinuxStoreU16(Header + 28, 32);
+	LinuxStoreU32(Header + 34, PixelsSize);
+
+	s32 File = open(FileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (File == -1)
+		return false;
+
+	b32 Result = (write(File, Header, sizeof(Header)) == sizeof(Header));
+	u8 *Row = (u8 *)Buffer->Pixels;
+	for (s32 Y = 0; Result && (Y < Buffer->Height); Y++) {
+		Result = (write(File, Row, RowSize) == (ssize_t)RowSize);
+		Row += Buffer->Pitch;
+	}
+
+	close(File);
+	return Result;
+}
+
+// NOTE(ivan): Headless frames go nowhere unless "-dumpframes <dir>" is given, Data is that directory then.
+static void
+LinuxPresentHeadless(void *Data, game_video_buffer *Buffer, u64 Frame) {
+	const char *DumpDir = (const char *)Data;
+	if (!DumpDir)
+		return;
+
+	char FrameName[PATH_MAX];
+	snprintf(FrameName, CountOf(FrameName), "%s/frame%06llu.bmp", DumpDir, (unsigned long long)Frame);
+	if (!LinuxWriteVideoBufferBmp(FrameName, Buffer))
+		DEBUGPlatformOutf("Failed writing %s", FrameName);
+}
+
+static void
+LinuxRunHeadless(void) {
+	s32 Width = HEADLESS_DEFAULT_WIDTH;
+	s32 Height = HEADLESS_DEFAULT_HEIGHT;
+	const char *ParamWidth = PlatformCheckParamValue("-width");
+	if (ParamWidth)
+		Width = atoi(ParamWidth);
+	const char *ParamHeight = PlatformCheckParamValue("-height");
+	if (ParamHeight)
+		Height = atoi(ParamHeight);
+	if ((Width <= 0) || (Height <= 0)) {
+		DEBUGPlatformOutf("Bad headless video buffer size %dx%d!", Width, Height);
+		return;
+	}
+
+	u32 MaxFrames = 0;
+	const char *ParamFrames = PlatformCheckParamValue("-frames");
+	if (ParamFrames)
+		MaxFrames = (u32)atoi(ParamFrames);
+
+	linux_headless_script Script = {};
+	const char *ParamScript = PlatformCheckParamValue("-script");
+	if (ParamScript) {
+		Script.Text = PlatformReadEntireFile(ParamScript);
+		if (Script.Text.Base) {
+			Script.At = (char *)Script.Text.Base;
+			Script.End = Script.At + Script.Text.Size;
+		} else {
+			DEBUGPlatformOutf("Headless script %s could not be read!", ParamScript);
+		}
+	}
+
+	const char *ParamDumpFrames = PlatformCheckParamValue("-dumpframes");
+
+	// NOTE(ivan): Fixed rate only when asked for, benchmarks want every frame back to back.
+	f64 TargetFramesPerSecond = 0.0;
+	const char *ParamFps = PlatformCheckParamValue("-fps");
+	if (ParamFps)
+		TargetFramesPerSecond = atof(ParamFps);
+
+	DEBUGPlatformOutf("Running headless, %dx%d, %s", Width, Height, (TargetFramesPerSecond > 0.0) ? "fixed rate" : "as fast as possible");
+
+	if (LinuxAllocateHunk()) {
+		game_video_buffer *VideoBuffer = &GameState.VideoBuffer;
+		VideoBuffer->Width = Width;
+		VideoBuffer->Height = Height;
+		VideoBuffer->BytesPerPixel = 4;
+		VideoBuffer->Pitch = Width * 4;
+
+		void *Pixels = mmap(0, VideoBuffer->Pitch * Height, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (Pixels != MAP_FAILED) {
+			VideoBuffer->Pixels = (u32 *)Pixels;
+			if (!LinuxStartRenderer(VideoBuffer, LinuxPresentHeadless, (void *)ParamDumpFrames))
+				PlatformQuit(1);
+			if (LinuxState.Renderer.IsPipelined)
+				VideoBuffer->Pixels = 0; // NOTE(ivan): Belongs to the render thread now.
+
+			LinuxState.GameModule.Update(GameUpdateType_Prepare, &GameState, &GameTLState);
+
+			linux_frame_pacer FramePacer;
+			if (TargetFramesPerSecond > 0.0)
+				LinuxInitializeFramePacer(&FramePacer, TargetFramesPerSecond);
+			InitializeFrameStats(&GameState.FrameStats, (TargetFramesPerSecond > 0.0) ? (1.0 / TargetFramesPerSecond) : 0.0);
+
+			struct timespec StartCounter = LinuxGetClock();
+			struct timespec LastCounter = StartCounter;
+			u64 LastCycleCounter = LinuxGetRDTSC();
+
+			u32 Frame = 0;
+			while (!LinuxState.Quitting && (!MaxFrames || (Frame < MaxFrames))) {
+				if (Script.At) {
+					LinuxApplyHeadlessScript(&Script, Frame);
+					if (LinuxState.Quitting)
+						break;
+				}
+
+				if (!LinuxRecordOrPlaybackInput())
+					break;
+
+				LinuxProcessWatchedFiles();
+				LinuxReloadChangedGameModule(&LinuxState.GameModule);
+
+				LinuxBeginRenderFrame();
+				RunFixedStepFrame(&LinuxState.FixedStep, LinuxState.GameModule.Update, &GameState, &GameTLState);
+				LinuxEndRenderFrame(Frame);
+
+				LinuxFinishFrameInput();
+				Frame++;
+
+				// NOTE(ivan): Finish timings.
+				struct timespec WorkCounter = LinuxGetClock();
+
+				f64 SecondsElapsedForWork = LinuxGetSecondsElapsed(LastCounter, WorkCounter);
+
+				b32 IsMissed = false;
+				if (TargetFramesPerSecond > 0.0) {
+					IsMissed = !LinuxWaitForNextFrame(&FramePacer);
+					GameState.FramesPerSecond = FramePacer.FramesPerSecond;
+				} else {
+					GameState.FramesPerSecond = (SecondsElapsedForWork > 0.0) ? (1.0 / SecondsElapsedForWork) : 0.0;
+				}
+
+				struct timespec EndCounter = LinuxGetClock();
+				u64 EndCycleCounter = LinuxGetRDTSC();
+
+				AddFrameStats(&GameState.FrameStats, SecondsElapsedForWork,
+							  LinuxGetSecondsElapsed(WorkCounter, EndCounter),
+							  LinuxGetSecondsElapsed(LastCounter, EndCounter), IsMissed);
+
+				GameState.SecondsPerFrame = LinuxGetSecondsElapsed(LastCounter, EndCounter);
+				GameState.CyclesPerFrame = (f64)(EndCycleCounter - LastCycleCounter);
+
+				LastCounter = EndCounter;
+				LastCycleCounter = EndCycleCounter;
+			}
+
+			LinuxStopRenderer();
+			LinuxState.GameModule.Update(GameUpdateType_Release, &GameState, &GameTLState);
+
+			f64 SecondsElapsed = LinuxGetSecondsElapsed(StartCounter, LastCounter);
+			frame_time_series *Work = &GameState.FrameStats.Work;
+			DEBUGPlatformOutf("Headless run: %u frames in %.3fs, %.2f frames per second", Frame, SecondsElapsed,
+							  (SecondsElapsed > 0.0) ? ((f64)Frame / SecondsElapsed) : 0.0);
+			DEBUGPlatformOutf("Frame work over the last %u frames: mean %.3fms, p50 %.3fms, p95 %.3fms, p99 %.3fms, max %.3fms",
+							  GameState.FrameStats.SampleCount,
+							  Work->Mean * 1000.0, Work->P50 * 1000.0, Work->P95 * 1000.0, Work->P99 * 1000.0, Work->Max * 1000.0);
+
+			munmap(Pixels, VideoBuffer->Pitch * Height);
+			VideoBuffer->Pixels = 0;
+		} else {
+			DEBUGPlatformOutf("Could not allocate headless video buffer!");
+		}
+
+		LinuxFreeHunk();
+	} else {
+		DEBUGPlatformOutf("Could not allocate enough hunk memory!");
+	}
+
+	if (Script.Text.Base)
+		PlatformFreeEntireFilePiece(&Script.Text);
+}
+
+int
+main(int ArgC, char **ArgV) {
+	DEBUGPlatformOutf("Starting " GAMENAME "...");
+
+	LinuxState.ArgC = ArgC;
 	LinuxState.ArgV = ArgV;
+
+	LinuxCalibrateTsc();
+	LinuxInitializeKeyCodeTable();
 	
 	// NOTE(ivan): Obtain executable's file name and path.
 	char ModuleName[2048] = {};
@@ -537,9 +2726,35 @@ main(int ArgC, char **ArgV) {
 	DEBUGPlatformOutf("Executable name: %s", LinuxState.ExecutableName);
 	DEBUGPlatformOutf("Executable path: %s", LinuxState.ExecutablePath);
 
-	// NOTE(ivan): Establish connect with X.
-	LinuxState.XDisplay = XOpenDisplay(getenv("DISPLAY"));
-	if (LinuxState.XDisplay) {
+	// NOTE(ivan): File watching, not critical for running the game.
+	LinuxState.INotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (LinuxState.INotifyFD == -1)
+		DEBUGPlatformOutf("inotify is not available, file watching disabled.");
+
+	// NOTE(ivan): Render thread, "-pipeline", adds a frame of latency. The X connection is shared with it then.
+	// Known before the workers start, it takes a core of theirs.
+	LinuxState.Renderer.IsPipelined = (PlatformCheckParam("-pipeline") != PARAM_MISSING);
+
+	LinuxStartWorkers();
+	LinuxBeginInputRecordingAndPlayback();
+
+	// NOTE(ivan): Fixed-step simulation, "-tickrate <hz>", off unless asked for.
+#if SLOWCODE
+	DEBUGCheckFixedStep();
+#endif
+	const char *ParamTickRate = PlatformCheckParamValue("-tickrate");
+	InitializeFixedStep(&LinuxState.FixedStep, ParamTickRate ? atof(ParamTickRate) : 0.0);
+	if (LinuxState.FixedStep.SecondsPerTick > 0.0)
+		DEBUGPlatformOutf("Fixed-step simulation at %.2f ticks per second.", 1.0 / LinuxState.FixedStep.SecondsPerTick);
+
+	// NOTE(ivan): Load the game, then establish connect with X, unless running headless.
+	if (!LinuxLoadGameModule(&LinuxState.GameModule)) {
+		DEBUGPlatformOutf("Could not load the game module %s!", LinuxState.GameModule.FileName);
+		LinuxState.QuitCode = 1;
+	} else if (PlatformCheckParam("-headless") != PARAM_MISSING) {
+		LinuxRunHeadless();
+	} else if ((!LinuxState.Renderer.IsPipelined || XInitThreads()) &&
+			   ((LinuxState.XDisplay = XOpenDisplay(getenv("DISPLAY"))) != 0)) {
 		LinuxState.XDefScreen = DefaultScreen(LinuxState.XDisplay);
 		LinuxState.XDefDepth = DefaultDepth(LinuxState.XDisplay, LinuxState.XDefScreen);
 		LinuxState.XDefVisual = DefaultVisual(LinuxState.XDisplay, LinuxState.XDefScreen);
@@ -564,34 +2779,14 @@ main(int ArgC, char **ArgV) {
 				if (XRRQueryVersion(LinuxState.XDisplay, &XRRMajor, &XRRMinor)) {
 					DEBUGPlatformOutf("X XRR extension found, version %d.%d", XRRMajor, XRRMinor);
 					
-					// NOTE(ivan): Game memory preparation (hunk).
-					uptr HunkSize = 0;
-					u32 MemAvailable = sysconf(_SC_PAGE_SIZE) * sysconf(_SC_AVPHYS_PAGES);
-
-					const char *ParamHunk = PlatformCheckParamValue("-hunk");
-					if (ParamHunk) {
-						sscanf(ParamHunk, "%zu", &HunkSize); // TODO(ivan): Replace CRT's sscanf() with our own function.
-					} else if (MemAvailable) {
-						HunkSize = (u32)(0.9f * (f32)MemAvailable);
-					} else {
-#if defined(__i386__)					
-						HunkSize = Gigabytes(2);
-#elif defined(__x86_64__) || defined(__amd64__)
-						HunkSize = Gigabytes(4);
-#endif
-					}
-
-					DEBUGPlatformOutf("Memory available: %dKb", MemAvailable / 1024);
-					DEBUGPlatformOutf("Hunk size: %zuKb", HunkSize / 1024);
-					
-					GameState.Hunk.Size = HunkSize;
-					GameState.Hunk.Base = (u8 *)mmap(0, HunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-					if (GameState.Hunk.Base) {
+					if (LinuxAllocateHunk()) {
 						// NOTE(ivan): Create main window and its graphics device.
 						XSetWindowAttributes WindowAttr = {};
 						WindowAttr.background_pixel = LinuxState.XDefBlack;
 						WindowAttr.border_pixel = LinuxState.XDefBlack;
-						WindowAttr.event_mask = StructureNotifyMask | KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask;
+						// NOTE(ivan): The pointer position comes with motion and crossing events, so it never has to be queried.
+						WindowAttr.event_mask = (StructureNotifyMask | KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask |
+												 PointerMotionMask | EnterWindowMask | LeaveWindowMask);
 
 						point WindowPos = {20, 20};
 						rectangle WindowDim = {800, 600};
@@ -648,70 +2843,40 @@ main(int ArgC, char **ArgV) {
 #else
 							b32 DebugCursor = false;
 #endif
+							// NOTE(ivan): The null cursor is created once, the window cursor is only changed when DebugCursor toggles.
+							Cursor NullCursor = LinuxCreateNullCursor();
+							if (!DebugCursor)
+								XDefineCursor(LinuxState.XDisplay, W, NullCursor);
 
 							// NOTE(ivan): Detect display refresh rate.
 							XRRScreenConfiguration *ScreenInfo = XRRGetScreenInfo(LinuxState.XDisplay,
 																				  LinuxState.XRootWindow);
 							u32 DisplayFrequency = (u32)XRRConfigCurrentRate(ScreenInfo);
 
-							// NOTE(ivan): Detect controllers.
-							u32 NumControllers = 0;
-							u8 ControllerIDs[MAX_CONTROLLERS] = {};
-							s32 ControllerFDs[MAX_CONTROLLERS] = {};
-							s32 ControllerEDs[MAX_CONTROLLERS] = {};
-							struct ff_effect ControllerEffect = {};
-							ControllerEffect.type == FF_RUMBLE;
-							ControllerEffect.u.rumble.strong_magnitude = 60000;
-							ControllerEffect.u.rumble.weak_magnitude = 0;
-							ControllerEffect.replay.length = 200;
-							ControllerEffect.replay.delay = 0;
-							ControllerEffect.id = -1; // NOTE(ivan): ID must be set -1 for every new effect.
-							for (u8 Index = 0; Index < MAX_CONTROLLERS; Index++) {
-								if (ControllerIDs[Index] == 0) {
-									u8 ControllerID = ControllerIDs[NumControllers];
-									if (ControllerFDs[ControllerID] && ControllerEDs[ControllerID]) {
-										NumControllers++;
-										continue;
-									} else if (!ControllerFDs[ControllerID]) {
-										char ControllerFileName[] = "/dev/input/jsX";
-										ControllerFileName[13] = (char)(Index + 0x30);
-										int File = open(ControllerFileName, O_RDONLY | O_NONBLOCK);
-										if (File == -1)
-											continue;
-										ControllerIDs[ControllerID] = File;
-									}
-
-									if (!ControllerEDs[ControllerID]) {
-										// TODO(ivan): Match the joystick file ids with the event ids.
-										for (u8 TempIndex; TempIndex <= MAX_CONTROLLERS; TempIndex++) {
-											char TempBuffer[] = "/sys/class/input/jsX/device/event/event/X";
-											TempBuffer[19] = (char)(Index + 0x30);
-											TempBuffer[40] = (char)(TempIndex + 0x30);
-											if (LinuxDirectoryExists(TempBuffer)) {
-												char AnotherBuffer[] = "/dev/input/eventX";
-												AnotherBuffer[16] = (char)(Index + 0x30);
-												int File = open(AnotherBuffer, O_RDWR);
-												if (File != -1) {
-													ControllerEDs[Index] = File;
-													// NOTE(ivan): Send the effect to the driver.
-													if (ioctl(File, EVIOCSFF, &ControllerEffect) == -1) {
-														DEBUGPlatformOutf("Failed sending the effect to the game controller driver.");
-														DEBUGPlatformOutf("%s: %s", AnotherBuffer, TempBuffer);
-													}
-
-													break;
-												}
-											}
-										}
-									}
-
-									ControllerIDs[NumControllers++] = Index;
-								} else {
-									NumControllers++;
-								}
-							}
-							
-							GameUpdate(GameUpdateType_Prepare);
+							// NOTE(ivan): Frame rate, the display refresh rate unless "-fps <rate>" says otherwise.
+							f64 TargetFramesPerSecond = (f64)DisplayFrequency;
+							const char *ParamFps = PlatformCheckParamValue("-fps");
+							if (ParamFps)
+								TargetFramesPerSecond = atof(ParamFps);
+							if (TargetFramesPerSecond <= 0.0)
+								TargetFramesPerSecond = 60.0;
+							DEBUGPlatformOutf("Display refresh rate: %uHz, target frame rate: %.2f", DisplayFrequency, TargetFramesPerSecond);
+
+							LinuxInitializeControllers();
+
+							// NOTE(ivan): The game renders into the secondary buffer, the renderer shows it in the window.
+							game_video_buffer RenderTarget;
+							RenderTarget.Pixels = SecondaryVideoBuffer.Pixels;
+							RenderTarget.Width = SecondaryVideoBuffer.Width;
+							RenderTarget.Height = SecondaryVideoBuffer.Height;
+							RenderTarget.BytesPerPixel = SecondaryVideoBuffer.BytesPerPixel;
+							RenderTarget.Pitch = SecondaryVideoBuffer.Pitch;
+
+							linux_window_present WindowPresent = {&SecondaryVideoBuffer, W, WindowGC};
+							if (!LinuxStartRenderer(&RenderTarget, LinuxPresentToWindow, &WindowPresent))
+								PlatformQuit(1);
+
+							LinuxState.GameModule.Update(GameUpdateType_Prepare, &GameState, &GameTLState);
 					
 							// NOTE(ivan): Present main window after all initialization is done.
 							XMapRaised(LinuxState.XDisplay, W);
@@ -719,10 +2884,17 @@ main(int ArgC, char **ArgV) {
 
 							struct timespec LastCounter = LinuxGetClock();
 							u64 LastCycleCounter = LinuxGetRDTSC();
+
+							linux_frame_pacer FramePacer;
+							LinuxInitializeFramePacer(&FramePacer, TargetFramesPerSecond);
+							InitializeFrameStats(&GameState.FrameStats, 1.0 / TargetFramesPerSecond);
 							
 							// NOTE(ivan): Primary loop.
-							while (!LinuxState.Quitting) {							
-								// NOTE(ivan): Process X11 messages.
+							// NOTE(ivan): Every iteration runs exactly one frame in fixed phases: drain all pending events,
+							// sample input once, update and render, present, then pace. Events only ever change input state,
+							// so the frame cost does not depend on how many of them arrived.
+							while (!LinuxState.Quitting) {
+								// NOTE(ivan): Drain X11 messages.
 								static XEvent Ev;
 								while (XPending(LinuxState.XDisplay)) {
 									XNextEvent(LinuxState.XDisplay, &Ev);
@@ -738,17 +2910,9 @@ main(int ArgC, char **ArgV) {
 												Ev.xconfigure.height != SecondaryVideoBuffer.Height) {
 												WindowDim = LinuxGetWindowClientDimension(W);
 
-												if (SecondaryVideoBuffer.Pixels) {
-													CopyBytes(SecondaryVideoBuffer.Image->data,
-															  SecondaryVideoBuffer.Pixels,
-															  SecondaryVideoBuffer.Width * SecondaryVideoBuffer.Height * SecondaryVideoBuffer.BytesPerPixel);
-													XShmPutImage(LinuxState.XDisplay,
-																 W, WindowGC,
-																 SecondaryVideoBuffer.Image,
-																 0, 0, 0, 0,
-																 SecondaryVideoBuffer.Width, SecondaryVideoBuffer.Height,
-																 False);
-												}
+												// NOTE(ivan): The render thread presents on its own, and may be drawing into the buffer right now.
+												if (!LinuxState.Renderer.IsPipelined)
+													LinuxDisplayVideoBuffer(&SecondaryVideoBuffer, W, WindowGC);
 											}
 										} break;
 
@@ -757,218 +2921,133 @@ main(int ArgC, char **ArgV) {
 											KeySym XKeySym = XLookupKeysym(&Ev.xkey, 0);
 
 											key_code KeyCode;
-											if (LinuxMapXKeySymToKeyCode(XKeySym, &KeyCode))
-												LinuxProcessKeyboardOrMouseButton(&GameState.KeyboardButtons[KeyCode], Ev.type == KeyPress);
+											if (LinuxMapXKeySymToKeyCode(XKeySym, &KeyCode)) {
+												b32 IsDown = (Ev.type == KeyPress);
+												LinuxProcessKeyboardOrMouseButton(&GameState.KeyboardButtons[KeyCode], IsDown);
+												PushInputEvent(&GameState.InputEvents, GameInputEvent_Key, KeyCode, IsDown, (u32)Ev.xkey.time);
+											}
+										} break;
+
+										case MotionNotify: {
+											GameState.MousePos.X = Ev.xmotion.x;
+											GameState.MousePos.Y = Ev.xmotion.y;
+										} break;
+
+										case EnterNotify:
+										case LeaveNotify: {
+											GameState.MousePos.X = Ev.xcrossing.x;
+											GameState.MousePos.Y = Ev.xcrossing.y;
 										} break;
 
 										case ButtonPress:
 										case ButtonRelease: {
+											GameState.MousePos.X = Ev.xbutton.x;
+											GameState.MousePos.Y = Ev.xbutton.y;
+
 											b32 IsKeyPress = (Ev.type == ButtonPress);
+											u32 Time = (u32)Ev.xbutton.time;
 											switch (Ev.xbutton.button) {
-											case Button1: {
-												LinuxProcessKeyboardOrMouseButton(&GameState.MouseButtons[0], IsKeyPress);
-											} break;
-
-											case Button2: {
-												LinuxProcessKeyboardOrMouseButton(&GameState.MouseButtons[1], IsKeyPress);
-											} break;
-
+											case Button1:
+											case Button2:
 											case Button3: {
-												LinuxProcessKeyboardOrMouseButton(&GameState.MouseButtons[2], IsKeyPress);
+												u32 Index = Ev.xbutton.button - Button1;
+												LinuxProcessKeyboardOrMouseButton(&GameState.MouseButtons[Index], IsKeyPress);
+												PushInputEvent(&GameState.InputEvents, GameInputEvent_MouseButton, Index, IsKeyPress, Time);
 											} break;
 
+											// NOTE(ivan): Every wheel step comes as a press and a release, count the presses only.
 											case Button4: {
-												GameState.MouseWheel++;
+												if (IsKeyPress) {
+													GameState.MouseWheel++;
+													PushInputEvent(&GameState.InputEvents, GameInputEvent_MouseWheel, 0, 1, Time);
+												}
 											} break;
 
 											case Button5: {
-												GameState.MouseWheel--;
+												if (IsKeyPress) {
+													GameState.MouseWheel--;
+													PushInputEvent(&GameState.InputEvents, GameInputEvent_MouseWheel, 0, -1, Time);
+												}
 											} break;
 											}
 										} break;
 										}
 									}
+								}
 
-									// NOTE(ivan): Capture mouse pointer position.
-									Window RootIgnore, ChildIgnore;
-									s32 RootXIgnore, RootYIgnore;
-									s32 WinX, WinY;
-									u32 MaskIgnore;
-									XQueryPointer(LinuxState.XDisplay, W,
-												  &RootIgnore, &ChildIgnore,
-												  &RootXIgnore, &RootYIgnore,
-												  &WinX, &WinY,
-												  &MaskIgnore);
-									GameState.MousePos.X = WinX;
-									GameState.MousePos.Y = WinY;
-
-									// Process Xbox controllers input.
-									if (NumControllers) {
-										if (NumControllers > CountOf(GameState.XboxControllers))
-											NumControllers = CountOf(GameState.XboxControllers);
-
-										for (u8 Index = 0; Index < NumControllers; Index++) {
-											u8 ControllerID = ControllerIDs[Index];
-											game_input_xbox_controller *Controller = &GameState.XboxControllers[Index];
-
-											Controller->IsConnected = true;
-
-											static struct js_event ControllerEvent;
-											while (read(ControllerFDs[Index], &ControllerEvent, sizeof(ControllerEvent)) > 0) {
-												if (ControllerEvent.type >= JS_EVENT_INIT)
-													ControllerEvent.type -= JS_EVENT_INIT;
-
-												if (ControllerEvent.type == JS_EVENT_BUTTON) {
-													if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_A) {
-														LinuxProcessXboxDigitalButton(&Controller->A, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_B) {
-														LinuxProcessXboxDigitalButton(&Controller->B, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_X) {
-														LinuxProcessXboxDigitalButton(&Controller->X, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_Y) {
-														LinuxProcessXboxDigitalButton(&Controller->Y, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_START) {
-														LinuxProcessXboxDigitalButton(&Controller->Start, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_BACK) {
-														LinuxProcessXboxDigitalButton(&Controller->Back, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_LEFT_SHOULDER) {
-														LinuxProcessXboxDigitalButton(&Controller->LeftBumper, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_RIGHT_SHOULDER) {
-														LinuxProcessXboxDigitalButton(&Controller->RightBumper, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_LEFT_THUMB) {
-														LinuxProcessXboxDigitalButton(&Controller->LeftStick, ControllerEvent.value);
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_BUTTON_RIGHT_THUMB) {
-														LinuxProcessXboxDigitalButton(&Controller->RightStick, ControllerEvent.value);
-													}
-												} else if (ControllerEvent.type == JS_EVENT_AXIS) {
-													if (ControllerEvent.number == XBOX_CONTROLLER_AXIS_LEFT_THUMB_X) {
-														Controller->LeftStickPos.X = LinuxProcessXboxStickValue(ControllerEvent.value, XBOX_CONTROLLER_DEADZONE);
-													} else if (ControllerEvent.number == XBOX_CONTROLLER_AXIS_LEFT_THUMB_Y) {
-														Controller->LeftStickPos.Y = LinuxProcessXboxStickValue(ControllerEvent.value, XBOX_CONTROLLER_DEADZONE);
-													} if (ControllerEvent.number == XBOX_CONTROLLER_AXIS_RIGHT_THUMB_X) {
-														Controller->RightStickPos.X = LinuxProcessXboxStickValue(ControllerEvent.value, XBOX_CONTROLLER_DEADZONE);
-													} else if (ControllerEvent.number == XBOX_CONTROLLER_AXIS_RIGHT_THUMB_Y) {
-														Controller->RightStickPos.Y = LinuxProcessXboxStickValue(ControllerEvent.value, XBOX_CONTROLLER_DEADZONE);
-													} else if (ControllerEvent.number == XBOX_CONTROLLER_AXIS_DPAD_HORZ) {
-														if (ControllerEvent.value == -32767) {
-															LinuxProcessXboxDigitalButton(&Controller->Left, 1);
-															LinuxProcessXboxDigitalButton(&Controller->Right, 0);
-														} else if (ControllerEvent.value == 32768) {
-															LinuxProcessXboxDigitalButton(&Controller->Left, 0);
-															LinuxProcessXboxDigitalButton(&Controller->Right, 1);
-														} else {
-															LinuxProcessXboxDigitalButton(&Controller->Left, 0);
-															LinuxProcessXboxDigitalButton(&Controller->Right, 0);
-														}
-													} else if (ControllerEvent.number = XBOX_CONTROLLER_AXIS_DPAD_VERT) {
-														if (ControllerEvent.value == -32767) {
-															LinuxProcessXboxDigitalButton(&Controller->Up, 1);
-															LinuxProcessXboxDigitalButton(&Controller->Down, 0);
-														} else if (ControllerEvent.value == 32768) {
-															LinuxProcessXboxDigitalButton(&Controller->Up, 0);
-															LinuxProcessXboxDigitalButton(&Controller->Down, 1);
-														} else {
-															LinuxProcessXboxDigitalButton(&Controller->Up, 0);
-															LinuxProcessXboxDigitalButton(&Controller->Down, 0);
-														}
-													}
-												}
-											}
-										}
-									}
+								// NOTE(ivan): Sample game controllers input.
+								LinuxProcessControllers();
 
-									// NOTE(ivan): Process linux-side input events.
-									if (GameState.KeyboardButtons[KeyCode_F4].IsDown &&
-										(GameState.KeyboardButtons[KeyCode_LeftAlt].IsDown || GameState.KeyboardButtons[KeyCode_RightAlt].IsDown))
-										PlatformQuit(0);
+								// NOTE(ivan): Process linux-side input events.
+								if (GameState.KeyboardButtons[KeyCode_F4].IsDown &&
+									(GameState.KeyboardButtons[KeyCode_LeftAlt].IsDown || GameState.KeyboardButtons[KeyCode_RightAlt].IsDown))
+									PlatformQuit(0);
 #if INTERNAL
-									if (IsNewlyPressed(&GameState.KeyboardButtons[KeyCode_F2]))
-										DebugCursor = !DebugCursor;
-#endif
+								if (IsNewlyPressed(&GameState.KeyboardButtons[KeyCode_F2])) {
+									DebugCursor = !DebugCursor;
 
 									// NOTE(ivan): Set debug cursor.
 									if (DebugCursor)
 										XUndefineCursor(LinuxState.XDisplay, W);
 									else
-										XDefineCursor(LinuxState.XDisplay, W, LinuxCreateNullCursor());
-
-									// NOTE(ivan): Prepare game video buffer.
-									GameState.VideoBuffer.Pixels = SecondaryVideoBuffer.Pixels;
-									GameState.VideoBuffer.Width = SecondaryVideoBuffer.Width;
-									GameState.VideoBuffer.Height = SecondaryVideoBuffer.Height;
-									GameState.VideoBuffer.BytesPerPixel = SecondaryVideoBuffer.BytesPerPixel;
-									GameState.VideoBuffer.Pitch = SecondaryVideoBuffer.Pitch;
+										XDefineCursor(LinuxState.XDisplay, W, NullCursor);
+								}
+#endif
 
-									GameUpdate(GameUpdateType_Frame);
+								// NOTE(ivan): Pick up changed files before the frame starts.
+								LinuxProcessWatchedFiles();
+								LinuxReloadChangedGameModule(&LinuxState.GameModule);
 
-									// NOTE(ivan): Before the next frame, reset the mouse wheel.
-									GameState.MouseWheel = 0;
-						
-									// NOTE(ivan): Before the next frame, make all input states obsolete.
-									for (u32 Index = 0; Index < CountOf(GameState.KeyboardButtons); Index++)
-										GameState.KeyboardButtons[Index].IsNew = false;
+								// NOTE(ivan): Prepare game video buffer, the render thread owns the pixels if there is one.
+								GameState.VideoBuffer.Pixels = LinuxState.Renderer.IsPipelined ? 0 : SecondaryVideoBuffer.Pixels;
+								GameState.VideoBuffer.Width = SecondaryVideoBuffer.Width;
+								GameState.VideoBuffer.Height = SecondaryVideoBuffer.Height;
+								GameState.VideoBuffer.BytesPerPixel = SecondaryVideoBuffer.BytesPerPixel;
+								GameState.VideoBuffer.Pitch = SecondaryVideoBuffer.Pitch;
 
-									for (u32 Index = 0; Index < CountOf(GameState.MouseButtons); Index++)
-										GameState.MouseButtons[Index].IsNew = false;
+								// NOTE(ivan): Record the input the game is about to see, or replace it with the recorded one.
+								if (!LinuxRecordOrPlaybackInput())
+									break;
 
-									for (u32 Index = 0; Index < CountOf(GameState.XboxControllers); Index++) {
-										game_input_xbox_controller *XboxController = &GameState.XboxControllers[Index];
+								// NOTE(ivan): Update, then render and present the frame, or hand it over to the render thread.
+								LinuxBeginRenderFrame();
+								RunFixedStepFrame(&LinuxState.FixedStep, LinuxState.GameModule.Update, &GameState, &GameTLState);
+								LinuxEndRenderFrame(GameState.FrameStats.FrameCount);
 
-										XboxController->Start.IsNew = false;
-										XboxController->Back.IsNew = false;
+								LinuxFinishFrameInput();
 
-										XboxController->A.IsNew = false;
-										XboxController->B.IsNew = false;
-										XboxController->X.IsNew = false;
-										XboxController->Y.IsNew = false;
+								// NOTE(ivan): Finish timings.
+								struct timespec WorkCounter = LinuxGetClock();
 
-										XboxController->Up.IsNew = false;
-										XboxController->Down.IsNew = false;
-										XboxController->Left.IsNew = false;
-										XboxController->Right.IsNew = false;
+								f64 SecondsElapsedForWork = LinuxGetSecondsElapsed(LastCounter, WorkCounter);
 
-										XboxController->LeftBumper.IsNew = false;
-										XboxController->RightBumper.IsNew = false;
+								b32 IsMissed = !LinuxWaitForNextFrame(&FramePacer);
+								GameState.FramesPerSecond = FramePacer.FramesPerSecond;
 
-										XboxController->LeftStick.IsNew = false;
-										XboxController->RightStick.IsNew = false;
-									}
+								struct timespec EndCounter = LinuxGetClock();
+								u64 EndCycleCounter = LinuxGetRDTSC();
 
-									// NOTE(ivan): Finish timings.
-									struct timespec WorkCounter = LinuxGetClock();
-
-									f64 TargetSecondsPerFrame = (f64)(1.0 / DisplayFrequency);
-									f64 SecondsElapsedForWork = LinuxGetSecondsElapsed(LastCounter, WorkCounter);
-									GameState.SecondsPerFrame = SecondsElapsedForWork;
-									GameState.FramesPerSecond = 0; // TODO(ivan): Implement me!
-									
-									if (SecondsElapsedForWork < TargetSecondsPerFrame) {
-										f64 SecondsToSleep = TargetSecondsPerFrame - SecondsElapsedForWork;
-										u32 SleepMS = (u32)(1000 * SecondsToSleep);
-										if (SleepMS > 0) {
-											usleep(SleepMS);
-											SecondsElapsedForWork += SecondsToSleep;
-										}
-									} else {
-										// NOTE(ivan): Missing framerate!
-									}
+								AddFrameStats(&GameState.FrameStats, SecondsElapsedForWork,
+											  LinuxGetSecondsElapsed(WorkCounter, EndCounter),
+											  LinuxGetSecondsElapsed(LastCounter, EndCounter), IsMissed);
 
-									struct timespec EndCounter = LinuxGetClock();
-									u64 EndCycleCounter = LinuxGetRDTSC();
+								GameState.SecondsPerFrame = LinuxGetSecondsElapsed(LastCounter, EndCounter);
+								GameState.CyclesPerFrame = (f64)(EndCycleCounter - LastCycleCounter);
+	
+								LastCounter = EndCounter;
+								LastCycleCounter = EndCycleCounter;
+							}
 
-									GameState.CyclesPerFrame = ((f64)(EndCycleCounter - LastCycleCounter) / (1000.0 * 1000.0));
-		
-									LastCounter = EndCounter;
-									LastCycleCounter = EndCycleCounter;
-								}
+							LinuxStopRenderer();
+							LinuxState.GameModule.Update(GameUpdateType_Release, &GameState, &GameTLState);
 
-								GameUpdate(GameUpdateType_Release);
-							}
+							XFreeCursor(LinuxState.XDisplay, NullCursor);
+							LinuxShutdownControllers();
 						} else {
 							DEBUGPlatformOutf("XkbSetDetectanbleAutoRepeat() failed!");
 						}
 
-						munmap(GameState.Hunk.Base, GameState.Hunk.Size);
+						LinuxFreeHunk();
 					} else {
 						DEBUGPlatformOutf("Could not allocate enough hunk memory!");
 					}
@@ -986,6 +3065,13 @@ main(int ArgC, char **ArgV) {
 	} else {
 		DEBUGPlatformOutf("X not responding!");
 	}
+
+	LinuxEndInputRecordingAndPlayback();
+	LinuxUnloadGameModule(&LinuxState.GameModule);
+	LinuxStopWorkers();
+
+	if (LinuxState.INotifyFD != -1)
+		close(LinuxState.INotifyFD);
 	
 	return LinuxState.QuitCode;
 }
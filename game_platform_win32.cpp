@@ -8,6 +8,9 @@
 #include "game.h"
 #include "game_misc.h"
 #include "game_math.h"
+#include "game_job.h"
+#include "game_record.h"
+#include "game_step.h"
 
 // NOTE(ivan): Win32 API versions definitions.
 #include <sdkddkver.h>
@@ -95,6 +98,13 @@ struct win32_video_buffer {
 	s32 Pitch;
 };
 
+// NOTE(ivan): Win32 watched file.
+struct win32_watched_file {
+	b32 IsUsed;
+	FILETIME LastWriteTime;
+	char FileName[MAX_PATH];
+};
+
 // NOTE(ivan): Win32 global variables.
 static struct {
 	s32 ArgC;
@@ -112,9 +122,40 @@ static struct {
 	char ExecutablePath[2048];
 
 	win32_video_buffer SecondaryVideoBuffer;
+
+	win32_watched_file WatchedFiles[256];
+
+	// NOTE(ivan): Job system and its workers, idle workers sleep on the semaphore.
+	job_system Jobs;
+	HANDLE WorkSemaphore;
+	volatile b32 AreWorkersQuitting;
+	u32 WorkerCount;
+	HANDLE Workers[MAX_WORKER_THREADS];
+	u8 *ThreadMemory; // NOTE(ivan): THREAD_MEMORY_SIZE for every thread of the job system.
+
+	cpu_layout CpuLayout;
+	b32 IsAffinityEnabled;
+
+	u64 TscCyclesPerSecond;
+	f64 TscNanosecondsPerCycle;
+
+	// NOTE(ivan): Input recording and playback, see game_record.h.
+	HANDLE InputRecordFile; // NOTE(ivan): INVALID_HANDLE_VALUE if not recording.
+	input_recorder InputRecorder;
+	b32 IsPlayingBack;
+	input_player InputPlayer;
+
+	fixed_step FixedStep;
+
+	render_commands RenderCommands;
+
+#if INTERNAL
+	ticket_mutex DebugOutputMutex; // NOTE(ivan): Keeps lines printed by different threads whole.
+#endif
 } Win32State;
 static game_state GameState;
-static thread_local game_tl_state GameTLState;
+thread_local game_tl_state GameTLState;
+static thread_local s32 Win32JobWorkerIndex = -1; // NOTE(ivan): Deque owned by this thread, -1 if none.
 
 static void
 Win32SetThreadName(DWORD Id, LPCSTR Name) {
@@ -147,6 +188,60 @@ Win32GetSecondsElapsed(u64 Start, u64 End) {
 	return (f64)(Diff / (f64)Win32State.PerformanceFrequency);
 }
 
+// NOTE(ivan): Reads the TSC and the performance counter as close together as possible, the pair with the shortest TSC window wins.
+static void
+Win32SampleTscAndClock(u64 *Tsc, u64 *Clock) {
+	Assert(Tsc);
+	Assert(Clock);
+
+	u64 BestWindow = (u64)-1;
+	for (u32 Try = 0; Try < 8; Try++) {
+		u64 Before = __rdtsc();
+		u64 Counter = Win32GetClock();
+		u64 After = __rdtsc();
+		if ((After - Before) < BestWindow) {
+			BestWindow = After - Before;
+			*Tsc = Before + ((After - Before) / 2);
+			*Clock = Counter;
+		}
+	}
+}
+
+// NOTE(ivan): CPUID leaf 0x15 when the CPU enumerates its crystal clock, otherwise measured against the performance counter.
+static void
+Win32CalibrateTsc(void) {
+	b32 IsInvariant;
+	u64 CyclesPerSecond = GetCpuidTscFrequency(&IsInvariant);
+	b32 IsFromCpuid = (CyclesPerSecond != 0);
+
+	if (!IsFromCpuid) {
+		u64 StartTsc, StartClock;
+		Win32SampleTscAndClock(&StartTsc, &StartClock);
+		Sleep(50);
+		u64 EndTsc, EndClock;
+		Win32SampleTscAndClock(&EndTsc, &EndClock);
+
+		CyclesPerSecond = (u64)((f64)(EndTsc - StartTsc) / Win32GetSecondsElapsed(StartClock, EndClock));
+	}
+
+	Win32State.TscCyclesPerSecond = Max(CyclesPerSecond, (u64)1);
+	Win32State.TscNanosecondsPerCycle = 1e9 / (f64)Win32State.TscCyclesPerSecond;
+
+	DEBUGPlatformOutf("TSC: %.3fMHz (%s), %s", (f64)Win32State.TscCyclesPerSecond / 1000000.0,
+					  IsFromCpuid ? "CPUID" : "measured",
+					  IsInvariant ? "invariant" : "NOT invariant, timings may drift");
+}
+
+u64
+PlatformGetCyclesPerSecond(void) {
+	return Win32State.TscCyclesPerSecond;
+}
+
+f64
+PlatformGetNanosecondsPerCycle(void) {
+	return Win32State.TscNanosecondsPerCycle;
+}
+
 X_INPUT_GET_STATE(Win32XInputGetStateStub) {
 	UnusedParam(UserIndex);
 	UnusedParam(State);
@@ -168,6 +263,14 @@ Win32ProcessKeyboardOrMouseButton(game_input_button *Button, b32 IsDown) {
 	Button->IsNew = true;
 }
 
+inline void
+Win32ProcessMouseButton(u32 Index, b32 IsDown, u32 Time) {
+	Assert(Index < CountOf(GameState.MouseButtons));
+
+	Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[Index], IsDown);
+	PushInputEvent(&GameState.InputEvents, GameInputEvent_MouseButton, Index, IsDown, Time);
+}
+
 inline void
 Win32ProcessXInputDigitalButton(game_input_button *Button, DWORD XInputButtonState, DWORD ButtonBit) {
 	Assert(Button);
@@ -522,6 +625,7 @@ Win32WindowProc(HWND Window, UINT Msg, WPARAM W, LPARAM L) {
 		GetRawInputData((HRAWINPUT)L, RID_INPUT, Buffer, &BufferSize, sizeof(RAWINPUTHEADER));
 
 		RAWINPUT *RawInput = (RAWINPUT *)Buffer;
+		u32 Time = (u32)GetMessageTime();
 		if (RawInput->header.dwType == RIM_TYPEKEYBOARD) {
 			RAWKEYBOARD *RawKeyboard = &RawInput->data.keyboard;
 
@@ -530,7 +634,11 @@ Win32WindowProc(HWND Window, UINT Msg, WPARAM W, LPARAM L) {
 									(RawKeyboard->Flags & RI_KEY_E0) != 0,
 									(RawKeyboard->Flags & RI_KEY_E1) != 0,
 									&KeyCode))
-				Win32ProcessKeyboardOrMouseButton(&GameState.KeyboardButtons[KeyCode], (RawKeyboard->Flags & RI_KEY_BREAK) == 0);
+			{
+				b32 IsDown = ((RawKeyboard->Flags & RI_KEY_BREAK) == 0);
+				Win32ProcessKeyboardOrMouseButton(&GameState.KeyboardButtons[KeyCode], IsDown);
+				PushInputEvent(&GameState.InputEvents, GameInputEvent_Key, KeyCode, IsDown, Time);
+			}
 		} else if (RawInput->header.dwType == RIM_TYPEMOUSE) {
 			RAWMOUSE *RawMouse = &RawInput->data.mouse;
 
@@ -539,46 +647,28 @@ Win32WindowProc(HWND Window, UINT Msg, WPARAM W, LPARAM L) {
 				GameState.MousePos.Y = RawMouse->lLastY;
 			}
 
-			switch (RawMouse->usButtonFlags) {
-			case RI_MOUSE_BUTTON_1_DOWN: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[0], true);
-			} break;
-			case RI_MOUSE_BUTTON_1_UP: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[0], false);
-			} break;
-
-			case RI_MOUSE_BUTTON_2_DOWN: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[1], true);
-			} break;
-			case RI_MOUSE_BUTTON_2_UP: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[1], false);
-			} break;
-
-			case RI_MOUSE_BUTTON_3_DOWN: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[2], true);
-			} break;
-			case RI_MOUSE_BUTTON_3_UP: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[2], false);
-			} break;
-
-			case RI_MOUSE_BUTTON_4_DOWN: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[3], true);
-			} break;
-			case RI_MOUSE_BUTTON_4_UP: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[3], false);
-			} break;
-
-			case RI_MOUSE_BUTTON_5_DOWN: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[4], true);
-			} break;
-			case RI_MOUSE_BUTTON_5_UP: {
-				Win32ProcessKeyboardOrMouseButton(&GameState.MouseButtons[4], false);
-			} break;
-
-			case RI_MOUSE_WHEEL: {
-				s32 WheelRotations = (s32)RawMouse->usButtonData / WHEEL_DELTA;
+			// NOTE(ivan): One message may carry several button transitions at once, check every flag.
+			static const USHORT ButtonFlags[][2] = {
+				{RI_MOUSE_BUTTON_1_DOWN, RI_MOUSE_BUTTON_1_UP},
+				{RI_MOUSE_BUTTON_2_DOWN, RI_MOUSE_BUTTON_2_UP},
+				{RI_MOUSE_BUTTON_3_DOWN, RI_MOUSE_BUTTON_3_UP},
+				{RI_MOUSE_BUTTON_4_DOWN, RI_MOUSE_BUTTON_4_UP},
+				{RI_MOUSE_BUTTON_5_DOWN, RI_MOUSE_BUTTON_5_UP}
+			};
+			static_assert(CountOf(ButtonFlags) == CountOf(GameState.MouseButtons), "Mouse button flags are out of date!");
+
+			for (u32 Index = 0; Index < CountOf(ButtonFlags); Index++) {
+				if (RawMouse->usButtonFlags & ButtonFlags[Index][0])
+					Win32ProcessMouseButton(Index, true, Time);
+				if (RawMouse->usButtonFlags & ButtonFlags[Index][1])
+					Win32ProcessMouseButton(Index, false, Time);
+			}
+
+			if (RawMouse->usButtonFlags & RI_MOUSE_WHEEL) {
+				// NOTE(ivan): The wheel delta is signed, scrolling down comes as a negative one.
+				s32 WheelRotations = (s32)(SHORT)RawMouse->usButtonData / WHEEL_DELTA;
 				GameState.MouseWheel += WheelRotations;
-			} break;
+				PushInputEvent(&GameState.InputEvents, GameInputEvent_MouseWheel, 0, WheelRotations, Time);
 			}
 		}
 	} break;
@@ -613,9 +703,11 @@ DEBUGPlatformOutf(const char *Format, ...) {
 		vsnprintf(Buffer, CountOf(Buffer) - 1, Format, ArgList);
 		va_end(ArgList);
 
+		EnterTicketMutex(&Win32State.DebugOutputMutex);
 		OutputDebugStringA("## ");
 		OutputDebugStringA(Buffer);
 		OutputDebugStringA("\r\n");
+		LeaveTicketMutex(&Win32State.DebugOutputMutex);
 	}
 }
 #endif
@@ -702,7 +794,7 @@ PlatformWriteEntireFile(const char *FileName, void *Base, uptr Size) {
 							  CREATE_ALWAYS,
 							  FILE_ATTRIBUTE_NORMAL,
 							  0);
-	if (File == INVALID_HANDLE_VALUE) {
+	if (File != INVALID_HANDLE_VALUE) {
 		DWORD Unused;
 		if (WriteFile(File, Base, SafeTruncateU64(Size), &Unused, 0)) {
 			Result = true;
@@ -724,6 +816,561 @@ PlatformFreeEntireFilePiece(piece *Piece) {
 	VirtualFree(Piece->Base, 0, MEM_RELEASE);
 }
 
+piece
+PlatformMapEntireFile(const char *FileName) {
+	Assert(FileName);
+
+	piece Result = {};
+
+	HANDLE File = CreateFileA(FileName,
+							  GENERIC_READ,
+							  FILE_SHARE_READ,
+							  0,
+							  OPEN_EXISTING,
+							  FILE_FLAG_RANDOM_ACCESS,
+							  0);
+	if (File != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER FileSize64;
+		if (GetFileSizeEx(File, &FileSize64) && FileSize64.QuadPart) {
+			HANDLE Mapping = CreateFileMappingA(File, 0, PAGE_READONLY, 0, 0, 0);
+			if (Mapping) {
+				Result.Base = (u8 *)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+				if (Result.Base)
+					Result.Size = (uptr)FileSize64.QuadPart;
+
+				// NOTE(ivan): The view holds its own reference to the mapping.
+				CloseHandle(Mapping);
+			}
+		}
+
+		CloseHandle(File);
+	}
+
+	return Result;
+}
+
+void
+PlatformUnmapEntireFile(piece *Piece) {
+	Assert(Piece);
+	Assert(Piece->Base);
+
+	UnmapViewOfFile(Piece->Base);
+	Piece->Base = 0;
+	Piece->Size = 0;
+}
+
+static b32
+Win32EnumerateFiles(const char *DirName, char *RelativeName, uptr RelativeLength,
+					platform_enumerate_files_callback *Callback, void *Param) {
+	char Pattern[MAX_PATH];
+	if (RelativeLength)
+		snprintf(Pattern, CountOf(Pattern), "%s\\%s\\*", DirName, RelativeName);
+	else
+		snprintf(Pattern, CountOf(Pattern), "%s\\*", DirName);
+
+	WIN32_FIND_DATAA FindData;
+	HANDLE Find = FindFirstFileA(Pattern, &FindData);
+	if (Find == INVALID_HANDLE_VALUE)
+		return false;
+
+	do {
+		if ((strcmp(FindData.cFileName, ".") == 0) || (strcmp(FindData.cFileName, "..") == 0))
+			continue;
+
+		uptr NameLength = strlen(FindData.cFileName);
+		if ((RelativeLength + NameLength + 2) > MAX_PATH)
+			continue;
+
+		uptr NewLength = RelativeLength;
+		if (NewLength)
+			RelativeName[NewLength++] = '/';
+		memcpy(RelativeName + NewLength, FindData.cFileName, NameLength + 1);
+		NewLength += NameLength;
+
+		if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			Win32EnumerateFiles(DirName, RelativeName, NewLength, Callback, Param);
+		else
+			Callback(RelativeName, ((uptr)FindData.nFileSizeHigh << 32) | FindData.nFileSizeLow, Param);
+
+		RelativeName[RelativeLength] = 0;
+	} while (FindNextFileA(Find, &FindData));
+
+	FindClose(Find);
+	return true;
+}
+
+b32
+PlatformEnumerateFiles(const char *DirName, platform_enumerate_files_callback *Callback, void *Param) {
+	Assert(DirName);
+	Assert(Callback);
+
+	char RelativeName[MAX_PATH] = {};
+	return Win32EnumerateFiles(DirName, RelativeName, 0, Callback, Param);
+}
+
+void
+PlatformWaitOnAddress(volatile u32 *Address, u32 Expected) {
+	Assert(Address);
+	WaitOnAddress(Address, &Expected, sizeof(Expected), INFINITE);
+}
+
+void
+PlatformWakeAllOnAddress(volatile u32 *Address) {
+	Assert(Address);
+	WakeByAddressAll((void *)Address);
+}
+
+static DWORD WINAPI
+Win32WorkerThreadProc(LPVOID Param) {
+	Win32JobWorkerIndex = (s32)(uptr)Param;
+	InitializeThreadState(&GameTLState, Win32JobWorkerIndex,
+						  Win32State.ThreadMemory + ((uptr)Win32JobWorkerIndex * THREAD_MEMORY_SIZE));
+
+	job_system *System = &Win32State.Jobs;
+	job_worker *Worker = &System->Workers[Win32JobWorkerIndex];
+	while (!Win32State.AreWorkersQuitting) {
+		job Job;
+		if (GetNextJob(System, Win32JobWorkerIndex, &Job)) {
+			RunJob(System, Win32JobWorkerIndex, &Job);
+			continue;
+		}
+
+		// NOTE(ivan): New jobs often come right away, spin for a while before going to sleep.
+		u64 IdleStart = __rdtsc();
+		b32 IsFound = false;
+		for (u32 Spin = 0; !IsFound && (Spin < JOB_IDLE_SPIN_COUNT); Spin++) {
+			YieldProcessor();
+			IsFound = GetNextJob(System, Win32JobWorkerIndex, &Job);
+		}
+
+		if (!IsFound) {
+			// NOTE(ivan): Announce the sleep before the last look, see GetJobWakeCount().
+			AtomicIncrementU32(&System->SleepingCount);
+			IsFound = GetNextJob(System, Win32JobWorkerIndex, &Job);
+			if (!IsFound) {
+				Worker->Stats.SleepCount++;
+				WaitForSingleObjectEx(Win32State.WorkSemaphore, INFINITE, FALSE);
+			}
+			AtomicDecrementU32(&System->SleepingCount);
+		}
+
+		Worker->Stats.IdleCycles += (__rdtsc() - IdleStart);
+		if (IsFound)
+			RunJob(System, Win32JobWorkerIndex, &Job);
+	}
+
+	return 0;
+}
+
+inline void
+Win32WakeWorkers(u32 JobCount) {
+	u32 WakeCount = GetJobWakeCount(&Win32State.Jobs, JobCount);
+	if (WakeCount)
+		ReleaseSemaphore(Win32State.WorkSemaphore, WakeCount, 0);
+}
+
+// NOTE(ivan): Only the processor group the process starts in is looked at, that is up to 64 logical CPUs.
+static void
+Win32DetectCpuLayout(cpu_layout *Layout) {
+	Assert(Layout);
+
+	*Layout = {};
+
+	DWORD_PTR ProcessMask = 0, SystemMask = 0;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &ProcessMask, &SystemMask))
+		return;
+	for (u32 Cpu = 0; Cpu < (sizeof(DWORD_PTR) * 8); Cpu++) {
+		if (ProcessMask & ((DWORD_PTR)1 << Cpu))
+			Layout->IsAllowed[Cpu] = true;
+	}
+
+	// NOTE(ivan): Isolation lists, "-cpus" keeps only the listed CPUs, "-excludecpus" leaves the listed ones alone.
+	const char *ParamCpus = PlatformCheckParamValue("-cpus");
+	if (ParamCpus) {
+		u8 Listed[MAX_CPUS] = {};
+		if (ParseCpuList(ParamCpus, Listed)) {
+			for (u32 Cpu = 0; Cpu < MAX_CPUS; Cpu++)
+				Layout->IsAllowed[Cpu] = Layout->IsAllowed[Cpu] && Listed[Cpu];
+		} else {
+			DEBUGPlatformOutf("Malformed -cpus list ignored: %s", ParamCpus);
+		}
+	}
+	const char *ParamExcludeCpus = PlatformCheckParamValue("-excludecpus");
+	if (ParamExcludeCpus) {
+		u8 Listed[MAX_CPUS] = {};
+		if (ParseCpuList(ParamExcludeCpus, Listed)) {
+			for (u32 Cpu = 0; Cpu < MAX_CPUS; Cpu++)
+				Layout->IsAllowed[Cpu] = Layout->IsAllowed[Cpu] && !Listed[Cpu];
+		} else {
+			DEBUGPlatformOutf("Malformed -excludecpus list ignored: %s", ParamExcludeCpus);
+		}
+	}
+
+	for (u32 Cpu = 0; Cpu < MAX_CPUS; Cpu++) {
+		if (Layout->IsAllowed[Cpu])
+			Layout->CpuCount++;
+	}
+
+	// NOTE(ivan): One entry per physical core, its mask holds the SMT siblings.
+	SYSTEM_LOGICAL_PROCESSOR_INFORMATION Infos[MAX_CPUS];
+	DWORD InfosSize = sizeof(Infos);
+	if (GetLogicalProcessorInformation(Infos, &InfosSize)) {
+		u32 InfoCount = InfosSize / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+		for (u32 Index = 0; Index < InfoCount; Index++) {
+			if (Infos[Index].Relationship != RelationProcessorCore)
+				continue;
+
+			for (u32 Cpu = 0; Cpu < (sizeof(ULONG_PTR) * 8); Cpu++) {
+				if ((Infos[Index].ProcessorMask & ((ULONG_PTR)1 << Cpu)) && Layout->IsAllowed[Cpu]) {
+					Layout->CoreCpus[Layout->CoreCount++] = (u16)Cpu;
+					break;
+				}
+			}
+		}
+	} else {
+		// NOTE(ivan): No topology, every CPU is a core of its own.
+		for (u32 Cpu = 0; Cpu < MAX_CPUS; Cpu++) {
+			if (Layout->IsAllowed[Cpu])
+				Layout->CoreCpus[Layout->CoreCount++] = (u16)Cpu;
+		}
+	}
+}
+
+// NOTE(ivan): Pins a thread of the job system to its own core, or keeps it inside the allowed CPUs if it has none.
+static void
+Win32SetThreadAffinity(HANDLE Thread, u32 ThreadIndex) {
+	cpu_layout *Layout = &Win32State.CpuLayout;
+
+	DWORD_PTR Mask = 0;
+	s32 Cpu = GetThreadCpu(Layout, ThreadIndex);
+	if (Cpu != -1) {
+		Mask = (DWORD_PTR)1 << Cpu;
+	} else {
+		for (u32 Index = 0; Index < (sizeof(DWORD_PTR) * 8); Index++) {
+			if (Layout->IsAllowed[Index])
+				Mask |= ((DWORD_PTR)1 << Index);
+		}
+	}
+
+	if (SetThreadAffinityMask(Thread, Mask)) {
+		if (Cpu != -1)
+			DEBUGPlatformOutf("Thread %u pinned to CPU %d.", ThreadIndex, Cpu);
+		else
+			DEBUGPlatformOutf("Thread %u has no core of its own, runs on any allowed CPU.", ThreadIndex);
+	} else {
+		DEBUGPlatformOutf("Thread %u could not be pinned.", ThreadIndex);
+	}
+}
+
+static void
+Win32StartWorkers(void) {
+	InitializeJobSystem(&Win32State.Jobs);
+	Win32JobWorkerIndex = 0; // NOTE(ivan): Primary thread.
+
+	Win32DetectCpuLayout(&Win32State.CpuLayout);
+	Win32State.IsAffinityEnabled = ((PlatformCheckParam("-noaffinity") == PARAM_MISSING) && Win32State.CpuLayout.CoreCount);
+	DEBUGPlatformOutf("CPU layout: %u logical CPUs allowed, %u physical cores, affinity %s.",
+					  Win32State.CpuLayout.CpuCount, Win32State.CpuLayout.CoreCount,
+					  Win32State.IsAffinityEnabled ? "on" : "off");
+
+	// NOTE(ivan): One thread per physical core, the primary thread takes one of them.
+	SYSTEM_INFO SystemInfo;
+	GetSystemInfo(&SystemInfo);
+	s32 WorkerCount = (s32)SystemInfo.dwNumberOfProcessors - 1;
+	if (Win32State.CpuLayout.CoreCount)
+		WorkerCount = (s32)Win32State.CpuLayout.CoreCount - 1;
+	const char *ParamWorkers = PlatformCheckParamValue("-workers");
+	if (ParamWorkers)
+		WorkerCount = atoi(ParamWorkers);
+	WorkerCount = Min(Max(WorkerCount, 0), (s32)MAX_WORKER_THREADS);
+
+	// NOTE(ivan): Thread memory of all threads in one go, pages are only touched when used.
+	Win32State.ThreadMemory = (u8 *)VirtualAlloc(0, (uptr)(WorkerCount + 1) * THREAD_MEMORY_SIZE,
+												 MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+	InitializeThreadState(&GameTLState, 0, Win32State.ThreadMemory);
+	GameState.ThreadCount = 1;
+	GameState.ProfileRings[0] = GameTLState.ProfileRing;
+
+	if (Win32State.IsAffinityEnabled)
+		Win32SetThreadAffinity(GetCurrentThread(), 0);
+
+	if (!Win32State.ThreadMemory) {
+		DEBUGPlatformOutf("Could not allocate thread memory, running without worker threads.");
+		return;
+	}
+
+	Win32State.WorkSemaphore = CreateSemaphoreExA(0, 0, LONG_MAX, 0, 0, SEMAPHORE_ALL_ACCESS);
+	if (!Win32State.WorkSemaphore) {
+		DEBUGPlatformOutf("CreateSemaphoreEx() failed, running without worker threads.");
+		return;
+	}
+
+	// NOTE(ivan): Rings are published before the workers exist, the workers set them up themselves.
+	for (s32 Index = 1; Index <= WorkerCount; Index++)
+		GameState.ProfileRings[Index] = (profile_ring *)(Win32State.ThreadMemory + ((uptr)Index * THREAD_MEMORY_SIZE));
+
+	// NOTE(ivan): Thieves look at every deque up to ThreadCount, set it before any worker runs.
+	Win32State.Jobs.ThreadCount = (u32)WorkerCount + 1;
+	for (s32 Index = 0; Index < WorkerCount; Index++) {
+		DWORD ThreadId;
+		HANDLE Thread = CreateThread(0, 0, Win32WorkerThreadProc, (LPVOID)(uptr)(Index + 1), 0, &ThreadId);
+		if (!Thread)
+			break;
+
+		char ThreadName[32];
+		snprintf(ThreadName, CountOf(ThreadName), GAMENAME " Worker %d", Index + 1);
+		Win32SetThreadName(ThreadId, ThreadName);
+		if (Win32State.IsAffinityEnabled)
+			Win32SetThreadAffinity(Thread, Index + 1);
+
+		Win32State.Workers[Win32State.WorkerCount++] = Thread;
+	}
+	Win32State.Jobs.ThreadCount = Win32State.WorkerCount + 1;
+	GameState.ThreadCount = Win32State.Jobs.ThreadCount;
+
+	DEBUGPlatformOutf("Worker threads: %u", Win32State.WorkerCount);
+}
+
+static void
+Win32StopWorkers(void) {
+	PlatformCompleteAllWork();
+
+	if (Win32State.WorkSemaphore) {
+		Win32State.AreWorkersQuitting = true;
+		if (Win32State.WorkerCount)
+			ReleaseSemaphore(Win32State.WorkSemaphore, Win32State.WorkerCount, 0);
+		for (u32 Index = 0; Index < Win32State.WorkerCount; Index++) {
+			WaitForSingleObject(Win32State.Workers[Index], INFINITE);
+			CloseHandle(Win32State.Workers[Index]);
+		}
+
+#if INTERNAL
+		for (u32 Index = 0; Index < Win32State.Jobs.ThreadCount; Index++) {
+			job_worker_stats *Stats = &Win32State.Jobs.Workers[Index].Stats;
+			DEBUGPlatformOutf("Jobs thread %u: executed %llu, stolen %llu/%llu, idle %.1fms, slept %llu times",
+							  Index, Stats->JobsExecuted, Stats->JobsStolen, Stats->StealAttempts,
+							  CyclesToNanoseconds(Stats->IdleCycles) / 1000000.0, Stats->SleepCount);
+		}
+		DEBUGOutputTicketMutexStats("debug output", &Win32State.DebugOutputMutex);
+#endif
+
+		Win32State.WorkerCount = 0;
+		Win32State.Jobs.ThreadCount = 1;
+		CloseHandle(Win32State.WorkSemaphore);
+	}
+
+	GameState.ThreadCount = 0;
+	GameTLState.ProfileRing = 0;
+	GameTLState.ScratchHeap = {};
+	if (Win32State.ThreadMemory)
+		VirtualFree(Win32State.ThreadMemory, 0, MEM_RELEASE);
+	Win32State.ThreadMemory = 0;
+}
+
+void
+PlatformAddWorkQueueEntry(platform_work_queue_callback *Callback, void *Data) {
+	Assert(Callback);
+
+	job Job;
+	Job.Callback = Callback;
+	Job.Data = Data;
+	Job.Counter = &Win32State.Jobs.AllWork;
+
+	// NOTE(ivan): Counted before it is visible, so PlatformCompleteAllWork() can never see it done too early.
+	AtomicIncrementU32(&Win32State.Jobs.AllWork.Value);
+
+	// NOTE(ivan): The ring is full, help draining it instead of blocking.
+	while (!PushWorkQueueEntry(&Win32State.Jobs.Queue, &Job)) {
+		job OtherJob;
+		if (GetNextJob(&Win32State.Jobs, Win32JobWorkerIndex, &OtherJob))
+			RunJob(&Win32State.Jobs, Win32JobWorkerIndex, &OtherJob);
+		else
+			YieldProcessor();
+	}
+
+	Win32WakeWorkers(1);
+}
+
+void
+PlatformCompleteAllWork(void) {
+	WaitForJobCounter(&Win32State.Jobs, Win32JobWorkerIndex, &Win32State.Jobs.AllWork);
+}
+
+u32
+PlatformGetWorkerCount(void) {
+	return Win32State.WorkerCount;
+}
+
+void
+PlatformRunJobs(job *Jobs, u32 Count, job_counter *Counter) {
+	Assert(Jobs);
+	Assert(Counter);
+
+	AtomicAddU32(&Counter->Value, Count);
+	for (u32 Index = 0; Index < Count; Index++) {
+		Jobs[Index].Counter = Counter;
+		PushJob(&Win32State.Jobs, Win32JobWorkerIndex, &Jobs[Index]);
+	}
+
+	Win32WakeWorkers(Count);
+}
+
+void
+PlatformWaitForCounter(job_counter *Counter) {
+	Assert(Counter);
+	WaitForJobCounter(&Win32State.Jobs, Win32JobWorkerIndex, Counter);
+}
+
+u32
+PlatformGetJobStats(job_worker_stats *Stats, u32 MaxCount) {
+	Assert(Stats);
+
+	u32 Result = Min(MaxCount, Win32State.Jobs.ThreadCount);
+	for (u32 Index = 0; Index < Result; Index++)
+		Stats[Index] = Win32State.Jobs.Workers[Index].Stats;
+
+	return Result;
+}
+
+inline FILETIME
+Win32GetLastWriteTime(const char *FileName) {
+	Assert(FileName);
+
+	FILETIME Result = {};
+
+	WIN32_FILE_ATTRIBUTE_DATA Data;
+	if (GetFileAttributesExA(FileName, GetFileExInfoStandard, &Data))
+		Result = Data.ftLastWriteTime;
+
+	return Result;
+}
+
+s32
+PlatformWatchFile(const char *FileName) {
+	Assert(FileName);
+
+	for (s32 Index = 0; Index < (s32)CountOf(Win32State.WatchedFiles); Index++) {
+		win32_watched_file *File = &Win32State.WatchedFiles[Index];
+		if (!File->IsUsed) {
+			File->IsUsed = true;
+			strncpy(File->FileName, FileName, CountOf(File->FileName) - 1);
+			File->LastWriteTime = Win32GetLastWriteTime(FileName);
+
+			return Index;
+		}
+	}
+
+	return FILE_WATCH_INVALID;
+}
+
+void
+PlatformUnwatchFile(s32 Watch) {
+	Assert(Watch >= 0 && Watch < (s32)CountOf(Win32State.WatchedFiles));
+	Assert(Win32State.WatchedFiles[Watch].IsUsed);
+
+	Win32State.WatchedFiles[Watch].IsUsed = false;
+}
+
+b32
+PlatformIsFileChanged(s32 Watch) {
+	Assert(Watch >= 0 && Watch < (s32)CountOf(Win32State.WatchedFiles));
+
+	win32_watched_file *File = &Win32State.WatchedFiles[Watch];
+	Assert(File->IsUsed);
+
+	// NOTE(ivan): The file time is polled, one GetFileAttributesExA() per watched file per frame, on purpose.
+	// It is a cached metadata lookup, cheap at the few hundred watches there can be, and it follows editors
+	// that save by renaming a temporary file over the original, with no directory handles or overlapped reads to keep.
+	FILETIME LastWriteTime = Win32GetLastWriteTime(File->FileName);
+	if (CompareFileTime(&LastWriteTime, &File->LastWriteTime) != 0) {
+		File->LastWriteTime = LastWriteTime;
+		return true;
+	}
+
+	return false;
+}
+
+// NOTE(ivan): Input recording ("-record <file>") and playback ("-playback <file>"), both may run at once.
+static void
+Win32BeginInputRecordingAndPlayback(void) {
+	Win32State.InputRecordFile = INVALID_HANDLE_VALUE;
+
+	const char *ParamRecord = PlatformCheckParamValue("-record");
+	if (ParamRecord) {
+		Win32State.InputRecordFile = CreateFileA(ParamRecord, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+		if (Win32State.InputRecordFile != INVALID_HANDLE_VALUE) {
+			BeginInputRecording(&Win32State.InputRecorder);
+			DEBUGPlatformOutf("Recording input to %s", ParamRecord);
+		} else {
+			DEBUGPlatformOutf("Could not create input recording %s!", ParamRecord);
+		}
+	}
+
+	const char *ParamPlayback = PlatformCheckParamValue("-playback");
+	if (ParamPlayback) {
+		Win32State.IsPlayingBack = BeginInputPlayback(&Win32State.InputPlayer, ParamPlayback);
+		if (Win32State.IsPlayingBack)
+			DEBUGPlatformOutf("Playing input back from %s", ParamPlayback);
+		else
+			DEBUGPlatformOutf("Input recording %s is missing or was made by an incompatible build!", ParamPlayback);
+	}
+}
+
+static void
+Win32FlushInputRecording(void) {
+	input_recorder *Recorder = &Win32State.InputRecorder;
+
+	DWORD Written;
+	if (!WriteFile(Win32State.InputRecordFile, Recorder->Buffer, (DWORD)Recorder->BufferUsed, &Written, 0) ||
+		(Written != Recorder->BufferUsed)) {
+		DEBUGPlatformOutf("Failed writing input recording, recording stopped!");
+		CloseHandle(Win32State.InputRecordFile);
+		Win32State.InputRecordFile = INVALID_HANDLE_VALUE;
+	}
+
+	Recorder->BufferUsed = 0;
+}
+
+// NOTE(ivan): Right before the game update: record the input the game is about to see, or replace it with the recorded one.
+// Returns false once the playback is over, the session ends there, before the frame the recording does not cover.
+static b32
+Win32RecordOrPlaybackInput(void) {
+	if (Win32State.IsPlayingBack) {
+		if (!PlayInputFrame(&Win32State.InputPlayer, &GameState)) {
+			DEBUGPlatformOutf("Input playback %s after %u frames.",
+							  Win32State.InputPlayer.IsCorrupted ? "stopped at corrupt data" : "finished",
+							  Win32State.InputPlayer.FrameCount);
+			PlatformQuit(0);
+			return false;
+		}
+	}
+
+	if (Win32State.InputRecordFile != INVALID_HANDLE_VALUE) {
+		if (RecordInputFrame(&Win32State.InputRecorder, &GameState))
+			Win32FlushInputRecording();
+	}
+
+	return true;
+}
+
+static void
+Win32EndInputRecordingAndPlayback(void) {
+	if (Win32State.InputRecordFile != INVALID_HANDLE_VALUE) {
+		Win32FlushInputRecording();
+		if (Win32State.InputRecordFile != INVALID_HANDLE_VALUE) {
+			DEBUGPlatformOutf("Recorded %u frames of input.", Win32State.InputRecorder.FrameCount);
+			CloseHandle(Win32State.InputRecordFile);
+			Win32State.InputRecordFile = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	if (Win32State.IsPlayingBack) {
+		EndInputPlayback(&Win32State.InputPlayer);
+		Win32State.IsPlayingBack = false;
+	}
+}
+
 int CALLBACK
 WinMain(HINSTANCE Instance,
 		HINSTANCE PrevInstance,
@@ -756,6 +1403,7 @@ WinMain(HINSTANCE Instance,
 		LARGE_INTEGER PerformanceFrequency;
 		if (QueryPerformanceFrequency(&PerformanceFrequency)) {
 			Win32State.PerformanceFrequency = PerformanceFrequency.QuadPart;
+			Win32CalibrateTsc();
 
 			// NOTE(ivan): Obtain executable's file and path name.
 			char ModuleName[2048] = {};
@@ -781,6 +1429,9 @@ WinMain(HINSTANCE Instance,
 			GetCurrentDirectory(CountOf(Cwd) - 1, Cwd);
 			DEBUGPlatformOutf("Cwd: %s", Cwd);
 
+			Win32StartWorkers();
+			Win32BeginInputRecordingAndPlayback();
+
 			// NOTE(ivan): Create main window and its device context.
 			WNDCLASSA WindowClass = {};
 			WindowClass.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;
@@ -846,7 +1497,30 @@ WinMain(HINSTANCE Instance,
 							}
 						}
 
-						GameUpdate(GameUpdateType_Prepare, &GameState, &GameTLState);
+						// NOTE(ivan): Game memory preparation (hunk).
+						uptr HunkSize = Gigabytes(1);
+						const char *ParamHunk = PlatformCheckParamValue("-hunk");
+						if (ParamHunk)
+							sscanf(ParamHunk, "%zu", &HunkSize); // TODO(ivan): Replace CRT's sscanf() with our own function.
+						DEBUGPlatformOutf("Hunk size: %zuKb", HunkSize / 1024);
+
+						GameState.Hunk.Size = HunkSize;
+						GameState.Hunk.Base = (u8 *)VirtualAlloc(0, HunkSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+						Win32State.RenderCommands.Base = (u8 *)VirtualAlloc(0, RENDER_COMMANDS_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+						Win32State.RenderCommands.Size = RENDER_COMMANDS_SIZE;
+						if (GameState.Hunk.Base && Win32State.RenderCommands.Base) {
+							// NOTE(ivan): Fixed-step simulation, "-tickrate <hz>", off unless asked for.
+#if SLOWCODE
+							DEBUGCheckFixedStep();
+#endif
+							const char *ParamTickRate = PlatformCheckParamValue("-tickrate");
+							InitializeFixedStep(&Win32State.FixedStep, ParamTickRate ? atof(ParamTickRate) : 0.0);
+
+							GameUpdate(GameUpdateType_Prepare, &GameState, &GameTLState);
+						} else {
+							DEBUGPlatformOutf("Could not allocate enough hunk memory!");
+							PlatformQuit(1);
+						}
  
 						// NOTE(ivan): After all initialization is complete, show main window.
 						ShowWindow(Window, ShowCommand);
@@ -954,7 +1628,15 @@ WinMain(HINSTANCE Instance,
 							GameState.VideoBuffer.BytesPerPixel = Win32State.SecondaryVideoBuffer.BytesPerPixel;
 							GameState.VideoBuffer.Pitch = Win32State.SecondaryVideoBuffer.Pitch;
 
-							GameUpdate(GameUpdateType_Frame, &GameState, &GameTLState);
+							// NOTE(ivan): Record the input the game is about to see, or replace it with the recorded one.
+							if (!Win32RecordOrPlaybackInput())
+								break;
+
+							// NOTE(ivan): Update, then render the frame.
+							BeginRenderCommands(&Win32State.RenderCommands, GameState.VideoBuffer.Width, GameState.VideoBuffer.Height);
+							GameState.RenderCommands = &Win32State.RenderCommands;
+							RunFixedStepFrame(&Win32State.FixedStep, GameUpdate, &GameState, &GameTLState);
+							GameRender(&Win32State.RenderCommands, &GameState.VideoBuffer);
 
 							// NOTE(ivan): Output game video buffer.
 							static rectangle ClientDim = Win32GetWindowClientDimension(Window);
@@ -964,6 +1646,9 @@ WinMain(HINSTANCE Instance,
 										  Win32State.SecondaryVideoBuffer.Pixels, &Win32State.SecondaryVideoBuffer.Info, DIB_RGB_COLORS, SRCCOPY);
 
 							// NOTE(ivan): Before the next frame, make all input states obsolete.
+							GameState.InputEvents.Count = 0;
+							GameState.MouseWheel = 0;
+
 							for (u32 Index = 0; Index < CountOf(GameState.KeyboardButtons); Index++)
 								GameState.KeyboardButtons[Index].IsNew = false;
 
@@ -993,16 +1678,22 @@ WinMain(HINSTANCE Instance,
 								XboxController->RightStick.IsNew = false;
 							}
 
-							static u32 DisplayFrequency = GetDeviceCaps(WindowDC, VREFRESH);
-							if (DisplayFrequency <= 1)
-								DisplayFrequency = 60;
+							// NOTE(ivan): Frame rate, the display refresh rate unless "-fps <rate>" says otherwise.
+							static f64 TargetFramesPerSecond = 0.0;
+							if (TargetFramesPerSecond <= 0.0) {
+								const char *ParamFps = PlatformCheckParamValue("-fps");
+								TargetFramesPerSecond = ParamFps ? atof(ParamFps) : (f64)GetDeviceCaps(WindowDC, VREFRESH);
+								if (TargetFramesPerSecond <= 1.0)
+									TargetFramesPerSecond = 60.0;
+								InitializeFrameStats(&GameState.FrameStats, 1.0 / TargetFramesPerSecond);
+							}
 
 							u64 WorkCounter = Win32GetClock();
 
-							f64 TargetSecondsPerFrame = (f64)(1.0 / DisplayFrequency);
+							f64 TargetSecondsPerFrame = 1.0 / TargetFramesPerSecond;
 							f64 SecondsElapsedForWork = Win32GetSecondsElapsed(LastCounter, WorkCounter);
-							GameState.SecondsPerFrame = SecondsElapsedForWork;
-							GameState.FramesPerSecond = Win32State.PerformanceFrequency / (f64)(WorkCounter - LastCounter);
+							f64 WorkSeconds = SecondsElapsedForWork;
+							b32 IsMissed = (SecondsElapsedForWork >= TargetSecondsPerFrame);
 
 							if (SecondsElapsedForWork < TargetSecondsPerFrame) {
 								if (IsSleepGranular) {
@@ -1023,13 +1714,25 @@ WinMain(HINSTANCE Instance,
 							u64 EndCounter = Win32GetClock();
 							u64 EndCycleCounter = __rdtsc();
 
-							GameState.CyclesPerFrame = ((f64)(EndCycleCounter - LastCycleCounter) / (1000.0 * 1000.0));
+							GameState.FramesPerSecond = Win32State.PerformanceFrequency / (f64)Max(EndCounter - LastCounter, (u64)1);
+							AddFrameStats(&GameState.FrameStats, WorkSeconds,
+										  Win32GetSecondsElapsed(WorkCounter, EndCounter),
+										  Win32GetSecondsElapsed(LastCounter, EndCounter), IsMissed);
+
+							GameState.SecondsPerFrame = Win32GetSecondsElapsed(LastCounter, EndCounter);
+							GameState.CyclesPerFrame = (f64)(EndCycleCounter - LastCycleCounter);
 		
 							LastCounter = EndCounter;
 							LastCycleCounter = EndCycleCounter;
 						}
 
 						GameUpdate(GameUpdateType_Release, &GameState, &GameTLState);
+						// NOTE(ivan): Queued work may still point into the hunk.
+						PlatformCompleteAllWork();
+						if (GameState.Hunk.Base)
+							VirtualFree(GameState.Hunk.Base, 0, MEM_RELEASE);
+						if (Win32State.RenderCommands.Base)
+							VirtualFree(Win32State.RenderCommands.Base, 0, MEM_RELEASE);
 
 						if (XInputLibrary)
 							FreeLibrary(XInputLibrary);
@@ -1053,6 +1756,9 @@ WinMain(HINSTANCE Instance,
 				DEBUGPlatformOutf("Failed registering main window class!");
 			}
 
+			Win32EndInputRecordingAndPlayback();
+			Win32StopWorkers();
+
 			if (IsSleepGranular)
 				timeEndPeriod(1);
 		} else {
@@ -0,0 +1,286 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#ifndef GAME_RECORD_H
+#define GAME_RECORD_H
+
+#include "game.h"
+#include "game_misc.h"
+
+// NOTE(ivan): Input recording and playback.
+// Every frame the platform layer takes a snapshot of all the input the game is about to see, frame time included,
+// and either appends it to a recording or replaces it with the next one from a recording. Played back sessions
+// are bit-identical to the recorded ones as far as the game can tell.
+//
+// Stream format: input_record_header, then one encoded snapshot per frame. A snapshot is encoded as the XOR
+// against the previous one (all zeroes before the first), written as pairs of varint runs: the count of unchanged
+// bytes, then the count of changed bytes followed by those bytes. Runs of a frame cover exactly one snapshot.
+// A frame where nothing but the frame time changed takes a dozen bytes or so.
+#define INPUT_RECORD_MAGIC 0x52495151 // NOTE(ivan): "QQIR".
+#define INPUT_RECORD_VERSION 2
+
+struct input_record_header {
+	u32 Magic;
+	u32 Version;
+	u32 SnapshotSize; // NOTE(ivan): Recordings of a build with a different input layout are refused.
+	u32 Reserved;
+};
+
+// NOTE(ivan): Everything the game reads as input on a frame.
+// Only ever zeroed and copied bytewise, so padding between the fields stays zero and encodes to nothing.
+struct input_snapshot {
+	game_input_button KeyboardButtons[KeyCode_MaxCount];
+	game_input_button MouseButtons[5];
+	point MousePos;
+	s32 MouseWheel;
+	game_input_xbox_controller XboxControllers[4];
+	game_input_events InputEvents;
+	f64 SecondsPerFrame;
+};
+
+// NOTE(ivan): Worst case of one encoded frame: every byte changed, plus the two run lengths.
+#define INPUT_RECORD_MAX_FRAME_SIZE (sizeof(input_snapshot) + 16)
+#define INPUT_RECORD_BUFFER_SIZE Kilobytes(64)
+
+inline void
+CaptureInputSnapshot(input_snapshot *Snapshot, game_state *State) {
+	Assert(Snapshot);
+	Assert(State);
+	static_assert(sizeof(Snapshot->KeyboardButtons) == sizeof(State->KeyboardButtons), "Input snapshot is out of date!");
+	static_assert(sizeof(Snapshot->MouseButtons) == sizeof(State->MouseButtons), "Input snapshot is out of date!");
+	static_assert(sizeof(Snapshot->XboxControllers) == sizeof(State->XboxControllers), "Input snapshot is out of date!");
+
+	CopyBytes(Snapshot->KeyboardButtons, State->KeyboardButtons, sizeof(Snapshot->KeyboardButtons));
+	CopyBytes(Snapshot->MouseButtons, State->MouseButtons, sizeof(Snapshot->MouseButtons));
+	Snapshot->MousePos = State->MousePos;
+	Snapshot->MouseWheel = State->MouseWheel;
+	CopyBytes(Snapshot->XboxControllers, State->XboxControllers, sizeof(Snapshot->XboxControllers));
+	CopyBytes(&Snapshot->InputEvents, &State->InputEvents, sizeof(Snapshot->InputEvents));
+	Snapshot->SecondsPerFrame = State->SecondsPerFrame;
+}
+
+inline void
+ApplyInputSnapshot(game_state *State, input_snapshot *Snapshot) {
+	Assert(State);
+	Assert(Snapshot);
+
+	CopyBytes(State->KeyboardButtons, Snapshot->KeyboardButtons, sizeof(Snapshot->KeyboardButtons));
+	CopyBytes(State->MouseButtons, Snapshot->MouseButtons, sizeof(Snapshot->MouseButtons));
+	State->MousePos = Snapshot->MousePos;
+	State->MouseWheel = Snapshot->MouseWheel;
+	CopyBytes(State->XboxControllers, Snapshot->XboxControllers, sizeof(Snapshot->XboxControllers));
+	CopyBytes(&State->InputEvents, &Snapshot->InputEvents, sizeof(Snapshot->InputEvents));
+	State->SecondsPerFrame = Snapshot->SecondsPerFrame;
+}
+
+inline u8 *
+PutRecordVarint(u8 *At, uptr Value) {
+	while (Value >= 0x80) {
+		*At++ = (u8)(Value | 0x80);
+		Value >>= 7;
+	}
+	*At++ = (u8)Value;
+
+	return At;
+}
+
+// NOTE(ivan): Returns 0 if the varint runs past End.
+inline const u8 *
+GetRecordVarint(const u8 *At, const u8 *End, uptr *Value) {
+	*Value = 0;
+	for (u32 Shift = 0; (At < End) && (Shift < 64); Shift += 7) {
+		u8 Byte = *At++;
+		*Value |= (uptr)(Byte & 0x7F) << Shift;
+		if (!(Byte & 0x80))
+			return At;
+	}
+
+	return 0;
+}
+
+// NOTE(ivan): Encodes Snapshot against Prev into Out, which must have INPUT_RECORD_MAX_FRAME_SIZE bytes. Returns the size written.
+inline uptr
+EncodeInputSnapshot(const input_snapshot *Prev, const input_snapshot *Snapshot, u8 *Out) {
+	Assert(Prev);
+	Assert(Snapshot);
+	Assert(Out);
+
+	const u8 *Old = (const u8 *)Prev;
+	const u8 *New = (const u8 *)Snapshot;
+	u8 *At = Out;
+
+	uptr Index = 0;
+	while (Index < sizeof(input_snapshot)) {
+		uptr Same = Index;
+		while ((Same < sizeof(input_snapshot)) && (Old[Same] == New[Same]))
+			Same++;
+
+		// NOTE(ivan): A changed run ends at the first stretch of a few unchanged bytes, lone equal bytes are cheaper inline.
+		uptr Changed = Same;
+		while (Changed < sizeof(input_snapshot)) {
+			if (Old[Changed] == New[Changed]) {
+				uptr Next = Changed;
+				while ((Next < sizeof(input_snapshot)) && (Next < (Changed + 3)) && (Old[Next] == New[Next]))
+					Next++;
+				if ((Next == sizeof(input_snapshot)) || (Next == (Changed + 3)))
+					break;
+				Changed = Next;
+			} else {
+				Changed++;
+			}
+		}
+
+		At = PutRecordVarint(At, Same - Index);
+		At = PutRecordVarint(At, Changed - Same);
+		for (uptr Byte = Same; Byte < Changed; Byte++)
+			*At++ = Old[Byte] ^ New[Byte];
+
+		Index = Changed;
+	}
+
+	Assert((uptr)(At - Out) <= INPUT_RECORD_MAX_FRAME_SIZE);
+	return At - Out;
+}
+
+// NOTE(ivan): Turns Snapshot, holding the previous frame, into the next one. Returns the bytes consumed, 0 if the data is corrupt.
+inline uptr
+DecodeInputSnapshot(input_snapshot *Snapshot, const u8 *In, uptr InSize) {
+	Assert(Snapshot);
+	Assert(In);
+
+	u8 *Bytes = (u8 *)Snapshot;
+	const u8 *At = In;
+	const u8 *End = In + InSize;
+
+	uptr Index = 0;
+	while (Index < sizeof(input_snapshot)) {
+		uptr Same, Changed;
+		At = GetRecordVarint(At, End, &Same);
+		if (!At)
+			return 0;
+		At = GetRecordVarint(At, End, &Changed);
+		if (!At)
+			return 0;
+		if (((sizeof(input_snapshot) - Index) < Same) ||
+			((sizeof(input_snapshot) - Index - Same) < Changed) ||
+			((uptr)(End - At) < Changed))
+			return 0;
+
+		Index += Same;
+		for (uptr Byte = 0; Byte < Changed; Byte++)
+			Bytes[Index++] ^= *At++;
+	}
+
+	return At - In;
+}
+
+// NOTE(ivan): Recording side. The platform layer owns the file and writes Buffer out whenever RecordInputFrame() asks to.
+struct input_recorder {
+	input_snapshot Last;
+	u32 FrameCount;
+
+	uptr BufferUsed;
+	u8 Buffer[INPUT_RECORD_BUFFER_SIZE];
+};
+
+inline void
+BeginInputRecording(input_recorder *Recorder) {
+	Assert(Recorder);
+
+	memset(&Recorder->Last, 0, sizeof(Recorder->Last));
+	Recorder->FrameCount = 0;
+
+	input_record_header *Header = (input_record_header *)Recorder->Buffer;
+	Header->Magic = INPUT_RECORD_MAGIC;
+	Header->Version = INPUT_RECORD_VERSION;
+	Header->SnapshotSize = sizeof(input_snapshot);
+	Header->Reserved = 0;
+	Recorder->BufferUsed = sizeof(input_record_header);
+}
+
+// NOTE(ivan): Returns true when the buffer has to be written out and emptied before the next frame.
+inline b32
+RecordInputFrame(input_recorder *Recorder, game_state *State) {
+	Assert(Recorder);
+	Assert(State);
+	Assert((Recorder->BufferUsed + INPUT_RECORD_MAX_FRAME_SIZE) <= sizeof(Recorder->Buffer));
+
+	input_snapshot Snapshot;
+	CopyBytes(&Snapshot, &Recorder->Last, sizeof(Snapshot));
+	CaptureInputSnapshot(&Snapshot, State);
+
+	Recorder->BufferUsed += EncodeInputSnapshot(&Recorder->Last, &Snapshot, Recorder->Buffer + Recorder->BufferUsed);
+	CopyBytes(&Recorder->Last, &Snapshot, sizeof(Snapshot));
+	Recorder->FrameCount++;
+
+	return ((Recorder->BufferUsed + INPUT_RECORD_MAX_FRAME_SIZE) > sizeof(Recorder->Buffer));
+}
+
+// NOTE(ivan): Playback side, the recording is mapped as a whole.
+struct input_player {
+	piece Stream;
+	uptr At;
+	input_snapshot Last;
+	u32 FrameCount;
+	b32 IsCorrupted; // NOTE(ivan): The recording ended early on bad data rather than at its end.
+};
+
+// NOTE(ivan): Fails if the file is missing or was recorded by a build with a different input layout.
+inline b32
+BeginInputPlayback(input_player *Player, const char *FileName) {
+	Assert(Player);
+	Assert(FileName);
+
+	memset(Player, 0, sizeof(*Player));
+	Player->Stream = PlatformMapEntireFile(FileName);
+	if (!Player->Stream.Base)
+		return false;
+
+	input_record_header *Header = (input_record_header *)Player->Stream.Base;
+	if ((Player->Stream.Size < sizeof(input_record_header)) ||
+		(Header->Magic != INPUT_RECORD_MAGIC) ||
+		(Header->Version != INPUT_RECORD_VERSION) ||
+		(Header->SnapshotSize != sizeof(input_snapshot))) {
+		PlatformUnmapEntireFile(&Player->Stream);
+		return false;
+	}
+
+	Player->At = sizeof(input_record_header);
+	return true;
+}
+
+// NOTE(ivan): Replaces the input of State with the next recorded frame, returns false once the recording is over.
+inline b32
+PlayInputFrame(input_player *Player, game_state *State) {
+	Assert(Player);
+	Assert(State);
+
+	if (!Player->Stream.Base || (Player->At >= Player->Stream.Size))
+		return false;
+
+	uptr Consumed = DecodeInputSnapshot(&Player->Last, Player->Stream.Base + Player->At, Player->Stream.Size - Player->At);
+	if (!Consumed) {
+		Player->IsCorrupted = true;
+		return false;
+	}
+
+	Player->At += Consumed;
+	Player->FrameCount++;
+	ApplyInputSnapshot(State, &Player->Last);
+
+	return true;
+}
+
+inline void
+EndInputPlayback(input_player *Player) {
+	Assert(Player);
+
+	if (Player->Stream.Base)
+		PlatformUnmapEntireFile(&Player->Stream);
+}
+
+#endif // #ifndef GAME_RECORD_H
@@ -0,0 +1,132 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#ifndef GAME_RENDER_H
+#define GAME_RENDER_H
+
+#include "game_platform.h"
+#include "game_math.h"
+#include "game_image.h"
+
+// NOTE(ivan): Render command list.
+// The Frame update does not draw into the video buffer, it pushes commands that GameRender() rasterizes afterwards.
+// A list is self-contained, everything a command needs (image pixels included) is copied into it,
+// so the platform layer may rasterize it on another thread while the game already runs the next frame.
+// NOTE(ivan): Colors are 0..255 per channel, like DrawPixel() takes them.
+#define RENDER_COMMANDS_SIZE Megabytes(16)
+#define RENDER_COMMAND_ALIGNMENT 16
+
+enum render_command_type {
+	RenderCommand_Clear,
+	RenderCommand_Rectangle,
+	RenderCommand_Image
+};
+
+struct render_command_header {
+	u32 Type;
+	u32 Size; // NOTE(ivan): Header included, the next command starts right after.
+};
+
+struct render_command_clear {
+	render_command_header Header;
+	v4 Color;
+};
+
+struct render_command_rectangle {
+	render_command_header Header;
+	v2 Pos;
+	v2 Dim;
+	v4 Color;
+};
+
+struct render_command_image {
+	render_command_header Header;
+	v2 Pos;
+	image Image; // NOTE(ivan): Pixels follow the command, rows packed tightly.
+};
+
+struct render_commands {
+	u8 *Base; // NOTE(ivan): RENDER_COMMANDS_SIZE bytes, owned by the platform layer.
+	uptr Size;
+	uptr Used;
+	u32 Count;
+	u32 DroppedCount; // NOTE(ivan): Commands that did not fit.
+
+	// NOTE(ivan): Of the video buffer the list is rendered into, for the game to lay things out.
+	s32 Width;
+	s32 Height;
+};
+
+inline void
+BeginRenderCommands(render_commands *Commands, s32 Width, s32 Height) {
+	Assert(Commands);
+	Assert(Commands->Base);
+
+	Commands->Used = 0;
+	Commands->Count = 0;
+	Commands->DroppedCount = 0;
+	Commands->Width = Width;
+	Commands->Height = Height;
+}
+
+// NOTE(ivan): Returns 0 if the list is full, the command is dropped then.
+inline void *
+PushRenderCommand_(render_commands *Commands, render_command_type Type, uptr Size) {
+	Assert(Commands);
+
+	Size = AlignPow2(Size, (uptr)RENDER_COMMAND_ALIGNMENT);
+	if ((Commands->Size - Commands->Used) < Size) {
+		Commands->DroppedCount++;
+		return 0;
+	}
+
+	render_command_header *Header = (render_command_header *)(Commands->Base + Commands->Used);
+	Header->Type = Type;
+	Header->Size = (u32)Size;
+
+	Commands->Used += Size;
+	Commands->Count++;
+
+	return Header;
+}
+#define PushRenderCommand(Commands, Type, Struct, Extra) ((Struct *)PushRenderCommand_(Commands, Type, sizeof(Struct) + (Extra)))
+
+inline void
+PushClear(render_commands *Commands, v4 Color) {
+	render_command_clear *Command = PushRenderCommand(Commands, RenderCommand_Clear, render_command_clear, 0);
+	if (Command)
+		Command->Color = Color;
+}
+
+inline void
+PushRectangle(render_commands *Commands, v2 Pos, v2 Dim, v4 Color) {
+	render_command_rectangle *Command = PushRenderCommand(Commands, RenderCommand_Rectangle, render_command_rectangle, 0);
+	if (Command) {
+		Command->Pos = Pos;
+		Command->Dim = Dim;
+		Command->Color = Color;
+	}
+}
+
+inline void
+PushImage(render_commands *Commands, image *Image, v2 Pos) {
+	Assert(Image);
+
+	uptr RowSize = (uptr)Image->Width * Image->BytesPerPixel;
+	render_command_image *Command = PushRenderCommand(Commands, RenderCommand_Image, render_command_image, RowSize * Image->Height);
+	if (Command) {
+		Command->Pos = Pos;
+		Command->Image = *Image;
+		Command->Image.Pixels = (u32 *)(Command + 1);
+		Command->Image.Pitch = (s32)RowSize;
+
+		for (s32 Y = 0; Y < Image->Height; Y++)
+			memcpy((u8 *)Command->Image.Pixels + (Y * RowSize), (u8 *)Image->Pixels + (Y * Image->Pitch), RowSize);
+	}
+}
+
+#endif // #ifndef GAME_RENDER_H
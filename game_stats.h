@@ -0,0 +1,166 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#ifndef GAME_STATS_H
+#define GAME_STATS_H
+
+#include "game_platform.h"
+
+// NOTE(ivan): Frame time statistics over the last FRAME_STATS_WINDOW frames, fed by the platform layer once per frame.
+// Every series keeps a log-linear histogram of its window (16 buckets per power of two microseconds, so any
+// percentile is within ~6% of the real value), samples entering and leaving the window only touch their own bucket.
+#define FRAME_STATS_WINDOW 512
+#define FRAME_STATS_SUB_BUCKETS 16
+#define FRAME_STATS_MAX_MICROSECONDS (1u << 26) // NOTE(ivan): ~67 seconds, longer frames are counted as this long.
+#define FRAME_STATS_BUCKET_COUNT (FRAME_STATS_SUB_BUCKETS * 24)
+
+struct frame_time_series {
+	u16 Histogram[FRAME_STATS_BUCKET_COUNT];
+	f64 Samples[FRAME_STATS_WINDOW]; // NOTE(ivan): Seconds, in step with frame_stats::NextSample.
+	f64 Sum;
+
+	// NOTE(ivan): Seconds, over the window. Percentiles are bucket upper bounds, Max is exact.
+	f64 Mean;
+	f64 P50;
+	f64 P95;
+	f64 P99;
+	f64 Max;
+};
+
+struct frame_stats {
+	f64 TargetSecondsPerFrame;
+
+	u32 SampleCount; // NOTE(ivan): Frames in the window, up to FRAME_STATS_WINDOW.
+	u32 NextSample;
+	u64 FrameCount; // NOTE(ivan): Since startup.
+
+	// NOTE(ivan): Frames that were already past their deadline when the work was done.
+	u8 IsMissed[FRAME_STATS_WINDOW];
+	u32 MissedInWindow;
+	u64 MissedCount; // NOTE(ivan): Since startup.
+
+	frame_time_series Work; // NOTE(ivan): Input, game update and presentation.
+	frame_time_series Sleep; // NOTE(ivan): Waiting for the deadline.
+	frame_time_series Total;
+};
+
+inline u32
+GetFrameStatsBucket(f64 Seconds) {
+	u32 Microseconds = FRAME_STATS_MAX_MICROSECONDS;
+	if (Seconds < (FRAME_STATS_MAX_MICROSECONDS / 1000000.0))
+		Microseconds = (Seconds > 0.0) ? (u32)(Seconds * 1000000.0) : 0;
+
+	// NOTE(ivan): Microseconds below FRAME_STATS_SUB_BUCKETS map one to one, every power of two above gets its own set of buckets.
+	if (Microseconds < FRAME_STATS_SUB_BUCKETS)
+		return Microseconds;
+
+	u32 Shift = FindMostSignificantBit(Microseconds).Index - 4;
+	u32 SubBucket = (Microseconds >> Shift) & (FRAME_STATS_SUB_BUCKETS - 1);
+	return ((Shift + 1) * FRAME_STATS_SUB_BUCKETS) + SubBucket;
+}
+
+// NOTE(ivan): Upper bound of the bucket, in seconds.
+inline f64
+GetFrameStatsBucketSeconds(u32 Bucket) {
+	Assert(Bucket < FRAME_STATS_BUCKET_COUNT);
+
+	u64 Microseconds = Bucket + 1;
+	if (Bucket >= FRAME_STATS_SUB_BUCKETS) {
+		u32 Shift = (Bucket / FRAME_STATS_SUB_BUCKETS) - 1;
+		u32 SubBucket = Bucket & (FRAME_STATS_SUB_BUCKETS - 1);
+		Microseconds = (u64)(FRAME_STATS_SUB_BUCKETS + SubBucket + 1) << Shift;
+	}
+
+	return (f64)Microseconds / 1000000.0;
+}
+
+inline void
+UpdateFrameTimeSeries(frame_time_series *Series, u32 Slot, b32 IsEvicting, f64 Seconds, u32 SampleCount) {
+	Assert(Series);
+	Assert(Slot < FRAME_STATS_WINDOW);
+	Assert(SampleCount);
+
+	b32 IsMaxEvicted = false;
+	if (IsEvicting) {
+		f64 Old = Series->Samples[Slot];
+		Series->Histogram[GetFrameStatsBucket(Old)]--;
+		Series->Sum -= Old;
+		IsMaxEvicted = (Old >= Series->Max);
+	}
+
+	Series->Samples[Slot] = Seconds;
+	Series->Histogram[GetFrameStatsBucket(Seconds)]++;
+	Series->Sum += Seconds;
+	Series->Mean = Series->Sum / SampleCount;
+
+	// NOTE(ivan): Max only needs a rescan when the maximum itself left the window.
+	if (Seconds >= Series->Max) {
+		Series->Max = Seconds;
+	} else if (IsMaxEvicted) {
+		Series->Max = 0.0;
+		for (u32 Index = 0; Index < SampleCount; Index++)
+			Series->Max = Max(Series->Max, Series->Samples[Index]);
+	}
+
+	u32 Rank50 = (SampleCount * 50 + 99) / 100;
+	u32 Rank95 = (SampleCount * 95 + 99) / 100;
+	u32 Rank99 = (SampleCount * 99 + 99) / 100;
+
+	u32 Seen = 0;
+	for (u32 Bucket = 0; Bucket < FRAME_STATS_BUCKET_COUNT; Bucket++) {
+		u32 Count = Series->Histogram[Bucket];
+		if (!Count)
+			continue;
+
+		f64 BucketSeconds = GetFrameStatsBucketSeconds(Bucket);
+		if ((Seen < Rank50) && ((Seen + Count) >= Rank50))
+			Series->P50 = BucketSeconds;
+		if ((Seen < Rank95) && ((Seen + Count) >= Rank95))
+			Series->P95 = BucketSeconds;
+		if ((Seen < Rank99) && ((Seen + Count) >= Rank99)) {
+			Series->P99 = BucketSeconds;
+			break;
+		}
+
+		Seen += Count;
+	}
+}
+
+inline void
+InitializeFrameStats(frame_stats *Stats, f64 TargetSecondsPerFrame) {
+	Assert(Stats);
+
+	*Stats = {};
+	Stats->TargetSecondsPerFrame = TargetSecondsPerFrame;
+}
+
+inline void
+AddFrameStats(frame_stats *Stats, f64 WorkSeconds, f64 SleepSeconds, f64 TotalSeconds, b32 IsMissed) {
+	Assert(Stats);
+
+	u32 Slot = Stats->NextSample;
+	b32 IsEvicting = (Stats->SampleCount == FRAME_STATS_WINDOW);
+	if (!IsEvicting)
+		Stats->SampleCount++;
+
+	if (IsEvicting && Stats->IsMissed[Slot])
+		Stats->MissedInWindow--;
+	Stats->IsMissed[Slot] = (u8)(IsMissed ? 1 : 0);
+	if (IsMissed) {
+		Stats->MissedInWindow++;
+		Stats->MissedCount++;
+	}
+
+	UpdateFrameTimeSeries(&Stats->Work, Slot, IsEvicting, WorkSeconds, Stats->SampleCount);
+	UpdateFrameTimeSeries(&Stats->Sleep, Slot, IsEvicting, SleepSeconds, Stats->SampleCount);
+	UpdateFrameTimeSeries(&Stats->Total, Slot, IsEvicting, TotalSeconds, Stats->SampleCount);
+
+	Stats->NextSample = (Slot + 1) % FRAME_STATS_WINDOW;
+	Stats->FrameCount++;
+}
+
+#endif // #ifndef GAME_STATS_H
@@ -0,0 +1,247 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#ifndef GAME_STEP_H
+#define GAME_STEP_H
+
+#include "game.h"
+#include "game_record.h"
+
+// NOTE(ivan): Fixed-step simulation, driven by the platform layer once per frame.
+// The frame time goes into an accumulator that is spent in whole ticks of SecondsPerTick, each one a GameUpdateType_Tick
+// update, then the frame is rendered by the GameUpdateType_Frame update with the leftover as State->TickAlpha.
+// The simulation costs the same at any display rate, the render pass interpolates between the last two ticks.
+//
+// Input of frames that ran no tick is merged into the pending tick input rather than lost, so every press
+// reaches the simulation exactly once: the first tick of a frame sees all the edges gathered since the previous tick,
+// the following ticks of the same frame see the buttons as held. A button pressed and released again before any tick
+// stays pressed for the tick that takes the press, the release goes to the tick after it.
+// The render pass always sees the input of its own frame.
+//
+// Everything here only depends on State->SecondsPerFrame, which is part of the recorded input,
+// so played back sessions run the very same ticks.
+#define MAX_TICKS_PER_FRAME 8 // NOTE(ivan): Time past that (a breakpoint, a long hitch) is dropped rather than caught up with.
+
+struct fixed_step {
+	f64 SecondsPerTick; // NOTE(ivan): 0 runs one variable-length Frame update per frame instead.
+	f64 Accumulator;
+	input_snapshot PendingInput;
+};
+
+inline void
+InitializeFixedStep(fixed_step *Step, f64 TicksPerSecond) {
+	Assert(Step);
+
+	memset(Step, 0, sizeof(*Step));
+	if (TicksPerSecond > 0.0)
+		Step->SecondsPerTick = 1.0 / TicksPerSecond;
+}
+
+inline void
+MergeInputButton(game_input_button *Pending, game_input_button *Button) {
+	Assert(Pending);
+	Assert(Button);
+
+	// NOTE(ivan): An edge no tick has seen yet is latched, so a press released before the next tick still reaches it.
+	// ConsumeInputButton() catches up with where the button ended up once the edge is consumed.
+	if (Pending->IsNew && (Pending->WasDown != Pending->IsDown))
+		return;
+
+	if (Button->IsNew) {
+		if (!Pending->IsNew)
+			Pending->WasDown = Button->WasDown;
+		Pending->IsNew = true;
+	}
+	Pending->IsDown = Button->IsDown;
+}
+
+inline void
+MergeXboxControllerInput(game_input_xbox_controller *Pending, game_input_xbox_controller *Controller) {
+	Assert(Pending);
+	Assert(Controller);
+
+	game_input_button *PendingButtons[] = {
+		&Pending->Start, &Pending->Back, &Pending->A, &Pending->B, &Pending->X, &Pending->Y,
+		&Pending->Up, &Pending->Down, &Pending->Left, &Pending->Right,
+		&Pending->LeftBumper, &Pending->RightBumper, &Pending->LeftStick, &Pending->RightStick
+	};
+	game_input_button *Buttons[] = {
+		&Controller->Start, &Controller->Back, &Controller->A, &Controller->B, &Controller->X, &Controller->Y,
+		&Controller->Up, &Controller->Down, &Controller->Left, &Controller->Right,
+		&Controller->LeftBumper, &Controller->RightBumper, &Controller->LeftStick, &Controller->RightStick
+	};
+	for (u32 Index = 0; Index < CountOf(Buttons); Index++)
+		MergeInputButton(PendingButtons[Index], Buttons[Index]);
+
+	Pending->IsConnected = Controller->IsConnected;
+	Pending->LeftTrigger = Controller->LeftTrigger;
+	Pending->RightTrigger = Controller->RightTrigger;
+	Pending->LeftStickPos = Controller->LeftStickPos;
+	Pending->RightStickPos = Controller->RightStickPos;
+}
+
+// NOTE(ivan): Adds the input of this frame to whatever the simulation has not seen yet.
+inline void
+MergePendingTickInput(input_snapshot *Pending, game_state *State) {
+	Assert(Pending);
+	Assert(State);
+
+	for (u32 Index = 0; Index < CountOf(State->KeyboardButtons); Index++)
+		MergeInputButton(&Pending->KeyboardButtons[Index], &State->KeyboardButtons[Index]);
+	for (u32 Index = 0; Index < CountOf(State->MouseButtons); Index++)
+		MergeInputButton(&Pending->MouseButtons[Index], &State->MouseButtons[Index]);
+	for (u32 Index = 0; Index < CountOf(State->XboxControllers); Index++)
+		MergeXboxControllerInput(&Pending->XboxControllers[Index], &State->XboxControllers[Index]);
+
+	Pending->MousePos = State->MousePos;
+	Pending->MouseWheel += State->MouseWheel;
+
+	for (u32 Index = GetFirstInputEvent(&State->InputEvents); Index < State->InputEvents.Count; Index++) {
+		game_input_event *Event = GetInputEvent(&State->InputEvents, Index);
+		PushInputEvent(&Pending->InputEvents, (game_input_event_type)Event->Type, Event->Code, Event->Value, Event->Time);
+	}
+
+	Pending->SecondsPerFrame = State->SecondsPerFrame;
+}
+
+// NOTE(ivan): The edge has been seen by a tick. A button latched away from where it is now gets the edge back to it,
+// for the following tick.
+inline void
+ConsumeInputButton(game_input_button *Pending, game_input_button *Button) {
+	Assert(Pending);
+	Assert(Button);
+
+	Pending->IsNew = (Pending->IsDown != Button->IsDown);
+	Pending->WasDown = Pending->IsDown;
+	Pending->IsDown = Button->IsDown;
+}
+
+// NOTE(ivan): Makes all edges obsolete, Latest is the input of the current frame the latched buttons catch up with.
+inline void
+ConsumeInputEdges(input_snapshot *Input, input_snapshot *Latest) {
+	Assert(Input);
+	Assert(Latest);
+
+	for (u32 Index = 0; Index < CountOf(Input->KeyboardButtons); Index++)
+		ConsumeInputButton(&Input->KeyboardButtons[Index], &Latest->KeyboardButtons[Index]);
+	for (u32 Index = 0; Index < CountOf(Input->MouseButtons); Index++)
+		ConsumeInputButton(&Input->MouseButtons[Index], &Latest->MouseButtons[Index]);
+
+	for (u32 Index = 0; Index < CountOf(Input->XboxControllers); Index++) {
+		game_input_xbox_controller *Controller = &Input->XboxControllers[Index];
+		game_input_xbox_controller *LatestController = &Latest->XboxControllers[Index];
+
+		ConsumeInputButton(&Controller->Start, &LatestController->Start);
+		ConsumeInputButton(&Controller->Back, &LatestController->Back);
+
+		ConsumeInputButton(&Controller->A, &LatestController->A);
+		ConsumeInputButton(&Controller->B, &LatestController->B);
+		ConsumeInputButton(&Controller->X, &LatestController->X);
+		ConsumeInputButton(&Controller->Y, &LatestController->Y);
+
+		ConsumeInputButton(&Controller->Up, &LatestController->Up);
+		ConsumeInputButton(&Controller->Down, &LatestController->Down);
+		ConsumeInputButton(&Controller->Left, &LatestController->Left);
+		ConsumeInputButton(&Controller->Right, &LatestController->Right);
+
+		ConsumeInputButton(&Controller->LeftBumper, &LatestController->LeftBumper);
+		ConsumeInputButton(&Controller->RightBumper, &LatestController->RightBumper);
+
+		ConsumeInputButton(&Controller->LeftStick, &LatestController->LeftStick);
+		ConsumeInputButton(&Controller->RightStick, &LatestController->RightStick);
+	}
+
+	Input->MouseWheel = 0;
+	Input->InputEvents.Count = 0;
+}
+
+// NOTE(ivan): Runs the game for one frame: the ticks this frame pays for, then the render pass.
+// Must be called once the input of the frame is final, recorded or played back.
+inline void
+RunFixedStepFrame(fixed_step *Step, game_update_func *Update, game_state *State, game_tl_state *TLState) {
+	Assert(Step);
+	Assert(Update);
+	Assert(State);
+
+	State->SecondsPerTick = Step->SecondsPerTick;
+	if (Step->SecondsPerTick <= 0.0) {
+		State->TickAlpha = 0.0f;
+		Update(GameUpdateType_Frame, State, TLState);
+		return;
+	}
+
+	MergePendingTickInput(&Step->PendingInput, State);
+
+	Step->Accumulator += State->SecondsPerFrame;
+	u32 TickCount = (u32)(Step->Accumulator / Step->SecondsPerTick);
+	if (TickCount > MAX_TICKS_PER_FRAME) {
+		TickCount = MAX_TICKS_PER_FRAME;
+		Step->Accumulator = TickCount * Step->SecondsPerTick;
+	}
+	Step->Accumulator -= TickCount * Step->SecondsPerTick;
+
+	if (TickCount) {
+		input_snapshot FrameInput;
+		CaptureInputSnapshot(&FrameInput, State);
+
+		for (u32 Tick = 0; Tick < TickCount; Tick++) {
+			ApplyInputSnapshot(State, &Step->PendingInput);
+			Update(GameUpdateType_Tick, State, TLState);
+			State->TickCount++;
+
+			ConsumeInputEdges(&Step->PendingInput, &FrameInput);
+		}
+
+		ApplyInputSnapshot(State, &FrameInput);
+	}
+
+	State->TickAlpha = (f32)(Step->Accumulator / Step->SecondsPerTick);
+	Update(GameUpdateType_Frame, State, TLState);
+}
+
+#if SLOWCODE
+static u32 DEBUGFixedStepPressCount;
+static u32 DEBUGFixedStepReleaseCount;
+
+static GAME_UPDATE(DEBUGFixedStepUpdate) {
+	UnusedParam(TLState);
+
+	game_input_button *Button = &State->KeyboardButtons[KeyCode_Space];
+	if (UpdateType == GameUpdateType_Tick) {
+		if (IsNewlyPressed(Button))
+			DEBUGFixedStepPressCount++;
+		if (Button->WasDown && !Button->IsDown && Button->IsNew)
+			DEBUGFixedStepReleaseCount++;
+	}
+}
+
+// NOTE(ivan): A tap that is over before the next tick, at four frames per tick.
+static void
+DEBUGCheckFixedStep(void) {
+	static game_state State;
+	fixed_step Step;
+	InitializeFixedStep(&Step, 60.0);
+
+	DEBUGFixedStepPressCount = 0;
+	DEBUGFixedStepReleaseCount = 0;
+	for (u32 Frame = 0; Frame < 16; Frame++) {
+		game_input_button *Button = &State.KeyboardButtons[KeyCode_Space];
+		Button->WasDown = Button->IsDown;
+		Button->IsDown = (Frame == 0);
+		Button->IsNew = (Button->WasDown != Button->IsDown);
+		State.SecondsPerFrame = 1.0 / 240.0;
+
+		RunFixedStepFrame(&Step, DEBUGFixedStepUpdate, &State, 0);
+	}
+
+	Assert(State.TickCount >= 3);
+	Assert(DEBUGFixedStepPressCount == 1);
+	Assert(DEBUGFixedStepReleaseCount == 1);
+}
+#endif // #if SLOWCODE
+
+#endif // #ifndef GAME_STEP_H
@@ -0,0 +1,481 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#include "game_vfs.h"
+
+// NOTE(ivan): The one VFS every file loader reads through, set by InitializeVfs() and UseVfs().
+// Loaders called before that (or by tools) go straight to the disk.
+// This static belongs to the game module, a freshly reloaded module starts with it zeroed.
+static vfs *GlobalVfs = 0;
+
+inline u32
+HashVfsPath(const char *Path) {
+	// NOTE(ivan): FNV-1a.
+	u32 Result = 2166136261u;
+	while (*Path) {
+		Result ^= (u8)*Path++;
+		Result *= 16777619u;
+	}
+
+	return Result;
+}
+
+// NOTE(ivan): Turns backslashes into slashes, strips leading "./" and "/".
+static b32
+NormalizeVfsPath(const char *Path, char *Buffer, uptr BufferSize) {
+	Assert(Path);
+	Assert(Buffer);
+	Assert(BufferSize);
+
+	for (;;) {
+		if ((Path[0] == '.') && ((Path[1] == '/') || (Path[1] == '\\')))
+			Path += 2;
+		else if ((Path[0] == '/') || (Path[0] == '\\'))
+			Path++;
+		else
+			break;
+	}
+
+	uptr Length = 0;
+	for (; Path[Length]; Length++) {
+		if ((Length + 1) >= BufferSize)
+			return false;
+		Buffer[Length] = (Path[Length] == '\\') ? '/' : Path[Length];
+	}
+	Buffer[Length] = 0;
+
+	return Length != 0;
+}
+
+static vfs_entry *
+FindVfsEntry(vfs *Vfs, const char *Path, u32 Hash) {
+	Assert(Vfs);
+	Assert(Path);
+
+	// NOTE(ivan): Linear probing, the table is never more than 3/4 full so an empty slot always ends the search.
+	for (u32 Index = (Hash & Vfs->EntryMask);; Index = ((Index + 1) & Vfs->EntryMask)) {
+		vfs_entry *Entry = &Vfs->Entries[Index];
+		if (!Entry->Path)
+			return Entry;
+		if ((Entry->Hash == Hash) && AreStringsEqual(Entry->Path, Path))
+			return Entry;
+	}
+}
+
+static b32
+AddVfsEntry(vfs *Vfs, const char *Path, u32 SourceIndex, uptr Offset, uptr Size) {
+	Assert(Vfs);
+	Assert(Path);
+
+	char NormalPath[VFS_MAX_PATH];
+	if (!NormalizeVfsPath(Path, NormalPath, CountOf(NormalPath))) {
+		DEBUGPlatformOutf("VFS: path is too long, skipped: %s", Path);
+		return false;
+	}
+
+	u32 Hash = HashVfsPath(NormalPath);
+	vfs_entry *Entry = FindVfsEntry(Vfs, NormalPath, Hash);
+	if (!Entry->Path) {
+		if (((Vfs->EntryCount + 1) * 4) > ((Vfs->EntryMask + 1) * 3)) {
+			DEBUGPlatformOutf("VFS: too many files, skipped: %s", NormalPath);
+			return false;
+		}
+
+		uptr PathSize = strlen(NormalPath) + 1;
+		char *PathCopy = (char *)PushSize(Vfs->Heap, PathSize, 1);
+		if (!PathCopy)
+			return false;
+		CopyBytes(PathCopy, NormalPath, PathSize);
+
+		Entry->Hash = Hash;
+		Entry->Path = PathCopy;
+		Vfs->EntryCount++;
+	}
+
+	// NOTE(ivan): Existing entries are overridden by the later mounted source.
+	Entry->SourceIndex = SourceIndex;
+	Entry->Offset = Offset;
+	Entry->Size = Size;
+
+	return true;
+}
+
+inline b32
+IsVfsPackName(const char *FileName) {
+	char Extension[16] = {};
+	ExtractFileExtension(Extension, CountOf(Extension) - 1, FileName);
+	return AreStringsEqual(Extension, VFS_PACK_EXTENSION);
+}
+
+b32
+InitializeVfs(vfs *Vfs, memory_heap *Heap, u32 MaxFiles) {
+	Assert(Vfs);
+	Assert(Heap);
+	Assert(MaxFiles);
+
+	*Vfs = {};
+	Vfs->Heap = Heap;
+
+	u32 TableSize = 16;
+	while ((TableSize * 3) < (MaxFiles * 4))
+		TableSize *= 2;
+
+	Vfs->Entries = PushArray(Heap, vfs_entry, TableSize);
+	if (!Vfs->Entries)
+		return false;
+	memset(Vfs->Entries, 0, sizeof(vfs_entry) * TableSize);
+	Vfs->EntryMask = TableSize - 1;
+
+	GlobalVfs = Vfs;
+
+	return true;
+}
+
+void
+UseVfs(vfs *Vfs) {
+	Assert(Vfs);
+
+	// NOTE(ivan): A VFS that failed to initialize is not used, same as right after InitializeVfs().
+	GlobalVfs = Vfs->Entries ? Vfs : 0;
+}
+
+b32
+MountVfsPack(vfs *Vfs, const char *PackName) {
+	Assert(Vfs);
+	Assert(PackName);
+
+	b32 Result = false;
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	if (Vfs->SourceCount == CountOf(Vfs->Sources))
+		return false;
+
+	piece Mapping = PlatformMapEntireFile(PackName);
+	if (Mapping.Base) {
+		vfs_pack_header *Header = (vfs_pack_header *)Mapping.Base;
+		if ((Mapping.Size >= sizeof(vfs_pack_header)) &&
+			(Header->Signature == VFS_PACK_SIGNATURE) &&
+			(Header->Version == VFS_PACK_VERSION)) {
+			// NOTE(ivan): Validate the whole directory before anything gets into the table.
+			b32 IsValid = (((u64)Header->DirectoryOffset + ((u64)Header->EntryCount * sizeof(vfs_pack_entry))) <= Mapping.Size);
+			vfs_pack_entry *Entries = (vfs_pack_entry *)(Mapping.Base + Header->DirectoryOffset);
+			for (u32 Index = 0; IsValid && (Index < Header->EntryCount); Index++) {
+				vfs_pack_entry *Entry = &Entries[Index];
+				if (!memchr(Entry->Path, 0, sizeof(Entry->Path)) ||
+					(((u64)Entry->Offset + Entry->Size) > Mapping.Size))
+					IsValid = false;
+			}
+
+			if (IsValid) {
+				u32 SourceIndex = Vfs->SourceCount++;
+				vfs_source *Source = &Vfs->Sources[SourceIndex];
+				Source->IsPack = true;
+				strncpy(Source->Path, PackName, CountOf(Source->Path) - 1);
+				Source->Mapping = Mapping;
+
+				for (u32 Index = 0; Index < Header->EntryCount; Index++)
+					AddVfsEntry(Vfs, Entries[Index].Path, SourceIndex, Entries[Index].Offset, Entries[Index].Size);
+
+				DEBUGPlatformOutf("VFS: mounted pack %s, %u files", PackName, Header->EntryCount);
+				Result = true;
+			} else {
+				GameTLState.LastError = ErrorCode_VfsPack_Corrupted;
+			}
+		} else {
+			GameTLState.LastError = ErrorCode_WrongSignature;
+		}
+
+		if (!Result)
+			PlatformUnmapEntireFile(&Mapping);
+	} else {
+		GameTLState.LastError = ErrorCode_NotFound;
+	}
+
+	return Result;
+}
+
+// NOTE(ivan): Directory mounting state, passed through PlatformEnumerateFiles().
+struct vfs_mount_context {
+	vfs *Vfs;
+	const char *DirName;
+	u32 SourceIndex;
+	b32 IsCollectingPacks;
+
+	u32 PackCount;
+	char PackNames[MAX_VFS_SOURCES][256];
+};
+
+static void
+MountVfsDirectoryFile(const char *RelativeName, uptr FileSize, void *Param) {
+	vfs_mount_context *Context = (vfs_mount_context *)Param;
+
+	if (Context->IsCollectingPacks) {
+		if (IsVfsPackName(RelativeName) && (Context->PackCount < CountOf(Context->PackNames))) {
+			char *PackName = Context->PackNames[Context->PackCount++];
+			snprintf(PackName, CountOf(Context->PackNames[0]), "%s/%s", Context->DirName, RelativeName);
+		}
+	} else {
+		if (!IsVfsPackName(RelativeName))
+			AddVfsEntry(Context->Vfs, RelativeName, Context->SourceIndex, 0, FileSize);
+	}
+}
+
+b32
+MountVfsDirectory(vfs *Vfs, const char *DirName) {
+	Assert(Vfs);
+	Assert(DirName);
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	vfs_mount_context Context;
+	Context.Vfs = Vfs;
+	Context.DirName = DirName;
+	Context.SourceIndex = 0;
+	Context.IsCollectingPacks = true;
+	Context.PackCount = 0;
+
+	// NOTE(ivan): Packs go first so the loose files override them, packs among themselves in name order.
+	if (!PlatformEnumerateFiles(DirName, MountVfsDirectoryFile, &Context)) {
+		GameTLState.LastError = ErrorCode_NotFound;
+		return false;
+	}
+
+	for (u32 Index = 1; Index < Context.PackCount; Index++) {
+		for (u32 Test = Index; (Test > 0) && (strcmp(Context.PackNames[Test - 1], Context.PackNames[Test]) > 0); Test--) {
+			char Temp[CountOf(Context.PackNames[0])];
+			CopyString(Temp, Context.PackNames[Test]);
+			CopyString(Context.PackNames[Test], Context.PackNames[Test - 1]);
+			CopyString(Context.PackNames[Test - 1], Temp);
+		}
+	}
+
+	for (u32 Index = 0; Index < Context.PackCount; Index++) {
+		if (!MountVfsPack(Vfs, Context.PackNames[Index]))
+			DEBUGPlatformOutf("VFS: failed mounting pack %s", Context.PackNames[Index]);
+	}
+
+	if (Vfs->SourceCount == CountOf(Vfs->Sources))
+		return false;
+
+	Context.SourceIndex = Vfs->SourceCount++;
+	vfs_source *Source = &Vfs->Sources[Context.SourceIndex];
+	Source->IsPack = false;
+	strncpy(Source->Path, DirName, CountOf(Source->Path) - 1);
+
+	u32 EntryCount = Vfs->EntryCount;
+	Context.IsCollectingPacks = false;
+	PlatformEnumerateFiles(DirName, MountVfsDirectoryFile, &Context);
+
+	DEBUGPlatformOutf("VFS: mounted directory %s, %u new files", DirName, Vfs->EntryCount - EntryCount);
+
+	return true;
+}
+
+static vfs_entry *
+LookupVfsPath(const char *Path) {
+	if (!GlobalVfs)
+		return 0;
+
+	char NormalPath[VFS_MAX_PATH];
+	if (!NormalizeVfsPath(Path, NormalPath, CountOf(NormalPath)))
+		return 0;
+
+	vfs_entry *Entry = FindVfsEntry(GlobalVfs, NormalPath, HashVfsPath(NormalPath));
+	return Entry->Path ? Entry : 0;
+}
+
+piece
+ReadVfsFile(const char *Path) {
+	Assert(Path);
+
+	piece Result = {};
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	vfs_entry *Entry = LookupVfsPath(Path);
+	if (Entry) {
+		vfs_source *Source = &GlobalVfs->Sources[Entry->SourceIndex];
+		if (Source->IsPack) {
+			// NOTE(ivan): No copy, no syscall.
+			Result.Base = Source->Mapping.Base + Entry->Offset;
+			Result.Size = Entry->Size;
+		} else {
+			char FileName[512];
+			snprintf(FileName, CountOf(FileName), "%s/%s", Source->Path, Entry->Path);
+			Result = PlatformReadEntireFile(FileName);
+		}
+	} else {
+		Result = PlatformReadEntireFile(Path);
+	}
+
+	if (!Result.Base)
+		GameTLState.LastError = ErrorCode_NotFound;
+
+	return Result;
+}
+
+void
+FreeVfsFile(piece *Piece) {
+	Assert(Piece);
+	Assert(Piece->Base);
+
+	// NOTE(ivan): Pieces that point into a mounted pack are owned by the pack mapping.
+	if (GlobalVfs) {
+		for (u32 Index = 0; Index < GlobalVfs->SourceCount; Index++) {
+			vfs_source *Source = &GlobalVfs->Sources[Index];
+			if (Source->IsPack &&
+				(Piece->Base >= Source->Mapping.Base) &&
+				(Piece->Base < (Source->Mapping.Base + Source->Mapping.Size))) {
+				Piece->Base = 0;
+				Piece->Size = 0;
+				return;
+			}
+		}
+	}
+
+	PlatformFreeEntireFilePiece(Piece);
+}
+
+b32
+ResolveVfsPath(const char *Path, char *Buffer, uptr BufferSize) {
+	Assert(Path);
+	Assert(Buffer);
+	Assert(BufferSize);
+
+	vfs_entry *Entry = LookupVfsPath(Path);
+	if (!Entry)
+		return false;
+
+	vfs_source *Source = &GlobalVfs->Sources[Entry->SourceIndex];
+	if (Source->IsPack)
+		return false;
+
+	snprintf(Buffer, BufferSize, "%s/%s", Source->Path, Entry->Path);
+	return true;
+}
+
+// NOTE(ivan): Pack building state, passed through PlatformEnumerateFiles().
+struct vfs_pack_context {
+	u32 EntryCount;
+	u64 DataSize;
+	vfs_pack_entry *Entries; // NOTE(ivan): Zero while counting.
+	u32 MaxEntryCount; // NOTE(ivan): Of Entries, what the counting pass found.
+	b32 IsOverflown; // NOTE(ivan): More files turned up while filling than there is room for.
+};
+
+static void
+CollectVfsPackFile(const char *RelativeName, uptr FileSize, void *Param) {
+	vfs_pack_context *Context = (vfs_pack_context *)Param;
+
+	if (IsVfsPackName(RelativeName))
+		return;
+	if (strlen(RelativeName) >= VFS_MAX_PATH) {
+		DEBUGPlatformOutf("VFS: path is too long, not packed: %s", RelativeName);
+		return;
+	}
+
+	if (Context->Entries) {
+		if (Context->EntryCount == Context->MaxEntryCount) {
+			Context->IsOverflown = true;
+			return;
+		}
+
+		vfs_pack_entry *Entry = &Context->Entries[Context->EntryCount];
+		memset(Entry, 0, sizeof(*Entry));
+		CopyString(Entry->Path, RelativeName);
+		Entry->Size = (u32)FileSize;
+	}
+
+	Context->EntryCount++;
+	Context->DataSize += AlignPow2((u64)FileSize, (u64)VFS_PACK_ALIGNMENT);
+}
+
+b32
+WriteVfsPack(const char *PackName, const char *DirName, memory_heap *TempHeap) {
+	Assert(PackName);
+	Assert(DirName);
+	Assert(TempHeap);
+
+	b32 Result = false;
+
+	GameTLState.LastError = ErrorCode_NoError;
+
+	// NOTE(ivan): Count first, then fill the directory.
+	vfs_pack_context Context = {};
+	if (PlatformEnumerateFiles(DirName, CollectVfsPackFile, &Context)) {
+		u64 DirectoryOffset = AlignPow2((u64)sizeof(vfs_pack_header), (u64)VFS_PACK_ALIGNMENT) + Context.DataSize;
+		u64 PackSize = DirectoryOffset + ((u64)Context.EntryCount * sizeof(vfs_pack_entry));
+		if (PackSize <= 0xFFFFFFFF) {
+			temporary_memory TempMemory = BeginTemporaryMemory(TempHeap);
+
+			u32 EntryCount = Context.EntryCount;
+			u8 *Output = (u8 *)PushSize(TempHeap, (uptr)PackSize);
+			if (Output) {
+				memset(Output, 0, (uptr)PackSize);
+
+				u64 DataSize = Context.DataSize;
+				Context.EntryCount = 0;
+				Context.DataSize = 0;
+				Context.Entries = (vfs_pack_entry *)(Output + DirectoryOffset);
+				Context.MaxEntryCount = EntryCount;
+				PlatformEnumerateFiles(DirName, CollectVfsPackFile, &Context);
+
+				// NOTE(ivan): Directory contents may have changed between the two passes,
+				// files added, removed or resized since counting would not fit the layout any more.
+				if (!Context.IsOverflown && (Context.EntryCount == EntryCount) && (Context.DataSize == DataSize)) {
+					Result = true;
+
+					u64 Offset = AlignPow2((u64)sizeof(vfs_pack_header), (u64)VFS_PACK_ALIGNMENT);
+					for (u32 Index = 0; Result && (Index < EntryCount); Index++) {
+						vfs_pack_entry *Entry = &Context.Entries[Index];
+						Entry->Offset = (u32)Offset;
+
+						// NOTE(ivan): File data must never run into the directory, whatever the files did meanwhile.
+						if ((Offset + AlignPow2((u64)Entry->Size, (u64)VFS_PACK_ALIGNMENT)) > DirectoryOffset) {
+							Result = false;
+						} else if (Entry->Size) {
+							char FileName[512];
+							snprintf(FileName, CountOf(FileName), "%s/%s", DirName, Entry->Path);
+
+							piece FilePiece = PlatformReadEntireFile(FileName);
+							if (FilePiece.Base && (FilePiece.Size == Entry->Size)) {
+								CopyBytes(Output + Offset, FilePiece.Base, FilePiece.Size);
+							} else {
+								Result = false;
+							}
+							if (FilePiece.Base)
+								PlatformFreeEntireFilePiece(&FilePiece);
+						}
+
+						Offset += AlignPow2((u64)Entry->Size, (u64)VFS_PACK_ALIGNMENT);
+					}
+
+					if (Result) {
+						vfs_pack_header *Header = (vfs_pack_header *)Output;
+						Header->Signature = VFS_PACK_SIGNATURE;
+						Header->Version = VFS_PACK_VERSION;
+						Header->EntryCount = EntryCount;
+						Header->DirectoryOffset = (u32)DirectoryOffset;
+
+						Result = PlatformWriteEntireFile(PackName, Output, (uptr)PackSize);
+						if (Result)
+							DEBUGPlatformOutf("VFS: packed %u files from %s into %s", EntryCount, DirName, PackName);
+					}
+				} else {
+					DEBUGPlatformOutf("VFS: %s changed while being packed, try again!", DirName);
+				}
+			}
+
+			EndTemporaryMemory(TempMemory);
+		}
+	} else {
+		GameTLState.LastError = ErrorCode_NotFound;
+	}
+
+	return Result;
+}
@@ -0,0 +1,89 @@
+/* =====================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Author: Ivan Avdonin $
+   $Notice: Copyright (C) 2019, Ivan Avdonin. All Rights Reserved. $
+   ===================================================================== */
+#ifndef GAME_VFS_H
+#define GAME_VFS_H
+
+#include "game_memory.h"
+
+// NOTE(ivan): Virtual file system. Loose directories and packs are mounted in priority order,
+// every file they contain is put into a single hash table once at mount time, so resolving a path
+// never touches the disk. Later mounts override earlier ones, a directory's own loose files
+// override the packs found inside it.
+
+// NOTE(ivan): Pack file layout:
+// [vfs_pack_header] [file data, every file aligned to VFS_PACK_ALIGNMENT] [vfs_pack_entry * EntryCount]
+// Packs are mapped into memory as a whole, reading a file from a pack is just a pointer into the mapping.
+#define VFS_PACK_SIGNATURE FourCC("QPAK")
+#define VFS_PACK_VERSION 1
+#define VFS_PACK_EXTENSION "qpak"
+#define VFS_PACK_ALIGNMENT 16
+#define VFS_MAX_PATH 120
+
+#pragma pack(push, 1)
+struct vfs_pack_header {
+	u32 Signature;
+	u32 Version;
+	u32 EntryCount;
+	u32 DirectoryOffset; // NOTE(ivan): From the beginning of the file.
+};
+
+struct vfs_pack_entry {
+	char Path[VFS_MAX_PATH]; // NOTE(ivan): Zero-terminated, relative, '/' separated.
+	u32 Offset; // NOTE(ivan): From the beginning of the file.
+	u32 Size;
+};
+#pragma pack(pop)
+
+// NOTE(ivan): Mounted directory or pack.
+#define MAX_VFS_SOURCES 64
+
+struct vfs_source {
+	b32 IsPack;
+	char Path[256]; // NOTE(ivan): Directory or pack file name as it was mounted.
+	piece Mapping; // NOTE(ivan): Packs only.
+};
+
+// NOTE(ivan): Hash table entry, empty if Path is 0.
+struct vfs_entry {
+	u32 Hash;
+	u32 SourceIndex;
+	const char *Path;
+	uptr Offset; // NOTE(ivan): Packs only.
+	uptr Size;
+};
+
+struct vfs {
+	memory_heap *Heap; // NOTE(ivan): Paths of mounted files live here.
+
+	u32 SourceCount;
+	vfs_source Sources[MAX_VFS_SOURCES];
+
+	u32 EntryCount;
+	u32 EntryMask; // NOTE(ivan): Table size is a power of two.
+	vfs_entry *Entries;
+};
+
+b32 InitializeVfs(vfs *Vfs, memory_heap *Heap, u32 MaxFiles);
+
+// NOTE(ivan): Points the file loaders back at an already initialized Vfs, for a reloaded game module.
+void UseVfs(vfs *Vfs);
+b32 MountVfsPack(vfs *Vfs, const char *PackName);
+b32 MountVfsDirectory(vfs *Vfs, const char *DirName);
+
+// NOTE(ivan): Drop-in replacements for PlatformReadEntireFile()/PlatformFreeEntireFilePiece().
+// Paths the VFS does not know about are read straight from the disk.
+piece ReadVfsFile(const char *Path);
+void FreeVfsFile(piece *Piece);
+
+// NOTE(ivan): Real file name of a file that lives in a loose directory, false for pack files and unknown paths.
+b32 ResolveVfsPath(const char *Path, char *Buffer, uptr BufferSize);
+
+// NOTE(ivan): Packs every file under DirName into a single pack file.
+b32 WriteVfsPack(const char *PackName, const char *DirName, memory_heap *TempHeap);
+
+#endif // #ifndef GAME_VFS_H